@@ -332,6 +332,11 @@
     #undef SDCARDDETECTINVERTED
   #endif
 
+  // The command queue holds BUFSIZE full-length commands unless told otherwise
+  #ifndef CMD_BUFFER_BYTES
+    #define CMD_BUFFER_BYTES (BUFSIZE * MAX_CMD_SIZE)
+  #endif
+
   // Power Signal Control Definitions
   // By default use ATX definition
   #ifndef POWER_SUPPLY
@@ -501,9 +506,14 @@
   // #ifdef INVERTED_HEATER_PINS 
   // Dawson - rename to something that is more correctly descriptive . . . More than just heaters on the MOSFETS . . . 
   #ifdef INVERTED_MOSFET_CHANNELS
-    #define WRITE_HEATER(pin,value) WRITE(pin,!value)
+    #define _WRITE_HEATER(pin,value) WRITE(pin,!value)
+  #else
+    #define _WRITE_HEATER(pin,value) WRITE(pin,value)
+  #endif
+  #ifdef HEATER_SIMULATION
+    #define WRITE_HEATER(pin,value) _WRITE_HEATER(pin,LOW) // The simulated heaters only read the duty
   #else
-    #define WRITE_HEATER(pin,value) WRITE(pin,value)
+    #define WRITE_HEATER(pin,value) _WRITE_HEATER(pin,value)
   #endif
   
   #define WRITE_HEATER_0P(v) WRITE_HEATER(HEATER_0_PIN, v)
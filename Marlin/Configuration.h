@@ -143,7 +143,8 @@ Here are some standard links for getting your machine calibrated:
 //     Use it for Testing or Development purposes. NEVER for production machine.
 //     #define DUMMY_THERMISTOR_998_VALUE 25
 //     #define DUMMY_THERMISTOR_999_VALUE 100
-// :{ '0': "Not used", '4': "10k !! do not use for a hotend. Bad resolution at high temp. !!", '1': "100k / 4.7k - EPCOS", '51': "100k / 1k - EPCOS", '6': "100k / 4.7k EPCOS - Not as accurate as Table 1", '5': "100K / 4.7k - ATC Semitec 104GT-2 (Used in ParCan & J-Head)", '7': "100k / 4.7k Honeywell 135-104LAG-J01", '71': "100k / 4.7k Honeywell 135-104LAF-J01", '8': "100k / 4.7k 0603 SMD Vishay NTCS0603E3104FXT", '9': "100k / 4.7k GE Sensing AL03006-58.2K-97-G1", '10': "100k / 4.7k RS 198-961", '11': "100k / 4.7k beta 3950 1%", '12': "100k / 4.7k 0603 SMD Vishay NTCS0603E3104FXT (calibrated for Makibox hot bed)", '13': "100k Hisens 3950  1% up to 300°C for hotend 'Simple ONE ' & hotend 'All In ONE'", '60': "100k Maker's Tool Works Kapton Bed Thermistor beta=3950", '55': "100k / 1k - ATC Semitec 104GT-2 (Used in ParCan & J-Head)", '2': "200k / 4.7k - ATC Semitec 204GT-2", '52': "200k / 1k - ATC Semitec 204GT-2", '-2': "Thermocouple + MAX6675 (only for sensor 0)", '-1': "Thermocouple + AD595", '3': "Mendel-parts / 4.7k", '1047': "Pt1000 / 4.7k", '1010': "Pt1000 / 1k (non standard)", '20': "PT100 (Ultimainboard V2.x)", '147': "Pt100 / 4.7k", '110': "Pt100 / 1k (non-standard)", '998': "Dummy 1", '999': "Dummy 2" }
+// 1000 is a user-defined thermistor, its table is generated from the THERMISTOR_1000_* values in Configuration_adv.h
+// :{ '0': "Not used", '4': "10k !! do not use for a hotend. Bad resolution at high temp. !!", '1': "100k / 4.7k - EPCOS", '51': "100k / 1k - EPCOS", '6': "100k / 4.7k EPCOS - Not as accurate as Table 1", '5': "100K / 4.7k - ATC Semitec 104GT-2 (Used in ParCan & J-Head)", '7': "100k / 4.7k Honeywell 135-104LAG-J01", '71': "100k / 4.7k Honeywell 135-104LAF-J01", '8': "100k / 4.7k 0603 SMD Vishay NTCS0603E3104FXT", '9': "100k / 4.7k GE Sensing AL03006-58.2K-97-G1", '10': "100k / 4.7k RS 198-961", '11': "100k / 4.7k beta 3950 1%", '12': "100k / 4.7k 0603 SMD Vishay NTCS0603E3104FXT (calibrated for Makibox hot bed)", '13': "100k Hisens 3950  1% up to 300°C for hotend 'Simple ONE ' & hotend 'All In ONE'", '60': "100k Maker's Tool Works Kapton Bed Thermistor beta=3950", '55': "100k / 1k - ATC Semitec 104GT-2 (Used in ParCan & J-Head)", '2': "200k / 4.7k - ATC Semitec 204GT-2", '52': "200k / 1k - ATC Semitec 204GT-2", '-2': "Thermocouple + MAX6675 (only for sensor 0)", '-1': "Thermocouple + AD595", '3': "Mendel-parts / 4.7k", '1047': "Pt1000 / 4.7k", '1010': "Pt1000 / 1k (non standard)", '20': "PT100 (Ultimainboard V2.x)", '147': "Pt100 / 4.7k", '110': "Pt100 / 1k (non-standard)", '998': "Dummy 1", '999': "Dummy 2", '1000': "User-defined (Configuration_adv.h)" }
 #define TEMP_SENSOR_0 1
 #define TEMP_SENSOR_1 1
 #define TEMP_SENSOR_2 1
@@ -224,6 +225,24 @@ Here are some standard links for getting your machine calibrated:
 
 #endif // PIDTEMP
 
+// Model predictive control of the hotends, instead of PIDTEMP (comment out PIDTEMP to use it).
+// The heater block and the sensor are simulated as two thermal masses, and the heat taken by the
+// part cooling fan and by the filament being extruded is fed forward before the temperature drops.
+// Autotune with M306 T, set with M306 and save with M500.
+//#define MPCTEMP
+#ifdef MPCTEMP
+  #define MPC_MAX BANG_MAX                        // limits current to nozzle while MPC is active; 255=full current
+  #define MPC_HEATER_POWER 40.0                   // (W) Heater cartridge power
+  #define MPC_BLOCK_HEAT_CAPACITY 16.7            // (J/K) Heat capacity of the heater block
+  #define MPC_SENSOR_RESPONSIVENESS 0.22          // (1/s) How fast the sensor follows the block
+  #define MPC_AMBIENT_XFER_COEFF 0.068            // (W/K) Heat loss to ambient with the fan off
+  #define MPC_AMBIENT_XFER_COEFF_FAN255 0.097     // (W/K) Heat loss to ambient with the fan at full speed
+  #define MPC_FILAMENT_HEAT_CAPACITY_PERMM 5.6e-3 // (J/K/mm) 1.75mm PLA, use 1.4e-2 for 2.85mm PLA
+  #define MPC_SMOOTHING_FACTOR 0.5                // Share of the model error corrected on each sample (0.0-1.0)
+  #define MPC_MIN_AMBIENT_CHANGE 1.0              // (K/s) Rate the ambient estimate follows the model error
+  #define MPC_STEADYSTATE 0.5                     // (K/s) Block temperature change considered steady
+#endif // MPCTEMP
+
 //===========================================================================
 //============================= PID > Bed Temperature Control ===============
 //===========================================================================
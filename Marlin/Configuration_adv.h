@@ -39,12 +39,19 @@
 #ifdef PIDTEMP
   // this adds an experimental additional term to the heating power, proportional to the extrusion speed.
   // if Kc is chosen well, the additional required power due to increased melting should be compensated.
-  #define PID_ADD_EXTRUSION_RATE
+  // Kc is applied to the output, so find a good value for your hotend before enabling this.
+  //#define PID_ADD_EXTRUSION_RATE
   #ifdef PID_ADD_EXTRUSION_RATE
-    #define  DEFAULT_Kc (1) //heating power=Kc*(e_speed)
+    #define  DEFAULT_Kc (1) //heating power=Kc*(e_speed), e_speed in mm/s of filament. Set with M301 C
+    #define PID_EXTRUSION_RATE_LOOKAHEAD 2.0 //seconds of queued moves to average e_speed over, so the heater ramps up before the flow does
   #endif
 #endif
 
+// M303 relay autotune: the heater switches when the temperature leaves this band around the target,
+// and the tuning stops early once Ku and Tu change by less than this fraction for two cycles in a row
+#define PID_AUTOTUNE_HYSTERESIS 0.5   // Degrees Celsius
+#define PID_AUTOTUNE_CONVERGENCE 0.05
+
 /**
  * Automatic Temperature:
  * The hotend target temperature is calculated by all the buffered lines of gcode.
@@ -64,6 +71,39 @@
 //The M105 command return, besides traditional information, the ADC value read from temperature sensors.
 //#define SHOW_TEMP_ADC_VALUES
 
+// M155 S<seconds> makes the printer send the temperature report on its own, so hosts needn't poll with M105
+//#define AUTO_REPORT_TEMPERATURES
+
+// Drive the heaters whose pins have a hardware PWM channel from the PWM controller,
+// with 12 bit duty resolution. Heaters on other pins keep the 7 bit soft PWM of the temperature ISR.
+//#define HEATERS_HARDWARE_PWM
+#ifdef HEATERS_HARDWARE_PWM
+  #define HEATER_PWM_FREQUENCY 1000 // Hz, the lowest rate the prescaler reaches at or above this is used
+  // The bed too. Only with a MOSFET that switches cleanly at this rate, not with a relay or an SSR!
+  //#define HEATER_BED_HARDWARE_PWM
+#endif
+
+// Replace the hotend and bed sensors with a simulated heater block and thermistor, heated by the
+// heater outputs. PID tuning, M303 and the thermal protection can then be tried without hardware.
+// The heater pins are held off and HEATERS_HARDWARE_PWM is ignored, the soft PWM duty drives the model.
+// The model is heater_sim.h. test/test_heater_control.cpp runs the hotend control on it on the host,
+// checking the heat-up time, overshoot and thermal protection of a heater and tuning before it is built.
+//#define HEATER_SIMULATION
+#ifdef HEATER_SIMULATION
+  #define SIM_AMBIENT_TEMP 25.0           // °C
+  #define SIM_HOTEND_POWER 40.0           // W at full duty
+  #define SIM_HOTEND_HEAT_CAPACITY 16.0   // J/K of the heater block
+  #define SIM_HOTEND_LOSS 0.07            // W/K to the ambient air
+  #define SIM_HOTEND_FAN_LOSS 0.03        // W/K more with the part fan at 255
+  #define SIM_HOTEND_SENSOR_LAG 1.5       // s, time constant of the thermistor
+  #define SIM_BED_POWER 200.0
+  #define SIM_BED_HEAT_CAPACITY 600.0
+  #define SIM_BED_LOSS 1.2
+  #define SIM_BED_SENSOR_LAG 5.0
+  #define SIM_ADC_NOISE 2                 // ADC counts (12 bit) of random noise on each reading
+  //#define SIM_HOTEND_FAILURE_TIME 600   // s after boot when the heater of hotend 0 stops heating, to test the thermal protection
+#endif
+
 // @section extruder
 
 //  extruder run-out prevention.
@@ -82,6 +122,21 @@
 #define TEMP_SENSOR_AD595_OFFSET 0.0
 #define TEMP_SENSOR_AD595_GAIN   1.0
 
+//Sensor type 1000 is a thermistor whose table is generated at compile time from these values.
+//The beta model is used unless the Steinhart-Hart coefficients are defined.
+//More points give a more accurate conversion, fewer points save flash (2-255).
+#if TEMP_SENSOR_0 == 1000 || TEMP_SENSOR_1 == 1000 || TEMP_SENSOR_2 == 1000 || TEMP_SENSOR_3 == 1000 || TEMP_SENSOR_BED == 1000
+  #define THERMISTOR_1000_PULLUP  4700    // Pull-up resistor (ohm)
+  #define THERMISTOR_1000_R25     100000  // Thermistor resistance at 25°C (ohm)
+  #define THERMISTOR_1000_BETA    3950    // Beta coefficient
+  //#define THERMISTOR_1000_SH_A  0.000722378300319346  // Steinhart-Hart: 1/T = A + B*ln(R) + C*ln(R)^3
+  //#define THERMISTOR_1000_SH_B  0.000216301852054578
+  //#define THERMISTOR_1000_SH_C  0.000000092641025635702
+  #define THERMISTOR_1000_MINTEMP 0       // Table range (°C)
+  #define THERMISTOR_1000_MAXTEMP 350
+  #define THERMISTOR_1000_POINTS  71      // 5°C resolution
+#endif
+
 //This is for controlling a fan to cool down the stepper drivers
 //it will turn on when any driver is enabled
 //and turn off after the set amount of seconds from last driver being disabled again
@@ -355,11 +410,22 @@
 //#define WATCHDOG_RESET_MANUAL
 #endif
 
+// Measure the run time of the stepper and temperature ISRs with the DWT cycle counter.
+// M801 reports min/max/mean, a histogram and late runs; M801 R also resets the statistics.
+// Use it to find out how close the stepper ISR is to saturation before raising
+// MAX_STEP_FREQUENCY or DOUBLE_STEP_FREQUENCY. Costs a few cycles per ISR run.
+//#define ISR_PROFILING
+#ifdef ISR_PROFILING
+  #define ISR_PROFILING_BUCKETS 10  // Number of histogram buckets
+  #define ISR_PROFILING_MIN_BITS 7  // First bucket holds runs shorter than 2^7 = 128 cycles, each next bucket doubles
+#endif
+
 // @section lcd
 
 // Babystepping enables the user to control the axis in tiny amounts, independently from the normal printing process
 // it can e.g. be used to change z-positions in the print startup phase in real-time
 // does not respect endstops!
+// Use the LCD Tune menu or M290 Z<mm> (M290 without parameters reports the offset)
 //#define BABYSTEPPING
 #ifdef BABYSTEPPING
   #define BABYSTEP_XY  //not only z, but also XY in the menu. more clutter, more functions
@@ -367,6 +433,29 @@
   #define BABYSTEP_Z_MULTIPLICATOR 2 //faster z movements
 #endif
 
+// @section machine
+
+// Backlash compensation adds the mechanical play of an axis to the first move(s) after it reverses.
+// The extra steps are folded into the planned blocks, no extra moves are queued.
+// Adjust at runtime with M425 X<mm> Y<mm> Z<mm> F<fraction> S<mm> (M425 without parameters reports)
+//#define BACKLASH_COMPENSATION
+#ifdef BACKLASH_COMPENSATION
+  #define BACKLASH_DISTANCE_MM { 0, 0, 0 } // (mm) Play of the X, Y and Z motors
+  #define BACKLASH_CORRECTION 0.0          // 0.0 = no correction, 1.0 = full correction
+  #define BACKLASH_SMOOTHING_MM 3          // (mm) Spread the correction over this distance, 0 = apply it to the first move at once
+#endif
+
+// Skew correction compensates a frame whose axes are not square to each other.
+// Each factor is the tangent of the angle error, e.g. XY = X shift of a printed edge / its length along Y.
+// Together with the auto bed leveling rotation it forms a single transform applied to every move.
+// Adjust at runtime with M852 I<xy> J<xz> K<yz> (M852 without parameters reports)
+//#define SKEW_CORRECTION
+#ifdef SKEW_CORRECTION
+  #define XY_SKEW_FACTOR 0.0
+  #define XZ_SKEW_FACTOR 0.0
+  #define YZ_SKEW_FACTOR 0.0
+#endif
+
 // @section extruder
 
 // extruder advance constant (s2/mm3)
@@ -400,6 +489,14 @@ const unsigned int dropsegments=5; //everything with less than this number of st
 // for smoother temperature
 #define MEDIAN_COUNT 10
 
+// Each sensor is smoothed with the mean of the last MEDIAN_COUNT readings.
+// A median rejects spikes better, e.g. on a bed switched by a noisy SSR.
+//#define TEMP_0_MEDIAN_FILTER
+//#define TEMP_1_MEDIAN_FILTER
+//#define TEMP_2_MEDIAN_FILTER
+//#define TEMP_3_MEDIAN_FILTER
+//#define TEMP_BED_MEDIAN_FILTER
+
 //===========================================================================
 //================================= Buffers =================================
 //===========================================================================
@@ -418,7 +515,8 @@ const unsigned int dropsegments=5; //everything with less than this number of st
 
 //The ASCII buffer for receiving from the serial:
 #define MAX_CMD_SIZE 96
-#define BUFSIZE 4
+#define BUFSIZE 16            // Most commands in the queue
+#define CMD_BUFFER_BYTES 384  // Shared by the queued commands, each takes its length + 1
 
 // Bad Serial-connections can miss a received command by sending an 'ok'
 // Therefore some clients abort after 30 seconds in a timeout.
@@ -426,9 +524,53 @@ const unsigned int dropsegments=5; //everything with less than this number of st
 // This "wait" is only sent when the buffer is empty. 1 second is a good value here.
 //#define NO_TIMEOUTS 1000 // Milliseconds
 
-// Some clients will have this feature soon. This could make the NO_TIMEOUTS unnecessary.
+// Add the last line number (N), free planner blocks (P) and free command lines (B) to each "ok",
+// and report the serial receive buffer size in M115. Hosts can then stream by counting
+// characters (scripts/stream_gcode.py) instead of waiting for an "ok" before each line.
+// B counts the lines of up to MAX_CMD_SIZE that still fit in the CMD_BUFFER_BYTES, as the
+// serial is only read while one does, so shorter lines can fit more than B.
+// This could make the NO_TIMEOUTS unnecessary.
 //#define ADVANCED_OK
 
+// Buffer serial output in RAM, so printing never waits for the UART. M802 reports the
+// peak use and the lines dropped. Not for the native USB port (SerialUSB).
+//#define SERIAL_TX_BUFFER_SIZE 1024
+#ifdef SERIAL_TX_BUFFER_SIZE
+  // When the buffer is full: TX_OVERFLOW_BLOCK waits, TX_OVERFLOW_DROP drops the rest of the line,
+  // TX_OVERFLOW_DROP_ECHO drops the rest of "echo:" lines (M503, PID_DEBUG, ...) and waits for others
+  #define SERIAL_TX_OVERFLOW TX_OVERFLOW_DROP_ECHO
+#endif
+
+// Accept commands pre-encoded in binary frames with a CRC16, as sent by scripts/binary_gcode.py.
+// The host switches to frames by sending one, and back to text with an empty frame.
+// Frames are acknowledged when queued, so the host can keep BINARY_GCODE_WINDOW of them in flight,
+// and no more bytes than the serial receive buffer holds (M115 Cap:RX_BUFFER).
+// Files saved with M28 are sent as text: until M29 other binary commands are refused.
+//#define BINARY_GCODE
+#ifdef BINARY_GCODE
+  #define BINARY_GCODE_WINDOW 4
+#endif
+
+// A second serial port taking commands alongside the main one, e.g. a monitoring controller on a UART
+// while the host streams over USB. It has its own line numbers and the replies to its commands go
+// back to it. Output no command asked for, like auto-reports and heater errors, goes to the main port.
+// It holds at most one command in the queue, so it never takes slots from the host.
+// Binary frames, the TX buffer and the emergency parser are for the main port only.
+//#define SERIAL_PORT_2 Serial1
+#ifdef SERIAL_PORT_2
+  #define SERIAL_PORT_2_BAUDRATE 115200
+#endif
+
+// Act on M108 (stop waiting for heaters), M112 (emergency stop) and M410 (quickstop) as soon as
+// they're received, even while the command queue is full or M109 / M190 are waiting.
+// They must be alone on their line. EMERGENCY_PARSER_RX_BYTES more received bytes are held for the queue.
+// Only MYSERIAL is watched. After M410 the position is taken from where the steppers stopped,
+// once the command that was running is done, and the queued commands go on from there.
+//#define EMERGENCY_PARSER
+#ifdef EMERGENCY_PARSER
+  #define EMERGENCY_PARSER_RX_BYTES 128
+#endif
+
 // @section fwretract
 
 // Firmware based and LCD controlled retract
@@ -416,14 +416,8 @@ adc_channel_num_t pinToAdcChannel(int pin)
 uint16_t getAdcFreerun(adc_channel_num_t chan, bool wait_for_conversion)
 {
   if (wait_for_conversion) while (!((ADC->ADC_ISR & BIT(chan)) == BIT(chan)));
-  if ((ADC->ADC_ISR & BIT(chan)) == BIT(chan)) {
-	  uint16_t rslt = ADC->ADC_CDR[chan];
-	  return rslt;
-  }
-  else {
-	  SERIAL_ECHOLN("wait freerun");
-  	  return 0;
-  }
+  // Without a new conversion this is the previous result, which is fine for freerun mode
+  return ADC->ADC_CDR[chan];
 }
 
 uint16_t getAdcSuperSample(adc_channel_num_t chan) {
@@ -437,6 +431,115 @@ void stopAdcFreerun(adc_channel_num_t chan)
   ADC->ADC_CHDR |= BIT(chan);
 }
 
+// --------------------------------------------------------------------------
+// ADC scan
+//
+// The ADC converts all enabled channels in sequence in freerun mode and the
+// PDC stores each result, tagged with its channel number, into one half of a
+// double buffer. HAL_adc_scan_update() sums the filled halves per channel and
+// hands them back to the PDC, so no conversion has to be polled for.
+//
+// At about 1 µs per conversion both halves are full some 128 µs after they are
+// handed back, and the PDC then waits for the next update. Called from the
+// temperature ISR, each average is a burst at the start of a tick rather than
+// the whole tick, so slow interference is left to the filters in temperature.cpp.
+// --------------------------------------------------------------------------
+
+#define ADC_SCAN_BUFFER_SIZE 64
+
+static uint16_t adc_scan_buffer[2][ADC_SCAN_BUFFER_SIZE];
+static uint8_t adc_scan_filling; // Half the PDC writes to first
+static uint32_t adc_scan_sum[16];
+static uint16_t adc_scan_count[16];
+
+void HAL_adc_scan_start(uint32_t channel_mask)
+{
+  ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+  ADC->ADC_CHER = channel_mask;
+  ADC->ADC_EMR |= ADC_EMR_TAG;
+  ADC->ADC_MR |= ADC_MR_FREERUN_ON | ADC_MR_LOWRES_BITS_12;
+
+  adc_scan_filling = 0;
+  ADC->ADC_RPR = (uint32_t)adc_scan_buffer[0];
+  ADC->ADC_RCR = ADC_SCAN_BUFFER_SIZE;
+  ADC->ADC_RNPR = (uint32_t)adc_scan_buffer[1];
+  ADC->ADC_RNCR = ADC_SCAN_BUFFER_SIZE;
+  ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+}
+
+static void adc_scan_collect(const uint16_t *buffer)
+{
+  for (uint8_t i = 0; i < ADC_SCAN_BUFFER_SIZE; i++) {
+    uint8_t chan = buffer[i] >> ADC_LCDR_CHNB_Pos;
+    adc_scan_sum[chan] += buffer[i] & ADC_LCDR_LDATA_Msk;
+    adc_scan_count[chan]++;
+  }
+}
+
+void HAL_adc_scan_update()
+{
+  if (ADC->ADC_RCR == 0) {
+    // Both halves are full and the PDC stopped, restart it
+    adc_scan_collect(adc_scan_buffer[adc_scan_filling]);
+    adc_scan_collect(adc_scan_buffer[adc_scan_filling ^ 1]);
+    ADC->ADC_RPR = (uint32_t)adc_scan_buffer[adc_scan_filling];
+    ADC->ADC_RCR = ADC_SCAN_BUFFER_SIZE;
+    ADC->ADC_RNPR = (uint32_t)adc_scan_buffer[adc_scan_filling ^ 1];
+    ADC->ADC_RNCR = ADC_SCAN_BUFFER_SIZE;
+  }
+  else if (ADC->ADC_RNCR == 0) {
+    // The PDC moved on to the other half, queue this one behind it
+    adc_scan_collect(adc_scan_buffer[adc_scan_filling]);
+    ADC->ADC_RNPR = (uint32_t)adc_scan_buffer[adc_scan_filling];
+    ADC->ADC_RNCR = ADC_SCAN_BUFFER_SIZE;
+    adc_scan_filling ^= 1;
+  }
+}
+
+uint16_t HAL_adc_scan_average(adc_channel_num_t chan)
+{
+  uint16_t count = adc_scan_count[chan];
+  if (!count) return ADC->ADC_CDR[chan];
+  uint16_t rslt = (adc_scan_sum[chan] + count / 2) / count;
+  adc_scan_sum[chan] = 0;
+  adc_scan_count[chan] = 0;
+  return rslt;
+}
+
+// --------------------------------------------------------------------------
+// Hardware PWM
+//
+// Pins wired to a channel of the PWM controller are driven by the channel at
+// HAL_PWM_RESOLUTION bits. The channel counts the master clock through its
+// own prescaler, so the clocks A and B used by analogWrite() stay untouched.
+// An inverted channel idles high, for outputs that are active low.
+// --------------------------------------------------------------------------
+
+bool HAL_pwm_init(int pin, uint32_t frequency, bool inverted)
+{
+  if (pin < 0 || !(g_APinDescription[pin].ulPinAttribute & PIN_ATTR_PWM)) return false;
+
+  // Slowest prescaler (MCK / 2^n) that still reaches the frequency
+  uint32_t prescaler = 0;
+  while (prescaler < 10 && (VARIANT_MCK >> (prescaler + 1)) / (HAL_PWM_MAX + 1) >= frequency) prescaler++;
+
+  const uint32_t chan = g_APinDescription[pin].ulPWMChannel;
+  pmc_enable_periph_clk(PWM_INTERFACE_ID);
+  PWMC_DisableChannel(PWM_INTERFACE, chan);
+  PWMC_ConfigureChannel(PWM_INTERFACE, chan, prescaler, 0, inverted ? PWM_CMR_CPOL : 0);
+  PWMC_SetPeriod(PWM_INTERFACE, chan, HAL_PWM_MAX);
+  PWMC_SetDutyCycle(PWM_INTERFACE, chan, 0);
+  PWMC_EnableChannel(PWM_INTERFACE, chan);
+  PIO_Configure(g_APinDescription[pin].pPort, g_APinDescription[pin].ulPinType,
+                g_APinDescription[pin].ulPin, g_APinDescription[pin].ulPinConfiguration);
+  return true;
+}
+
+void HAL_pwm_write(int pin, uint16_t duty)
+{
+  PWMC_SetDutyCycle(PWM_INTERFACE, g_APinDescription[pin].ulPWMChannel, min(duty, HAL_PWM_MAX));
+}
+
 // --------------------------------------------------------------------------
 //! @brief
 //! @param[in]
@@ -87,6 +87,17 @@ static inline void _delay_us(uint32_t usec) {
   );
 }
 
+// Cycle counter of the Cortex-M3 DWT unit, counts F_CPU ticks and wraps every ~51s
+static inline void HAL_cycle_counter_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t HAL_cycle_count(void) {
+  return DWT->CYCCNT;
+}
+
 int freeMemory(void);
 void eeprom_write_byte(unsigned char *pos, unsigned char value);
 unsigned char eeprom_read_byte(unsigned char *pos);
@@ -162,6 +173,16 @@ adc_channel_num_t pinToAdcChannel(int pin);
 uint16_t getAdcFreerun(adc_channel_num_t chan, bool wait_for_conversion = false);
 uint16_t getAdcSuperSample(adc_channel_num_t chan);
 void stopAdcFreerun(adc_channel_num_t chan);
+
+void HAL_adc_scan_start(uint32_t channel_mask);
+void HAL_adc_scan_update();
+uint16_t HAL_adc_scan_average(adc_channel_num_t chan); // Mean of the conversions since the last call
+
+#define HAL_PWM_RESOLUTION 12
+#define HAL_PWM_MAX ((1 << HAL_PWM_RESOLUTION) - 1)
+
+bool HAL_pwm_init(int pin, uint32_t frequency, bool inverted = false); // false if the pin has no PWM controller channel
+void HAL_pwm_write(int pin, uint16_t duty); // 0 to HAL_PWM_MAX
 //>>>>>>> wurst/master
 
 // --------------------------------------------------------------------------
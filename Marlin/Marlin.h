@@ -59,14 +59,60 @@ typedef unsigned long millis_t;
   #endif
 #endif
 
-#define SERIAL_CHAR(x) MYSERIAL.write(x)
+// Bytes the receive buffer of MYSERIAL holds, so hosts counting characters never overrun it
+#ifndef SERIAL_RX_BUFFER_BYTES
+  #if MOTHERBOARD == BOARD_AMBIT
+    #define SERIAL_RX_BUFFER_BYTES 511 // SerialUSB, and USB holds back the rest
+  #else
+    #define SERIAL_RX_BUFFER_BYTES (SERIAL_BUFFER_SIZE - 1)
+  #endif
+#endif
+
+#ifdef BINARY_GCODE
+  #define BINARY_FRAME_SYNC 0xFE // Starts a binary frame, never the first byte of a text line
+#endif
+
+// Input comes through the emergency parser, if any
+#ifdef EMERGENCY_PARSER
+  #include "emergency_parser.h"
+  #define SERIAL_IN_AVAILABLE() emergency_parser_available()
+  #define SERIAL_IN_READ() emergency_parser_read()
+#else
+  #define SERIAL_IN_AVAILABLE() MYSERIAL.available()
+  #define SERIAL_IN_READ() MYSERIAL.read()
+#endif
+
+// Output to the main port goes through the TX buffer, if any
+#ifdef SERIAL_TX_BUFFER_SIZE
+  #include "serial_tx.h"
+  #define SERIAL_OUT_MAIN serial_tx
+#else
+  #define SERIAL_OUT_MAIN MYSERIAL
+#endif
+
+// With a second port, output goes to the port the command came from
+#ifdef SERIAL_PORT_2
+  #include "serial_ports.h"
+  #define SERIAL_OUT serial_ports
+  #define SERIAL_OUT_IS_MAIN (!serial_ports.port)
+#else
+  #define SERIAL_OUT SERIAL_OUT_MAIN
+  #define SERIAL_OUT_IS_MAIN true
+#endif
+
+#define SERIAL_CHAR(x) SERIAL_OUT.write(x)
 #define SERIAL_EOL SERIAL_CHAR('\n')
 
+// Floats are formatted in fixed point (numtostr.h), by default with 2 places as Print does
+void serial_print_float(const float &x, const uint8_t places);
+template<typename T> FORCE_INLINE void serial_print(const T &x) { SERIAL_OUT.print(x); }
+FORCE_INLINE void serial_print(const float &x) { serial_print_float(x, 2); }
+
 #define SERIAL_PROTOCOLCHAR(x) SERIAL_CHAR(x)
-#define SERIAL_PROTOCOL(x) MYSERIAL.print(x)
-#define SERIAL_PROTOCOL_F(x,y) MYSERIAL.print(x,y)
+#define SERIAL_PROTOCOL(x) serial_print(x)
+#define SERIAL_PROTOCOL_F(x,y) serial_print_float(x,y)
 #define SERIAL_PROTOCOLPGM(x) serialprintPGM(PSTR(x))
-#define SERIAL_PROTOCOLLN(x) do{ MYSERIAL.print(x); SERIAL_EOL; }while(0)
+#define SERIAL_PROTOCOLLN(x) do{ serial_print(x); SERIAL_EOL; }while(0)
 #define SERIAL_PROTOCOLLNPGM(x) do{ serialprintPGM(PSTR(x)); SERIAL_EOL; }while(0)
 
 
@@ -79,7 +125,11 @@ extern const char echomagic[] PROGMEM;
 #define SERIAL_ERRORLN(x) SERIAL_PROTOCOLLN(x)
 #define SERIAL_ERRORLNPGM(x) SERIAL_PROTOCOLLNPGM(x)
 
-#define SERIAL_ECHO_START serialprintPGM(echomagic)
+#ifdef SERIAL_TX_BUFFER_SIZE
+  #define SERIAL_ECHO_START do{ if (SERIAL_OUT_IS_MAIN) serial_tx.start_echo(); serialprintPGM(echomagic); }while(0)
+#else
+  #define SERIAL_ECHO_START serialprintPGM(echomagic)
+#endif
 #define SERIAL_ECHO(x) SERIAL_PROTOCOL(x)
 #define SERIAL_ECHOPGM(x) SERIAL_PROTOCOLPGM(x)
 #define SERIAL_ECHOLN(x) SERIAL_PROTOCOLLN(x)
@@ -98,7 +148,7 @@ void serial_echopair_P(const char *s_P, unsigned long v);
 FORCE_INLINE void serialprintPGM(const char *str) {
   char ch;
   while ((ch = pgm_read_byte(str))) {
-    MYSERIAL.write(ch);
+    SERIAL_OUT.write(ch);
     str++;
   }
 }
@@ -224,6 +274,8 @@ extern bool Running;
 inline bool IsRunning() { return  Running; }
 inline bool IsStopped() { return !Running; }
 
+extern bool cancel_heatup; // Set by M108 or the LCD to stop waiting for a heater
+
 bool enqueuecommand(const char *cmd); //put a single ASCII command at the end of the current buffer or return false when it is full
 void enqueuecommands_P(const char *cmd); //put one or many ASCII commands at the end of the current buffer, read from flash
 
@@ -263,8 +315,10 @@ extern bool axis_known_position[3]; // axis[n].is_known
     extern float delta_diagonal_rod;
     extern float delta_segments_per_second;
     void recalc_delta_settings(float radius, float diagonal_rod);
+    void calculate_delta_forward(const float tower[3], float cartesian[3]);
     #ifdef ENABLE_AUTO_BED_LEVELING
       extern int delta_grid_spacing[2];
+      float delta_bed_level_offset(const float cartesian[3]);
       void adjust_delta(float cartesian[3]);
     #endif
   #elif defined(SCARA)
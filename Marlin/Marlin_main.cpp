@@ -51,6 +51,9 @@
 #include "pins_arduino.h"
 #include "math.h"
 #include "buzzer.h"
+#include "isr_profiler.h"
+#include "gcode_parser.h"
+#include "command_queue.h"
 
 #ifdef BLINKM
   #include "blinkm.h"
@@ -142,13 +145,14 @@
  * M105 - Read current temp
  * M106 - Fan on
  * M107 - Fan off
+ * M108 - Stop waiting for heaters (M109, M190)
  * M109 - Sxxx Wait for extruder current temp to reach target temp. Waits only when heating
  *        Rxxx Wait for extruder current temp to reach target temp. Waits when heating and cooling
  *        IF AUTOTEMP is enabled, S<mintemp> B<maxtemp> F<factor>. Exit autotemp by any M109 without F
  * M110 - Set the current line number
  * M111 - Set debug flags with S<mask>. See flag bits defined in Marlin.h.
  * M112 - Emergency stop
- * M114 - Output current position to serial port
+ * M114 - Output current position to serial port. R for the real-time stepper position
  * M115 - Capabilities string
  * M117 - Display a message on the controller screen
  * M119 - Output Endstop status to serial port
@@ -161,6 +165,7 @@
  * M140 - Set bed target temp
  * M145 - Set the heatup state H<hotend> B<bed> F<fan speed> for S<material> (0=PLA, 1=ABS)
  * M150 - Set BlinkM Color Output R: Red<0-255> U(!): Green<0-255> B: Blue<0-255> over i2c, G for green does not work.
+ * M155 - Report the temperatures every S<seconds>, 0 to stop. C1 for the compact report
  * M190 - Sxxx Wait for bed current temp to reach target temp. Waits only when heating
  *        Rxxx Wait for bed current temp to reach target temp. Waits when heating and cooling
  * M200 - set filament diameter and set E axis units to cubic millimeters (use S0 to set back to millimeters).:D<millimeters>- 
@@ -180,11 +185,13 @@
  * M240 - Trigger a camera to take a photograph
  * M250 - Set LCD contrast C<contrast value> (value 0..63)
  * M280 - Set servo position absolute. P: servo index, S: angle or microseconds
+ * M290 - Babystep Z<mm> (or S<mm>), and X<mm> Y<mm> with BABYSTEP_XY. No parameters: report the babystep offset
  * M300 - Play beep sound S<frequency Hz> P<duration ms>
  * M301 - Set PID parameters P I and D
  * M302 - Allow cold extrudes, or set the minimum extrude S<temperature>.
- * M303 - PID relay autotune S<temperature> sets the target temperature. (default target temperature = 150C)
+ * M303 - PID relay autotune S<temperature> sets the target temperature. (default target temperature = 150C) Runs in the background, "ok" comes at once
  * M304 - Set bed PID parameters P I and D
+ * M306 - Set the MPC model of a hotend E<extruder> P<W> C<J/K> R<1/s> A<W/K> F<W/K> H<J/K/mm>, or autotune it with T [S<temperature>]
  * M380 - Activate solenoid on active extruder
  * M381 - Disable all solenoids
  * M400 - Finish all moves
@@ -197,6 +204,7 @@
  * M410 - Quickstop. Abort all the planned moves
  * M420 - Enable/Disable Mesh Leveling (with current values) S1=enable S0=disable
  * M421 - Set a single Z coordinate in the Mesh Leveling grid. X<mm> Y<mm> Z<mm>
+ * M425 - Set backlash compensation X<mm> Y<mm> Z<mm> F<fraction> S<smoothing mm> (Requires BACKLASH_COMPENSATION)
  * M428 - Set the home_offset logically based on the current_position
  * M500 - Store parameters in EEPROM
  * M501 - Read parameters from EEPROM (if you need reset them after you changed them temporarily).
@@ -223,7 +231,10 @@
  *
  * ************ Custom codes - This can change to suit future G-code regulations
  * M100 - Watch Free Memory (For Debugging Only)
+ * M801 - Report stepper and temperature ISR timing statistics, R to reset them (Requires ISR_PROFILING)
+ * M802 - Report serial output buffer peak use and dropped lines, R to reset them (Requires SERIAL_TX_BUFFER_SIZE)
  * M851 - Set probe's Z offset (mm above extruder -- The value will always be negative)
+ * M852 - Set skew correction factors I<xy> J<xz> K<yz> (Requires SKEW_CORRECTION)
 
 
  * M928 - Start SD logging (M928 filename.g) - ended by M29
@@ -252,13 +263,34 @@ float current_position[NUM_AXIS] = { 0.0 };
 static float destination[NUM_AXIS] = { 0.0 };
 bool axis_known_position[3] = { false };
 
-static long gcode_N, gcode_LastN, Stopped_gcode_LastN = 0;
+static long Stopped_gcode_LastN = 0;
 
 static char *current_command, *current_command_args;
-static int cmd_queue_index_r = 0;
-static int cmd_queue_index_w = 0;
-static int commands_in_queue = 0;
-static char command_queue[BUFSIZE][MAX_CMD_SIZE];
+
+#ifdef BINARY_GCODE
+  #include "binary_gcode.h"
+#else
+  #define IS_BINARY_COMMAND(cmd) false
+  #define IS_BINARY_M29(cmd) false
+#endif
+
+#ifdef SERIAL_PORT_2
+  static long serial_last_n[2];           // gcode_LastN of each port, while the other is selected
+  static char line_buffer_2[MAX_CMD_SIZE]; // The line being read from SERIAL_PORT_2
+  static int serial_count_2 = 0;
+  static boolean comment_mode_2 = false;
+
+  /**
+   * Send output to a port (0 for the main port, 1 for SERIAL_PORT_2)
+   * and take up its line numbers
+   */
+  static void serial_port_select(const uint8_t port) {
+    if (port == serial_ports.port) return;
+    serial_last_n[serial_ports.port] = gcode_LastN;
+    gcode_LastN = serial_last_n[port];
+    serial_ports.port = port;
+  }
+#endif
 
 const float homing_feedrate[] = HOMING_FEEDRATE;
 bool axis_relative_modes[] = AXIS_RELATIVE_MODES;
@@ -281,10 +313,10 @@ const char echomagic[] PROGMEM = "echo:";
 const char axis_codes[NUM_AXIS] = {'X', 'Y', 'Z', 'E'};
 
 static bool relative_mode = false;  //Determines Absolute or Relative Coordinates
-static char serial_char;
-static int serial_count = 0;
-static boolean comment_mode = false;
 static char *seen_pointer; ///< A pointer to find chars in the command string (X, Y, Z, E, etc.)
+
+static command_args_t command_args; ///< The parameters of the current command, see gcode_parser.h
+static uint8_t seen_index; ///< Letter of the last code_seen(), from 0 for 'A'
 const char* queued_commands_P= NULL; /* pointer to the current line in the active sequence of commands, or NULL when none */
 const int sensitive_pins[] = SENSITIVE_PINS; ///< Sensitive pin list for M42
 // Inactivity shutdown
@@ -405,8 +437,10 @@ bool target_direction;
    static bool filrunoutEnqueued = false;
 #endif
 
-#ifdef SDSUPPORT
-  static bool fromsd[BUFSIZE];
+#ifdef AUTO_REPORT_TEMPERATURES
+  static uint8_t auto_report_temp_interval = 0; // Seconds between M155 reports, 0 for none
+  static millis_t next_temp_report_ms;
+  static bool auto_report_temp_compact = false;
 #endif
 
 #if NUM_SERVOS > 0
@@ -424,6 +458,8 @@ bool target_direction;
 
 void process_next_command();
 
+void sync_position_from_steppers();
+
 void plan_arc(float target[NUM_AXIS], float *offset, uint8_t clockwise);
 
 bool setTargetedHotend(int code);
@@ -434,6 +470,11 @@ void serial_echopair_P(const char *s_P, float v)         { serialprintPGM(s_P);
 void serial_echopair_P(const char *s_P, double v)        { serialprintPGM(s_P); SERIAL_ECHO(v); }
 void serial_echopair_P(const char *s_P, unsigned long v) { serialprintPGM(s_P); SERIAL_ECHO(v); }
 
+void serial_print_float(const float &x, const uint8_t places) {
+  char buf[FTOSTR_SIZE];
+  SERIAL_OUT.write((const uint8_t *)buf, ftostr_fixed(buf, x, places) - buf);
+}
+
 #ifdef PREVENT_DANGEROUS_EXTRUDE
   float extrude_min_temp = EXTRUDE_MINTEMP;
 #endif
@@ -506,17 +547,12 @@ void enqueuecommands_P(const char* pgcode) {
  */
 bool enqueuecommand(const char *cmd) {
 
-  if (*cmd == ';' || commands_in_queue >= BUFSIZE) return false;
+  if (*cmd == ';' || !cmd_queue_push(cmd, false)) return false;
 
-  // This is dangerous if a mixing of serial and this happens
-  char *command = command_queue[cmd_queue_index_w];
-  strcpy(command, cmd);
   SERIAL_ECHO_START;
   SERIAL_ECHOPGM(MSG_Enqueueing);
-  SERIAL_ECHO(command);
+  SERIAL_ECHO(cmd);
   SERIAL_ECHOLNPGM("\"");
-  cmd_queue_index_w = (cmd_queue_index_w + 1) % BUFSIZE;
-  commands_in_queue++;
   return true;
 }
 
@@ -636,6 +672,9 @@ void setup() {
   #endif
 
   MYSERIAL.begin(BAUDRATE);
+  #ifdef SERIAL_PORT_2
+    SERIAL_PORT_2.begin(SERIAL_PORT_2_BAUDRATE);
+  #endif
   SERIAL_PROTOCOLLNPGM("start");
   SERIAL_ECHO_START;
 
@@ -679,6 +718,10 @@ void setup() {
   lcd_init();
   _delay_ms(1000);  // wait 1sec to display the splash screen
 
+  #ifdef ISR_PROFILING
+    isr_profile_init(); // Start the cycle counter before the ISRs run
+  #endif
+
   tp_init();    // Initialize temperature loop
   plan_init();  // Initialize planner;
   watchdog_init();
@@ -736,15 +779,29 @@ void loop() {
 
   if (commands_in_queue) {
 
+    #ifdef SERIAL_PORT_2
+      serial_port_select(command_port[cmd_queue_index_r]); // Respond where the command came from
+    #endif
+
     #ifdef SDSUPPORT
 
-      if (card.saving) {
-        char *command = command_queue[cmd_queue_index_r];
-        if (strstr_P(command, PSTR("M29"))) {
+      // Only the main port writes to the file
+      if (card.saving && !COMMAND_PORT(cmd_queue_index_r)) {
+        char *command = QUEUED_COMMAND(cmd_queue_index_r);
+        if (IS_BINARY_M29(command) || (!IS_BINARY_COMMAND(command) && strstr_P(command, PSTR("M29")))) {
           // M29 closes the file
           card.closefile();
           SERIAL_PROTOCOLLNPGM(MSG_FILE_SAVED);
         }
+        else if (IS_BINARY_COMMAND(command)) {
+          // The file is text, so a binary command is neither saved nor run. A log only misses it.
+          if (card.logging)
+            process_next_command();
+          else {
+            SERIAL_ERROR_START;
+            SERIAL_ERRORLNPGM(MSG_ERR_BINARY_SAVING);
+          }
+        }
         else {
           // Write the string from the read buffer to SD
           card.write_command(command);
@@ -763,151 +820,73 @@ void loop() {
 
     #endif // SDSUPPORT
 
-    commands_in_queue--;
-    cmd_queue_index_r = (cmd_queue_index_r + 1) % BUFSIZE;
+    #ifdef SERIAL_PORT_2
+      serial_port_select(0);
+    #endif
+
+    cmd_queue_pop();
   }
+
+  #ifdef EMERGENCY_PARSER
+    // Once the command that was running is done, as its moves kept the old position.
+    // The commands after it in the queue go on from where the steppers stopped.
+    if (emergency_quickstop) {
+      emergency_quickstop = false;
+      sync_position_from_steppers();
+    }
+  #endif
+
   checkHitEndstops();
   idle();
 }
 
-void gcode_line_error(const char *err, bool doFlush=true) {
-  SERIAL_ERROR_START;
-  serialprintPGM(err);
-  SERIAL_ERRORLN(gcode_LastN);
-  //Serial.println(gcode_N);
-  if (doFlush) FlushSerialRequestResend();
-  serial_count = 0;
-}
+#ifdef SERIAL_PORT_2
+
+  /**
+   * Queue a line from SERIAL_PORT_2, unless one of its commands is still
+   * in the queue. So it never holds more than one slot, and it gets one
+   * as soon as its last command is done.
+   */
+  static void get_serial_2_command() {
+    while (!port_2_queued && cmd_queue_has_room() && SERIAL_PORT_2.available() > 0) {
+      char c = SERIAL_PORT_2.read();
+      if (c == '\n' || c == '\r' || serial_count_2 >= MAX_CMD_SIZE - 1) {
+        comment_mode_2 = false;
+        if (!serial_count_2) continue;
+        line_buffer_2[serial_count_2] = 0;
+        serial_count_2 = 0;
+        serial_port_select(1);
+        serial_line_done(line_buffer_2);
+        serial_port_select(0);
+      }
+      else if (c == '\\') {
+        if (SERIAL_PORT_2.available() > 0) line_buffer_2[serial_count_2++] = SERIAL_PORT_2.read();
+      }
+      else {
+        if (c == ';') comment_mode_2 = true;
+        if (!comment_mode_2) line_buffer_2[serial_count_2++] = c;
+      }
+    }
+  }
+
+#endif // SERIAL_PORT_2
 
 /**
  * Add to the circular command queue the next command from:
  *  - The command-injection queue (queued_commands_P)
  *  - The active serial input (usually USB)
+ *  - The second serial port, if any
  *  - The SD card file being actively printed
  */
 void get_command() {
 
   if (drain_queued_commands_P()) return; // priority is given to non-serial commands
-  
-  #ifdef NO_TIMEOUTS
-    static millis_t last_command_time = 0;
-    millis_t ms = millis();
-  
-    if (!MYSERIAL.available() && commands_in_queue == 0 && ms - last_command_time > NO_TIMEOUTS) {
-      SERIAL_ECHOLNPGM(MSG_WAIT);
-      last_command_time = ms;
-    }
-  #endif
-
-  //
-  // Loop while serial characters are incoming and the queue is not full
-  //
-  while (commands_in_queue < BUFSIZE && MYSERIAL.available() > 0) {
-
-    #ifdef NO_TIMEOUTS
-      last_command_time = ms;
-    #endif
-
-    serial_char = MYSERIAL.read();
-
-    //
-    // If the character ends the line, or the line is full...
-    //
-    if (serial_char == '\n' || serial_char == '\r' || serial_count >= MAX_CMD_SIZE-1) {
-
-      // end of line == end of comment
-      comment_mode = false;
-
-      if (!serial_count) return; // empty lines just exit
-
-      char *command = command_queue[cmd_queue_index_w];
-      command[serial_count] = 0; // terminate string
-
-      // this item in the queue is not from sd
-      #ifdef SDSUPPORT
-        fromsd[cmd_queue_index_w] = false;
-      #endif
-
-      char *npos = strchr(command, 'N');
-      char *apos = strchr(command, '*');
-      if (npos) {
-
-        boolean M110 = strstr_P(command, PSTR("M110")) != NULL;
-
-        if (M110) {
-          char *n2pos = strchr(command + 4, 'N');
-          if (n2pos) npos = n2pos;
-        }
-
-        gcode_N = strtol(npos + 1, NULL, 10);
-
-        if (gcode_N != gcode_LastN + 1 && !M110) {
-          gcode_line_error(PSTR(MSG_ERR_LINE_NO));
-          return;
-        }
-
-        if (apos) {
-          byte checksum = 0, count = 0;
-          while (command[count] != '*') checksum ^= command[count++];
-
-          if (strtol(apos + 1, NULL, 10) != checksum) {
-            gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
-            return;
-          }
-          // if no errors, continue parsing
-        }
-        else if (npos == command) {
-          gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
-          return;
-        }
-
-        gcode_LastN = gcode_N;
-        // if no errors, continue parsing
-      }
-      else if (apos) { // No '*' without 'N'
-        gcode_line_error(PSTR(MSG_ERR_NO_LINENUMBER_WITH_CHECKSUM), false);
-        return;
-      }
-
-      // Movement commands alert when stopped
-      if (IsStopped()) {
-        char *gpos = strchr(command, 'G');
-        if (gpos) {
-          int codenum = strtol(gpos + 1, NULL, 10);
-          switch (codenum) {
-            case 0:
-            case 1:
-            case 2:
-            case 3:
-              SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
-              LCD_MESSAGEPGM(MSG_STOPPED);
-              break;
-          }
-        }        
-      }
-
-      // If command was e-stop process now
-      if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
-
-      cmd_queue_index_w = (cmd_queue_index_w + 1) % BUFSIZE;
-      commands_in_queue += 1;
-
-      serial_count = 0; //clear buffer
-    }
-    else if (serial_char == '\\') {  // Handle escapes
-      if (MYSERIAL.available() > 0 && commands_in_queue < BUFSIZE) {
-        // if we have one more character, copy it over
-        serial_char = MYSERIAL.read();
-        command_queue[cmd_queue_index_w][serial_count++] = serial_char;
-      }
-      // otherwise do nothing
-    }
-    else { // its not a newline, carriage return or escape char
-      if (serial_char == ';') comment_mode = true;
-      if (!comment_mode) command_queue[cmd_queue_index_w][serial_count++] = serial_char;
-    }
-  }
 
+  #ifdef SERIAL_PORT_2
+    get_serial_2_command();
+  #endif
+  
+  get_serial_commands();
 
   #if defined(SDSUPPORT) || defined(SDHSMCI_SUPPORT)
     if (!card.sdprinting || serial_count) return;
@@ -919,9 +898,9 @@ void get_command() {
     static bool stop_buffering = false;
     if (commands_in_queue == 0) stop_buffering = false;
 
-    while (!card.eof() && commands_in_queue < BUFSIZE && !stop_buffering) {
+    while (!card.eof() && cmd_queue_has_room() && !stop_buffering) {
       int16_t n = card.get();
-      serial_char = (char)n;
+      char serial_char = (char)n;
       if (serial_char == '\n' || serial_char == '\r' ||
           ((serial_char == '#' || serial_char == ':') && !comment_mode) ||
           serial_count >= (MAX_CMD_SIZE - 1) || n == -1
@@ -945,52 +924,49 @@ void get_command() {
           comment_mode = false; //for new command
           return; //if empty line
         }
-        command_queue[cmd_queue_index_w][serial_count] = 0; //terminate string
-        // if (!comment_mode) {
-        fromsd[cmd_queue_index_w] = true;
-        commands_in_queue += 1;
-        cmd_queue_index_w = (cmd_queue_index_w + 1) % BUFSIZE;
-        // }
+        line_buffer[serial_count] = 0; //terminate string
+        cmd_queue_push(line_buffer, true);
         comment_mode = false; //for new command
         serial_count = 0; //clear buffer
       }
       else {
         if (serial_char == ';') comment_mode = true;
-        if (!comment_mode) command_queue[cmd_queue_index_w][serial_count++] = serial_char;
+        if (!comment_mode) line_buffer[serial_count++] = serial_char;
       }
     }
 
   #endif // SDSUPPORT
 }
 
-bool code_has_value() {
-  int i = 1;
-  char c = seen_pointer[i];
-  if (c == '-' || c == '+') c = seen_pointer[++i];
-  if (c == '.') c = seen_pointer[++i];
-  return (c >= '0' && c <= '9');
+/**
+ * Where the free text of the current command starts, for parse_command_args()
+ * to stop there: a file name or a message. NULL for a command without text.
+ */
+static char* command_text(const char code, const int16_t codenum) {
+  if (code == 'M') switch (codenum) {
+    case 23: case 28: case 30: case 33: case 117: case 928:
+      return current_command_args;
+    case 32: { // The P and S flags come before the '!' and the name
+      char *bang = strchr(current_command_args, '!');
+      return bang ? bang : current_command_args;
+    }
+  }
+  return NULL;
 }
 
-float code_value() {
-  float ret;
-  char *e = strchr(seen_pointer, 'E');
-  if (e) {
-    *e = 0;
-    ret = strtod(seen_pointer+1, NULL);
-    *e = 'E';
-  }
-  else
-    ret = strtod(seen_pointer+1, NULL);
-  return ret;
-}
+bool code_has_value() { return TEST(command_args.has_value, seen_index); }
+
+float code_value() { return command_args.value[seen_index]; }
 
-long code_value_long() { return strtol(seen_pointer + 1, NULL, 10); }
+long code_value_long() { return command_args.value_long[seen_index]; }
 
-int16_t code_value_short() { return (int16_t)strtol(seen_pointer + 1, NULL, 10); }
+int16_t code_value_short() { return (int16_t)command_args.value_long[seen_index]; }
 
 bool code_seen(char code) {
-  seen_pointer = strchr(current_command_args, code);
-  return (seen_pointer != NULL); // Return TRUE if the code-letter was found
+  seen_index = code - 'A';
+  bool seen = seen_index < 26 && TEST(command_args.seen, seen_index);
+  seen_pointer = seen ? command_args.pointer[seen_index] : NULL;
+  return seen; // Return TRUE if the code-letter was found
 }
 
 #define DEFINE_PGM_READ_ANY(type, reader)       \
@@ -1048,6 +1024,10 @@ XYZ_CONSTS_FROM_CONFIG(signed char, home_dir, HOME_DIR);
 
 static void set_axis_is_at_home(AxisEnum axis) {
 
+  #ifdef BABYSTEPPING
+    babystepsTotal[axis] = 0; // Homing discards the babystep offset
+  #endif
+
   #ifdef DUAL_X_CARRIAGE
     if (axis == X_AXIS) {
       if (active_extruder != 0) {
@@ -1181,6 +1161,7 @@ static void setup_for_endstop_move() {
         vector_3 planeNormal = vector_3(-plane_equation_coefficients[0], -plane_equation_coefficients[1], 1);
         planeNormal.debug("planeNormal");
         plan_bed_level_matrix = matrix_3x3::create_look_at(planeNormal);
+        plan_update_transform();
         //bedLevel.debug("bedLevel");
 
         //plan_bed_level_matrix.debug("bed level before");
@@ -1203,6 +1184,7 @@ static void setup_for_endstop_move() {
     static void set_bed_level_equation_3pts(float z_at_pt_1, float z_at_pt_2, float z_at_pt_3) {
 
       plan_bed_level_matrix.set_to_identity();
+      plan_update_transform();
 
       vector_3 pt1 = vector_3(ABL_PROBE_PT_1_X, ABL_PROBE_PT_1_Y, z_at_pt_1);
       vector_3 pt2 = vector_3(ABL_PROBE_PT_2_X, ABL_PROBE_PT_2_Y, z_at_pt_2);
@@ -1216,6 +1198,7 @@ static void setup_for_endstop_move() {
       }
 
       plan_bed_level_matrix = matrix_3x3::create_look_at(planeNormal);
+      plan_update_transform();
 
       vector_3 corrected_position = plan_get_position();
       current_position[X_AXIS] = corrected_position.x;
@@ -1250,6 +1233,7 @@ static void setup_for_endstop_move() {
     #else // !DELTA
 
       plan_bed_level_matrix.set_to_identity();
+      plan_update_transform();
       feedrate = homing_feedrate[Z_AXIS];
 
       // Move down until the probe (or endstop?) is triggered
@@ -1730,6 +1714,10 @@ static void homeaxis(AxisEnum axis) {
     line_to_destination();
     st_synchronize();
 
+    #ifdef BACKLASH_COMPENSATION
+      plan_backlash_homed(axis, axis_home_dir); // The play is now on the endstop side
+    #endif
+
     #ifdef Z_DUAL_ENDSTOPS
       if (axis == Z_AXIS) {
         float adj = fabs(z_endstop_adj);
@@ -1886,6 +1874,13 @@ void gcode_get_destination() {
 void unknown_command_error() {
   SERIAL_ECHO_START;
   SERIAL_ECHOPGM(MSG_UNKNOWN_COMMAND);
+  #ifdef BINARY_GCODE
+    if (IS_BINARY_COMMAND(current_command)) {
+      SERIAL_CHAR(current_command[2]);
+      SERIAL_ECHO(BINARY_COMMAND_CODE(current_command));
+    }
+    else
+  #endif
   SERIAL_ECHO(current_command);
   SERIAL_ECHOPGM("\"\n");
 }
@@ -2009,11 +2004,20 @@ inline void gcode_G28() {
   // For auto bed leveling, clear the level matrix
   #ifdef ENABLE_AUTO_BED_LEVELING
     plan_bed_level_matrix.set_to_identity();
+    plan_update_transform();
     #ifdef DELTA
       reset_bed_level();
     #endif
   #endif
 
+  // Home in machine coordinates, so where an axis homes doesn't depend on where the others are
+  #ifdef SKEW_CORRECTION
+    plan_set_skew_enabled(false);
+    float machine[NUM_AXIS];
+    st_get_positions_mm(machine);
+    for (int i = X_AXIS; i <= Z_AXIS; i++) current_position[i] = machine[i];
+  #endif
+
   // For manual bed leveling deactivate the matrix temporarily
   #ifdef MESH_BED_LEVELING
     uint8_t mbl_was_active = mbl.active;
@@ -2236,6 +2240,13 @@ inline void gcode_G28() {
 
     sync_plan_position();
 
+    // Keep the steppers where they homed, at the logical point that is there with the skew
+    #ifdef SKEW_CORRECTION
+      plan_set_skew_enabled(true);
+      plan_unapply_transform(current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS]);
+      sync_plan_position();
+    #endif
+
   #endif // else DELTA
 
   #ifdef SCARA
@@ -2536,6 +2547,7 @@ inline void gcode_G28() {
     if (!dryrun) {
       // make sure the bed_level_rotation_matrix is identity or the planner will get it wrong
       plan_bed_level_matrix.set_to_identity();
+      plan_update_transform();
 
       #ifdef DELTA
         reset_bed_level();
@@ -3208,6 +3220,7 @@ inline void gcode_M42() {
 
     st_synchronize();
     plan_bed_level_matrix.set_to_identity();
+    plan_update_transform();
     plan_buffer_line(X_current, Y_current, Z_start_location, E_current, homing_feedrate[Z_AXIS] / 60, active_extruder);
     st_synchronize();
 
@@ -3386,18 +3399,19 @@ inline void gcode_M104() {
 }
 
 /**
- * M105: Read hot end and bed temperature
+ * Print the temperatures and heater powers, with hotend e as "T:".
+ * The compact form leaves out the temperatures that repeat: the
+ * per-extruder list with a single extruder, "T:" with several.
  */
-inline void gcode_M105() {
-  if (setTargetedHotend(105)) return;
-
+static void print_heaterstates(uint8_t e, bool compact) {
   #if HAS_TEMP_0 || HAS_TEMP_BED || defined(HEATER_0_USES_MAX6675)
-    SERIAL_PROTOCOLPGM(MSG_OK);
     #if HAS_TEMP_0 || defined(HEATER_0_USES_MAX6675)
-      SERIAL_PROTOCOLPGM(" T:");
-      SERIAL_PROTOCOL_F(degHotend(target_extruder), 1);
-      SERIAL_PROTOCOLPGM(" /");
-      SERIAL_PROTOCOL_F(degTargetHotend(target_extruder), 1);
+      if (!compact || EXTRUDERS == 1) {
+        SERIAL_PROTOCOLPGM(" T:");
+        SERIAL_PROTOCOL_F(degHotend(e), 1);
+        SERIAL_PROTOCOLPGM(" /");
+        SERIAL_PROTOCOL_F(degTargetHotend(e), 1);
+      }
     #endif
     #if HAS_TEMP_BED
       SERIAL_PROTOCOLPGM(" B:");
@@ -3405,25 +3419,24 @@ inline void gcode_M105() {
       SERIAL_PROTOCOLPGM(" /");
       SERIAL_PROTOCOL_F(degTargetBed(), 1);
     #endif
-    for (int8_t e = 0; e < EXTRUDERS; ++e) {
-      SERIAL_PROTOCOLPGM(" T");
-      SERIAL_PROTOCOL(e);
-      SERIAL_PROTOCOLCHAR(':');
-      SERIAL_PROTOCOL_F(degHotend(e), 1);
-      SERIAL_PROTOCOLPGM(" /");
-      SERIAL_PROTOCOL_F(degTargetHotend(e), 1);
+    if (!compact || EXTRUDERS > 1) {
+      for (int8_t cur_extruder = 0; cur_extruder < EXTRUDERS; ++cur_extruder) {
+        SERIAL_PROTOCOLPGM(" T");
+        SERIAL_PROTOCOL(cur_extruder);
+        SERIAL_PROTOCOLCHAR(':');
+        SERIAL_PROTOCOL_F(degHotend(cur_extruder), 1);
+        SERIAL_PROTOCOLPGM(" /");
+        SERIAL_PROTOCOL_F(degTargetHotend(cur_extruder), 1);
+      }
     }
-  #else // !HAS_TEMP_0 && !HAS_TEMP_BED
-    SERIAL_ERROR_START;
-    SERIAL_ERRORLNPGM(MSG_ERR_NO_THERMISTORS);
   #endif
 
   SERIAL_PROTOCOLPGM(" @:");
   #ifdef EXTRUDER_WATTS
-    SERIAL_PROTOCOL((EXTRUDER_WATTS * getHeaterPower(target_extruder))/127);
+    SERIAL_PROTOCOL((EXTRUDER_WATTS * getHeaterPower(e))/127);
     SERIAL_PROTOCOLCHAR('W');
   #else
-    SERIAL_PROTOCOL(getHeaterPower(target_extruder));
+    SERIAL_PROTOCOL(getHeaterPower(e));
   #endif
 
   SERIAL_PROTOCOLPGM(" B@:");
@@ -3450,10 +3463,51 @@ inline void gcode_M105() {
       SERIAL_PROTOCOL_F(rawHotendTemp(cur_extruder)/OVERSAMPLENR,0);
     }
   #endif
+}
 
+/**
+ * M105: Read hot end and bed temperature
+ */
+inline void gcode_M105() {
+  if (setTargetedHotend(105)) return;
+
+  #if HAS_TEMP_0 || HAS_TEMP_BED || defined(HEATER_0_USES_MAX6675)
+    SERIAL_PROTOCOLPGM(MSG_OK);
+  #else // !HAS_TEMP_0 && !HAS_TEMP_BED
+    SERIAL_ERROR_START;
+    SERIAL_ERRORLNPGM(MSG_ERR_NO_THERMISTORS);
+  #endif
+
+  print_heaterstates(target_extruder, false);
   SERIAL_EOL;
 }
 
+#ifdef AUTO_REPORT_TEMPERATURES
+
+  /**
+   * M155: Report the temperatures automatically
+   *       S<seconds> between reports, 0 to stop
+   *       C<1|0> use the compact report
+   */
+  inline void gcode_M155() {
+    if (code_seen('S')) {
+      auto_report_temp_interval = constrain(code_value_short(), 0, 60);
+      next_temp_report_ms = millis() + 1000UL * auto_report_temp_interval;
+    }
+    if (code_seen('C')) auto_report_temp_compact = code_value_short() != 0;
+  }
+
+  // Called from idle() to send the report when it's due
+  static void auto_report_temperatures() {
+    if (auto_report_temp_interval && millis() >= next_temp_report_ms) {
+      next_temp_report_ms = millis() + 1000UL * auto_report_temp_interval;
+      print_heaterstates(active_extruder, auto_report_temp_compact);
+      SERIAL_EOL;
+    }
+  }
+
+#endif // AUTO_REPORT_TEMPERATURES
+
 #if HAS_FAN
 
   /**
@@ -3616,6 +3670,11 @@ inline void gcode_M111() {
  */
 inline void gcode_M112() { kill(PSTR(MSG_KILLED)); }
 
+/**
+ * M108: Stop waiting for heaters (M109, M190)
+ */
+inline void gcode_M108() { cancel_heatup = true; }
+
 #ifdef BARICUDA
 
   #if HAS_HEATER_1
@@ -3826,10 +3885,72 @@ inline void gcode_M92() {
   }
 }
 
+/**
+ * The position the steppers are at right now, converted back to cartesian
+ * coordinates and with the bed leveling undone
+ */
+static void get_realtime_position(float pos[NUM_AXIS]) {
+  st_get_positions_mm(pos);
+
+  #ifdef DELTA
+    float cartesian[3];
+    calculate_delta_forward(pos, cartesian);
+    #ifdef ENABLE_AUTO_BED_LEVELING
+      // adjust_delta raised all three towers alike, which raised the effector as much
+      cartesian[Z_AXIS] -= delta_bed_level_offset(cartesian);
+    #endif
+    memcpy(pos, cartesian, sizeof(cartesian));
+  #elif defined(SCARA)
+    // The steppers count arm angles. The forward transform works in delta[],
+    // which M114 also reports, so keep it.
+    float angles[2] = { delta[X_AXIS], delta[Y_AXIS] };
+    delta[X_AXIS] = pos[X_AXIS];
+    delta[Y_AXIS] = pos[Y_AXIS];
+    calculate_SCARA_forward_Transform(delta);
+    pos[X_AXIS] = delta[X_AXIS] / axis_scaling[X_AXIS];
+    pos[Y_AXIS] = delta[Y_AXIS] / axis_scaling[Y_AXIS];
+    delta[X_AXIS] = angles[X_AXIS];
+    delta[Y_AXIS] = angles[Y_AXIS];
+  #else
+    #if defined(ENABLE_AUTO_BED_LEVELING) || defined(SKEW_CORRECTION)
+      plan_unapply_transform(pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS]);
+    #endif
+    #ifdef MESH_BED_LEVELING
+      if (mbl.active) pos[Z_AXIS] -= mbl.get_z(pos[X_AXIS], pos[Y_AXIS]);
+    #endif
+  #endif
+}
+
+/**
+ * Output the position the steppers are at right now. Unlike the regular
+ * M114 output this doesn't have to wait for the buffered moves.
+ */
+static void report_realtime_position() {
+  float pos[NUM_AXIS];
+  get_realtime_position(pos);
+
+  SERIAL_PROTOCOLPGM("X:");
+  SERIAL_PROTOCOL(pos[X_AXIS]);
+  SERIAL_PROTOCOLPGM(" Y:");
+  SERIAL_PROTOCOL(pos[Y_AXIS]);
+  SERIAL_PROTOCOLPGM(" Z:");
+  SERIAL_PROTOCOL(pos[Z_AXIS]);
+  SERIAL_PROTOCOLPGM(" E:");
+  SERIAL_PROTOCOL(pos[E_AXIS]);
+  SERIAL_EOL;
+}
+
 /**
  * M114: Output current position to serial port
+ *
+ *   R - Report the real-time stepper position instead, without waiting for moves to finish
  */
 inline void gcode_M114() {
+  if (code_seen('R')) {
+    report_realtime_position();
+    return;
+  }
+
   SERIAL_PROTOCOLPGM("X:");
   SERIAL_PROTOCOL(current_position[X_AXIS]);
   SERIAL_PROTOCOLPGM(" Y:");
@@ -3874,6 +3995,20 @@ inline void gcode_M114() {
  */
 inline void gcode_M115() {
   SERIAL_PROTOCOLPGM(MSG_M115_REPORT);
+  #ifdef AUTO_REPORT_TEMPERATURES
+    SERIAL_PROTOCOLLNPGM("Cap:AUTOREPORT_TEMP:1");
+  #endif
+  #ifdef ADVANCED_OK
+    SERIAL_PROTOCOLLNPGM("Cap:ADVANCED_OK:1");
+  #endif
+  #if defined(ADVANCED_OK) || defined(BINARY_GCODE)
+    SERIAL_PROTOCOLPGM("Cap:RX_BUFFER:");
+    SERIAL_PROTOCOLLN(SERIAL_RX_BUFFER_BYTES);
+  #endif
+  #ifdef BINARY_GCODE
+    SERIAL_PROTOCOLPGM("Cap:BINARY_GCODE:");
+    SERIAL_PROTOCOLLN(BINARY_GCODE_WINDOW);
+  #endif
 }
 
 /**
@@ -4303,6 +4438,39 @@ inline void gcode_M226() {
 
 #endif // NUM_SERVOS > 0
 
+#ifdef BABYSTEPPING
+
+  /**
+   * M290: Babystep, moving the nozzle without changing the current position
+   *
+   *   Z<mm> or S<mm>  Babystep the Z axis
+   *   X<mm> Y<mm>     Babystep X and Y (Requires BABYSTEP_XY)
+   *
+   *   Without parameters, report the babystep offset accumulated since homing.
+   */
+  inline void gcode_M290() {
+    bool seen = false;
+    for (int8_t i = X_AXIS; i <= Z_AXIS; i++) {
+      #ifndef BABYSTEP_XY
+        if (i != Z_AXIS) continue;
+      #endif
+      if (code_seen(axis_codes[i]) || (i == Z_AXIS && code_seen('S'))) {
+        babystep_axis((AxisEnum)i, lround(code_value() * axis_steps_per_unit[i]));
+        seen = true;
+      }
+    }
+    if (!seen) {
+      SERIAL_ECHO_START;
+      SERIAL_ECHOPGM(MSG_BABYSTEP_OFFSET);
+      SERIAL_ECHOPAIR(" X:", babystepsTotal[X_AXIS] / axis_steps_per_unit[X_AXIS]);
+      SERIAL_ECHOPAIR(" Y:", babystepsTotal[Y_AXIS] / axis_steps_per_unit[Y_AXIS]);
+      SERIAL_ECHOPAIR(" Z:", babystepsTotal[Z_AXIS] / axis_steps_per_unit[Z_AXIS]);
+      SERIAL_EOL;
+    }
+  }
+
+#endif // BABYSTEPPING
+
 #if HAS_BUZZER
 
   /**
@@ -4383,6 +4551,49 @@ inline void gcode_M226() {
 
 #endif // PIDTEMPBED
 
+#ifdef MPCTEMP
+
+  /**
+   * M306: Set the MPC thermal model of a hotend, or autotune it
+   *       E<extruder> (default 0)
+   *       P<watts> heater power
+   *       C<joules/kelvin> block heat capacity
+   *       R<1/seconds> sensor responsiveness
+   *       A<watts/kelvin> heat loss to ambient with the fan off
+   *       F<watts/kelvin> heat loss to ambient with the fan at full speed
+   *       H<joules/kelvin/mm> filament heat capacity
+   *       T autotune at S<temperature> (default 200C)
+   */
+  inline void gcode_M306() {
+    int e = code_seen('E') ? code_value_short() : 0;
+    if (e < 0 || e >= EXTRUDERS) {
+      SERIAL_ECHO_START;
+      SERIAL_ECHOLN(MSG_INVALID_EXTRUDER);
+      return;
+    }
+
+    if (code_seen('T')) {
+      float temp = code_seen('S') ? code_value() : 200.0;
+      st_synchronize();
+      MPC_autotune(e, temp);
+      return;
+    }
+
+    mpc_t &m = mpc[e];
+    float fan255_xfer_coeff = m.ambient_xfer_coeff_fan0 + m.fan255_adjustment;
+    if (code_seen('P')) m.heater_power = code_value();
+    if (code_seen('C')) m.block_heat_capacity = code_value();
+    if (code_seen('R')) m.sensor_responsiveness = code_value();
+    if (code_seen('A')) m.ambient_xfer_coeff_fan0 = code_value();
+    if (code_seen('F')) fan255_xfer_coeff = code_value();
+    if (code_seen('H')) m.filament_heat_capacity_permm = code_value();
+    m.fan255_adjustment = fan255_xfer_coeff - m.ambient_xfer_coeff_fan0;
+
+    MPC_print(e);
+  }
+
+#endif // MPCTEMP
+
 #if defined(CHDK) || HAS_PHOTOGRAPH
 
   /**
@@ -4450,7 +4661,10 @@ inline void gcode_M226() {
  * M303: PID relay autotune
  *       S<temperature> sets the target temperature. (default target temperature = 150C)
  *       E<extruder> (-1 for the bed)
- *       C<cycles>
+ *       C<cycles> at most, it ends sooner once Ku and Tu settle
+ *
+ *       Answers "ok" at once, the tuning runs while other commands are processed.
+ *       Hosts should wait for the "finished" or "failed" message, not the "ok".
  */
 inline void gcode_M303() {
   int e = code_seen('E') ? code_value_short() : 0;
@@ -4673,13 +4887,34 @@ inline void gcode_M400() { st_synchronize(); }
 
 #endif // FILAMENT_SENSOR
 
+/**
+ * After a quickstop the planner and current_position are still where the
+ * aborted moves would have ended. Take both from where the steppers stopped.
+ */
+void sync_position_from_steppers() {
+  st_synchronize();
+  get_realtime_position(current_position);
+  #if defined(DELTA) || defined(SCARA)
+    float pos[NUM_AXIS];
+    st_get_positions_mm(pos); // The towers or arms, as the planner counts them
+    plan_set_position(pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS], pos[E_AXIS]);
+  #else
+    sync_plan_position();
+  #endif
+  set_destination_to_current();
+}
+
 /**
  * M410: Quickstop - Abort all planned moves
  *
- * This will stop the carriages mid-move, so most likely they
- * will be out of sync with the stepper position after this.
+ * This will stop the carriages mid-move. The position is taken from
+ * where the steppers stopped, but steps may have been lost, so home
+ * again before printing.
  */
-inline void gcode_M410() { quickStop(); }
+inline void gcode_M410() {
+  quickStop();
+  sync_position_from_steppers();
+}
 
 
 #ifdef MESH_BED_LEVELING
@@ -4716,6 +4951,47 @@ inline void gcode_M410() { quickStop(); }
 
 #endif
 
+#ifdef BACKLASH_COMPENSATION
+
+  /**
+   * M425: Set backlash compensation
+   *
+   *   X Y Z - Play of each axis (mm)
+   *   F     - Fraction of the play to compensate, 0.0 (off) to 1.0
+   *   S     - Distance (mm) to spread each correction over, 0 to apply it at once
+   *
+   * Without parameters report the current settings.
+   */
+  inline void gcode_M425() {
+    bool noArgs = true;
+    for (int8_t i = X_AXIS; i <= Z_AXIS; i++) {
+      if (code_seen(axis_codes[i])) {
+        backlash_distance_mm[i] = max(0, code_value());
+        noArgs = false;
+      }
+    }
+    if (code_seen('F')) {
+      backlash_correction = constrain(code_value(), 0, 1);
+      noArgs = false;
+    }
+    if (code_seen('S')) {
+      backlash_smoothing_mm = max(0, code_value());
+      noArgs = false;
+    }
+
+    if (noArgs) {
+      SERIAL_ECHO_START;
+      SERIAL_ECHOPAIR("Backlash X:", backlash_distance_mm[X_AXIS]);
+      SERIAL_ECHOPAIR(" Y:", backlash_distance_mm[Y_AXIS]);
+      SERIAL_ECHOPAIR(" Z:", backlash_distance_mm[Z_AXIS]);
+      SERIAL_ECHOPAIR(" F:", backlash_correction);
+      SERIAL_ECHOPAIR(" S:", backlash_smoothing_mm);
+      SERIAL_EOL;
+    }
+  }
+
+#endif // BACKLASH_COMPENSATION
+
 /**
  * M428: Set home_offset based on the distance between the
  *       current_position and the nearest "reference point."
@@ -4835,6 +5111,52 @@ inline void gcode_M503() {
 
 #endif // CUSTOM_M_CODE_SET_Z_PROBE_OFFSET
 
+#ifdef SKEW_CORRECTION
+
+  /**
+   * M852: Set skew correction factors
+   *
+   *   I - XY skew factor (S is accepted too)
+   *   J - XZ skew factor
+   *   K - YZ skew factor
+   *
+   * Without parameters report the current factors.
+   */
+  inline void gcode_M852() {
+    bool changed = false;
+    if (code_seen('I') || code_seen('S')) {
+      skew_factor_xy = code_value();
+      changed = true;
+    }
+    if (code_seen('J')) {
+      skew_factor_xz = code_value();
+      changed = true;
+    }
+    if (code_seen('K')) {
+      skew_factor_yz = code_value();
+      changed = true;
+    }
+
+    if (changed) {
+      // Finish the moves planned with the old factors, then re-plan from the current position
+      st_synchronize();
+      plan_update_transform();
+      sync_plan_position();
+    }
+    else {
+      SERIAL_ECHO_START;
+      SERIAL_ECHOPGM("Skew I:");
+      SERIAL_PROTOCOL_F(skew_factor_xy, 6);
+      SERIAL_ECHOPGM(" J:");
+      SERIAL_PROTOCOL_F(skew_factor_xz, 6);
+      SERIAL_ECHOPGM(" K:");
+      SERIAL_PROTOCOL_F(skew_factor_yz, 6);
+      SERIAL_EOL;
+    }
+  }
+
+#endif // SKEW_CORRECTION
+
 #ifdef FILAMENTCHANGEENABLE
 
   /**
@@ -5092,6 +5414,28 @@ inline void gcode_M800() {
 	//SERIAL_ECHOLN(get_fsr_value());
 }
 
+#ifdef ISR_PROFILING
+
+  /**
+   * M801: Report stepper and temperature ISR timing statistics
+   *
+   *   R  Reset the statistics after reporting
+   */
+  inline void gcode_M801() { isr_profile_report(code_seen('R')); }
+
+#endif // ISR_PROFILING
+
+#ifdef SERIAL_TX_BUFFER_SIZE
+
+  /**
+   * M802: Report the serial output buffer peak use and dropped lines
+   *
+   *   R  Reset them after reporting
+   */
+  inline void gcode_M802() { serial_tx.report(code_seen('R')); }
+
+#endif // SERIAL_TX_BUFFER_SIZE
+
 /**
  * M999: Restart after being stopped
  */
@@ -5111,7 +5455,7 @@ inline void gcode_T(uint8_t tmp_extruder) {
   if (tmp_extruder >= EXTRUDERS) {
     SERIAL_ECHO_START;
     SERIAL_CHAR('T');
-    SERIAL_PROTOCOL_F(tmp_extruder,DEC);
+    SERIAL_PROTOCOL((int)tmp_extruder);
     SERIAL_ECHOLN(MSG_INVALID_EXTRUDER);
   }
   else {
@@ -5214,7 +5558,26 @@ inline void gcode_T(uint8_t tmp_extruder) {
  * This is called from the main loop()
  */
 void process_next_command() {
-  current_command = command_queue[cmd_queue_index_r];
+  current_command = QUEUED_COMMAND(cmd_queue_index_r);
+
+  char command_code, *starpos;
+  bool code_is_good;
+  int codenum; // define ahead of goto
+
+  #ifdef BINARY_GCODE
+    // Binary commands arrive parsed
+    if (IS_BINARY_COMMAND(current_command)) {
+      command_code = current_command[2];
+      codenum = parse_binary_command(command_args, current_command, &current_command_args);
+      code_is_good = true;
+      if ((marlin_debug_flags & DEBUG_ECHO)) {
+        SERIAL_ECHO_START;
+        SERIAL_CHAR(command_code);
+        SERIAL_ECHOLN(codenum);
+      }
+      goto DispatchCommand;
+    }
+  #endif
 
   if ((marlin_debug_flags & DEBUG_ECHO)) {
     SERIAL_ECHO_START;
@@ -5231,29 +5594,31 @@ void process_next_command() {
     while (*current_command >= '0' && *current_command <= '9') ++current_command; // skip [0-9]*
     while (*current_command == ' ') ++current_command; // skip [ ]*
   }
-  char *starpos = strchr(current_command, '*');  // * should always be the last parameter
+  starpos = strchr(current_command, '*');  // * should always be the last parameter
   if (starpos) while (*starpos == ' ' || *starpos == '*') *starpos-- = '\0'; // nullify '*' and ' '
 
   // Get the command code, which must be G, M, or T
-  char command_code = *current_command;
+  command_code = *current_command;
 
   // The code must have a numeric value
-  bool code_is_good = (current_command[1] >= '0' && current_command[1] <= '9');
-
-  int codenum; // define ahead of goto
+  code_is_good = (current_command[1] >= '0' && current_command[1] <= '9');
 
   // Bail early if there's no code
   if (!code_is_good) goto ExitUnknownCommand;
 
-  // Args pointer optimizes code_seen, especially those taking XYZEF
-  // This wastes a little cpu on commands that expect no arguments.
+  // The arguments follow the code, and are parsed once for code_seen and code_value
   current_command_args = current_command;
   while (*current_command_args && *current_command_args != ' ') ++current_command_args;
   while (*current_command_args == ' ') ++current_command_args;
 
   // Interpret the code int
-  seen_pointer = current_command;
-  codenum = code_value_short();
+  codenum = (int16_t)gcode_strtol(current_command + 1);
+
+  parse_command_args(command_args, current_command_args, command_text(command_code, codenum));
+
+  #ifdef BINARY_GCODE
+    DispatchCommand:
+  #endif
 
   // Handle a known G, M, or T
   switch(command_code) {
@@ -5443,9 +5808,27 @@ void process_next_command() {
         gcode_M111();
         break;
 
-      case 112: // M112: Emergency Stop
-        gcode_M112();
-        break;
+      #ifdef EMERGENCY_PARSER
+        case 108: // M108, M112 and M410 acted when received
+        case 112:
+        case 410:
+          #ifdef SERIAL_PORT_2
+            if (SELECTED_PORT) switch (codenum) { // Only MYSERIAL goes through the parser
+              case 108: gcode_M108(); break;
+              case 112: gcode_M112(); break;
+              case 410: gcode_M410(); break;
+            }
+          #endif
+          break;
+      #else
+        case 108: // M108: Stop waiting for heaters
+          gcode_M108();
+          break;
+
+        case 112: // M112: Emergency Stop
+          gcode_M112();
+          break;
+      #endif
 
       case 140: // M140: Set bed temp
         gcode_M140();
@@ -5455,6 +5838,12 @@ void process_next_command() {
         gcode_M105();
         return; // "ok" already printed
 
+      #ifdef AUTO_REPORT_TEMPERATURES
+        case 155: // M155: Set the temperature auto-report interval
+          gcode_M155();
+          break;
+      #endif
+
       case 109: // M109: Wait for temperature
         gcode_M109();
         break;
@@ -5656,6 +6045,12 @@ void process_next_command() {
           SerialUSB.print("ReadByte: "); SerialUSB.println(spiflash_read_byte(2));
           break;
       
+      #ifdef BABYSTEPPING
+        case 290: // M290 - Babystep
+          gcode_M290();
+          break;
+      #endif // BABYSTEPPING
+
       #if HAS_BUZZER
         case 300: // M300 - Play beep tone
           gcode_M300();
@@ -5674,6 +6069,12 @@ void process_next_command() {
           break;
       #endif // PIDTEMPBED
 
+      #ifdef MPCTEMP
+        case 306: // M306 MPC model and autotune
+          gcode_M306();
+          break;
+      #endif // MPCTEMP
+
       #if defined(CHDK) || HAS_PHOTOGRAPH
         case 240: // M240  Triggers a camera by emulating a Canon RC-1 : http://www.doc-diy.net/photo/rc-1_hacked/
           gcode_M240();
@@ -5745,9 +6146,11 @@ void process_next_command() {
           break;
       #endif // FILAMENT_SENSOR
 
-      case 410: // M410 quickstop - Abort all the planned moves.
-        gcode_M410();
-        break;
+      #ifndef EMERGENCY_PARSER
+        case 410: // M410 quickstop - Abort all the planned moves.
+          gcode_M410();
+          break;
+      #endif
 
       #ifdef MESH_BED_LEVELING
         case 420: // M420 Enable/Disable Mesh Bed Leveling
@@ -5758,6 +6161,12 @@ void process_next_command() {
           break;
       #endif
 
+      #ifdef BACKLASH_COMPENSATION
+        case 425: // M425 Set backlash compensation
+          gcode_M425();
+          break;
+      #endif
+
       case 428: // M428 Apply current_position to home_offset
         gcode_M428();
         break;
@@ -5787,6 +6196,12 @@ void process_next_command() {
           break;
       #endif // CUSTOM_M_CODE_SET_Z_PROBE_OFFSET
 
+      #ifdef SKEW_CORRECTION
+        case 852: // M852 Set skew correction factors
+          gcode_M852();
+          break;
+      #endif
+
       #ifdef FILAMENTCHANGEENABLE
         case 600: //Pause for filament change X[pos] Y[pos] Z[relative lift] E[initial retract] L[later retract distance for removal]
           gcode_M600();
@@ -5823,6 +6238,16 @@ void process_next_command() {
       case 800:
     	gcode_M800();
     	break;
+      #ifdef ISR_PROFILING
+        case 801: // M801: Report ISR timing statistics
+          gcode_M801();
+          break;
+      #endif
+      #ifdef SERIAL_TX_BUFFER_SIZE
+        case 802: // M802: Report serial output buffer statistics
+          gcode_M802();
+          break;
+      #endif
       case 999: // M999: Restart after being Stopped
         gcode_M999();
         break;
@@ -5841,29 +6266,8 @@ ExitUnknownCommand:
   // Still unknown command? Throw an error
   if (!code_is_good) unknown_command_error();
 
-  ok_to_send();
-}
-
-void FlushSerialRequestResend() {
-  //char command_queue[cmd_queue_index_r][100]="Resend:";
-  MYSERIAL.flush();
-  SERIAL_PROTOCOLPGM(MSG_RESEND);
-  SERIAL_PROTOCOLLN(gcode_LastN + 1);
-  ok_to_send();
-}
-
-void ok_to_send() {
-  refresh_cmd_timeout();
-  #ifdef SDSUPPORT
-    if (fromsd[cmd_queue_index_r]) return;
-  #endif
-  SERIAL_PROTOCOLPGM(MSG_OK);
-  #ifdef ADVANCED_OK
-    SERIAL_PROTOCOLPGM(" N"); SERIAL_PROTOCOL(gcode_LastN);
-    SERIAL_PROTOCOLPGM(" P"); SERIAL_PROTOCOL(int(BLOCK_BUFFER_SIZE - movesplanned() - 1));
-    SERIAL_PROTOCOLPGM(" B"); SERIAL_PROTOCOL(BUFSIZE - commands_in_queue);
-  #endif
-  SERIAL_EOL;  
+  // Binary commands were acknowledged when queued
+  if (!IS_BINARY_COMMAND(QUEUED_COMMAND(cmd_queue_index_r))) ok_to_send();
 }
 
 void clamp_to_software_endstops(float target[3]) {
@@ -5922,11 +6326,42 @@ void clamp_to_software_endstops(float target[3]) {
     */
   }
 
+  /**
+   * Inverse of calculate_delta: the effector position for the given tower
+   * carriage heights. The effector is the lower intersection of three spheres
+   * of radius delta_diagonal_rod centered on the carriages (trilateration).
+   */
+  void calculate_delta_forward(const float tower[3], float cartesian[3]) {
+    // Unit vector ex from carriage 1 to carriage 2, d is their distance
+    float p12[3] = { delta_tower2_x - delta_tower1_x, delta_tower2_y - delta_tower1_y, tower[Y_AXIS] - tower[X_AXIS] },
+          p13[3] = { delta_tower3_x - delta_tower1_x, delta_tower3_y - delta_tower1_y, tower[Z_AXIS] - tower[X_AXIS] },
+          d = sqrt(sq(p12[0]) + sq(p12[1]) + sq(p12[2])),
+          ex[3] = { p12[0] / d, p12[1] / d, p12[2] / d },
+          // Component i of carriage 3 along ex, the rest gives the unit vector ey
+          i = ex[0] * p13[0] + ex[1] * p13[1] + ex[2] * p13[2],
+          ey[3] = { p13[0] - ex[0] * i, p13[1] - ex[1] * i, p13[2] - ex[2] * i },
+          j = sqrt(sq(ey[0]) + sq(ey[1]) + sq(ey[2]));
+    for (int8_t n = 0; n < 3; n++) ey[n] /= j;
+    float ez[3] = {
+            ex[1] * ey[2] - ex[2] * ey[1],
+            ex[2] * ey[0] - ex[0] * ey[2],
+            ex[0] * ey[1] - ex[1] * ey[0]
+          },
+          // Equal rods, so the sphere radii cancel out of x and y
+          x = d / 2,
+          y = (sq(i) + sq(j)) / (2 * j) - i * x / j,
+          z = sqrt(delta_diagonal_rod_2 - sq(x) - sq(y));
+    // The effector hangs below the carriages
+    cartesian[X_AXIS] = delta_tower1_x + ex[0] * x + ey[0] * y - ez[0] * z;
+    cartesian[Y_AXIS] = delta_tower1_y + ex[1] * x + ey[1] * y - ez[1] * z;
+    cartesian[Z_AXIS] = tower[X_AXIS]  + ex[2] * x + ey[2] * y - ez[2] * z;
+  }
+
   #ifdef ENABLE_AUTO_BED_LEVELING
 
-    // Adjust print surface height by linear interpolation over the bed_level array.
-    void adjust_delta(float cartesian[3]) {
-      if (delta_grid_spacing[0] == 0 || delta_grid_spacing[1] == 0) return; // G29 not done!
+    // Print surface height at the given XY, by linear interpolation over the bed_level array.
+    float delta_bed_level_offset(const float cartesian[3]) {
+      if (delta_grid_spacing[0] == 0 || delta_grid_spacing[1] == 0) return 0; // G29 not done!
 
       int half = (AUTO_BED_LEVELING_GRID_POINTS - 1) / 2;
       float h1 = 0.001 - half, h2 = half - 0.001,
@@ -5942,10 +6377,6 @@ void clamp_to_software_endstops(float target[3]) {
             right = (1 - ratio_y) * z3 + ratio_y * z4,
             offset = (1 - ratio_x) * left + ratio_x * right;
 
-      delta[X_AXIS] += offset;
-      delta[Y_AXIS] += offset;
-      delta[Z_AXIS] += offset;
-
       /*
       SERIAL_ECHOPGM("grid_x="); SERIAL_ECHO(grid_x);
       SERIAL_ECHOPGM(" grid_y="); SERIAL_ECHO(grid_y);
@@ -5961,6 +6392,16 @@ void clamp_to_software_endstops(float target[3]) {
       SERIAL_ECHOPGM(" right="); SERIAL_ECHO(right);
       SERIAL_ECHOPGM(" offset="); SERIAL_ECHOLN(offset);
       */
+
+      return offset;
+    }
+
+    // Adjust print surface height by linear interpolation over the bed_level array.
+    void adjust_delta(float cartesian[3]) {
+      float offset = delta_bed_level_offset(cartesian);
+      delta[X_AXIS] += offset;
+      delta[Y_AXIS] += offset;
+      delta[Z_AXIS] += offset;
     }
   #endif // ENABLE_AUTO_BED_LEVELING
 
@@ -6343,7 +6784,7 @@ void plan_arc(
     millis_t ms = millis();
     if (ms >= lastMotorCheck + 2500) { // Not a time critical function, so we only check every 2500ms
       lastMotorCheck = ms;
-      if (X_ENABLE_READ == X_ENABLE_ON || Y_ENABLE_READ == Y_ENABLE_ON || Z_ENABLE_READ == Z_ENABLE_ON || soft_pwm_bed > 0
+      if (X_ENABLE_READ == X_ENABLE_ON || Y_ENABLE_READ == Y_ENABLE_ON || Z_ENABLE_READ == Z_ENABLE_ON || getHeaterPower(-1) > 0
         || E0_ENABLE_READ == E_ENABLE_ON // If any of the drivers are enabled...
         #if EXTRUDERS > 1
           || E1_ENABLE_READ == E_ENABLE_ON
@@ -6505,10 +6946,28 @@ void disable_all_steppers() {
  * Standard idle routine keeps the machine alive
  */
 void idle() {
+  #ifdef SERIAL_PORT_2
+    // What's output from here isn't a reply to the command being run: auto-reports,
+    // heater errors, SD "Done printing" and the main port's line errors
+    const uint8_t port = SELECTED_PORT;
+    serial_port_select(0);
+  #endif
+  #ifdef EMERGENCY_PARSER
+    emergency_parser_poll();
+  #endif
+  #ifdef SERIAL_TX_BUFFER_SIZE
+    serial_tx.drain();
+  #endif
   manage_heater();
   manage_inactivity();
+  #ifdef AUTO_REPORT_TEMPERATURES
+    auto_report_temperatures();
+  #endif
   lcd_update();
   //get_fsr_value();
+  #ifdef SERIAL_PORT_2
+    serial_port_select(port);
+  #endif
 }
 
 /**
@@ -6691,11 +7150,17 @@ void kill(const char *lcd_msg) {
     pinMode(PS_ON_PIN, INPUT);
   #endif
 
+  #ifdef SERIAL_PORT_2
+    serial_port_select(0); // The host must know, whoever sent M112
+  #endif
   SERIAL_ERROR_START;
   SERIAL_ERRORLNPGM(MSG_ERR_KILLED);
   
   // FMC small patch to update the LCD before ending
   sei();   // enable interrupts
+  #ifdef SERIAL_TX_BUFFER_SIZE
+    serial_tx.flush();
+  #endif
   for (int i = 5; i--; lcd_update()) delay(200); // Wait a short time
   cli();   // disable interrupts
   suicide();
@@ -209,6 +209,39 @@
 
   #endif // ENABLE_AUTO_BED_LEVELING
 
+  /**
+   * Skew correction works on cartesian coordinates
+   */
+  #if defined(SKEW_CORRECTION) && (defined(DELTA) || defined(SCARA))
+    #error SKEW_CORRECTION is not supported with DELTA or SCARA.
+  #endif
+
+  /**
+   * The hotends are driven by either PID or MPC
+   */
+  #if defined(MPCTEMP) && defined(PIDTEMP)
+    #error MPCTEMP and PIDTEMP can't be enabled together.
+  #endif
+
+  /**
+   * Hardware PWM heaters
+   */
+  #ifdef HEATERS_HARDWARE_PWM
+    #ifdef SLOW_PWM_HEATERS
+      #error HEATERS_HARDWARE_PWM can't be used with SLOW_PWM_HEATERS.
+    #endif
+    #ifdef HEATERS_PARALLEL
+      #error HEATERS_HARDWARE_PWM can't be used with HEATERS_PARALLEL.
+    #endif
+  #endif
+
+  /**
+   * Buffered serial output needs availableForWrite(), which SerialUSB lacks
+   */
+  #if defined(SERIAL_TX_BUFFER_SIZE) && MOTHERBOARD == BOARD_AMBIT
+    #error SERIAL_TX_BUFFER_SIZE can't be used with the native USB port.
+  #endif
+
   /**
    * ULTIPANEL encoder
    */
@@ -335,6 +368,13 @@
     #error TEMP_SENSOR_0 is required.
   #endif
 
+  /**
+   * Emergency parser
+   */
+  #if defined(EMERGENCY_PARSER) && defined(SERIAL_PORT_2)
+    #warning EMERGENCY_PARSER only watches MYSERIAL. M108, M112 and M410 from SERIAL_PORT_2 wait their turn in the command queue.
+  #endif
+
   /**
    * Warnings for old configurations
    */
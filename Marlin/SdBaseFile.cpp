@@ -343,38 +343,38 @@ int8_t SdBaseFile::lsPrintNext( uint8_t flags, uint8_t indent) {
       && DIR_IS_FILE_OR_SUBDIR(&dir)) break;
   }
   // indent for dir level
-  for (uint8_t i = 0; i < indent; i++) MYSERIAL.write(' ');
+  for (uint8_t i = 0; i < indent; i++) SERIAL_OUT.write(' ');
 
   // print name
   for (uint8_t i = 0; i < 11; i++) {
     if (dir.name[i] == ' ')continue;
     if (i == 8) {
-      MYSERIAL.write('.');
+      SERIAL_OUT.write('.');
       w++;
     }
-    MYSERIAL.write(dir.name[i]);
+    SERIAL_OUT.write(dir.name[i]);
     w++;
   }
   if (DIR_IS_SUBDIR(&dir)) {
-    MYSERIAL.write('/');
+    SERIAL_OUT.write('/');
     w++;
   }
   if (flags & (LS_DATE | LS_SIZE)) {
-    while (w++ < 14) MYSERIAL.write(' ');
+    while (w++ < 14) SERIAL_OUT.write(' ');
   }
   // print modify date/time if requested
   if (flags & LS_DATE) {
-    MYSERIAL.write(' ');
+    SERIAL_OUT.write(' ');
     printFatDate( dir.lastWriteDate);
-    MYSERIAL.write(' ');
+    SERIAL_OUT.write(' ');
     printFatTime( dir.lastWriteTime);
   }
   // print size if requested
   if (!DIR_IS_SUBDIR(&dir) && (flags & LS_SIZE)) {
-    MYSERIAL.write(' ');
-    MYSERIAL.print(dir.fileSize);
+    SERIAL_OUT.write(' ');
+    SERIAL_OUT.print(dir.fileSize);
   }
-  MYSERIAL.println();
+  SERIAL_OUT.println();
   return DIR_IS_FILE(&dir) ? 1 : 2;
 }
 //------------------------------------------------------------------------------
@@ -956,26 +956,26 @@ void SdBaseFile::printDirName(const dir_t& dir,
   for (uint8_t i = 0; i < 11; i++) {
     if (dir.name[i] == ' ')continue;
     if (i == 8) {
-      MYSERIAL.write('.');
+      SERIAL_OUT.write('.');
       w++;
     }
-    MYSERIAL.write(dir.name[i]);
+    SERIAL_OUT.write(dir.name[i]);
     w++;
   }
   if (DIR_IS_SUBDIR(&dir) && printSlash) {
-    MYSERIAL.write('/');
+    SERIAL_OUT.write('/');
     w++;
   }
   while (w < width) {
-    MYSERIAL.write(' ');
+    SERIAL_OUT.write(' ');
     w++;
   }
 }
 //------------------------------------------------------------------------------
 // print uint8_t with width 2
 static void print2u( uint8_t v) {
-  if (v < 10) MYSERIAL.write('0');
-  MYSERIAL.print(v, DEC);
+  if (v < 10) SERIAL_OUT.write('0');
+  SERIAL_OUT.print(v, DEC);
 }
 //------------------------------------------------------------------------------
 /** %Print a directory date field to Serial.
@@ -994,10 +994,10 @@ static void print2u( uint8_t v) {
  * \param[in] fatDate The date field from a directory entry.
  */
 void SdBaseFile::printFatDate(uint16_t fatDate) {
-  MYSERIAL.print(FAT_YEAR(fatDate));
-  MYSERIAL.write('-');
+  SERIAL_OUT.print(FAT_YEAR(fatDate));
+  SERIAL_OUT.write('-');
   print2u( FAT_MONTH(fatDate));
-  MYSERIAL.write('-');
+  SERIAL_OUT.write('-');
   print2u( FAT_DAY(fatDate));
 }
 
@@ -1011,9 +1011,9 @@ void SdBaseFile::printFatDate(uint16_t fatDate) {
  */
 void SdBaseFile::printFatTime( uint16_t fatTime) {
   print2u( FAT_HOUR(fatTime));
-  MYSERIAL.write(':');
+  SERIAL_OUT.write(':');
   print2u( FAT_MINUTE(fatTime));
-  MYSERIAL.write(':');
+  SERIAL_OUT.write(':');
   print2u( FAT_SECOND(fatTime));
 }
 //------------------------------------------------------------------------------
@@ -1025,7 +1025,7 @@ void SdBaseFile::printFatTime( uint16_t fatTime) {
 bool SdBaseFile::printName() {
   char name[FILENAME_LENGTH];
   if (!getFilename(name)) return false;
-  MYSERIAL.print(name);
+  SERIAL_OUT.print(name);
   return true;
 }
 //------------------------------------------------------------------------------
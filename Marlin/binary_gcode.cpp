@@ -0,0 +1,117 @@
+/**
+ * binary_gcode.cpp - Commands in binary frames, see binary_gcode.h
+ */
+
+#include "Marlin.h"
+
+#ifdef BINARY_GCODE
+
+#include "binary_gcode.h"
+
+enum BinaryFieldType { BINARY_FIELD_FLAG, BINARY_FIELD_INT, BINARY_FIELD_FLOAT, BINARY_FIELD_TEXT };
+
+bool binary_mode = false;
+uint8_t binary_frame_count = 0;
+uint8_t binary_frame_seq = 0;
+static bool binary_resend_sent = false;
+
+static uint16_t crc16_ccitt(const uint8_t *data, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t b = 8; b--;) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static void binary_frame_ack(uint8_t seq) {
+  SERIAL_PROTOCOLPGM("ack:");
+  SERIAL_PROTOCOLLN((int)seq);
+}
+
+// Ask for the frames from the expected one, once until it comes
+static void binary_frame_error() {
+  if (binary_resend_sent) return;
+  binary_resend_sent = true;
+  SERIAL_PROTOCOLPGM("rs:");
+  SERIAL_PROTOCOLLN((int)binary_frame_seq);
+}
+
+uint8_t binary_frame_byte(char *buffer, uint8_t c) {
+  uint8_t *frame = (uint8_t*)buffer;
+  if (!binary_frame_count && c != BINARY_FRAME_SYNC) return 0;
+  frame[binary_frame_count++] = c;
+  if (binary_frame_count < 3) return 0;
+
+  uint8_t length = frame[2];
+  if (length > BINARY_FRAME_PAYLOAD_MAX) {
+    binary_frame_count = 0;
+    binary_frame_error();
+    return 0;
+  }
+  if (binary_frame_count < length + 5) return 0;
+  binary_frame_count = 0;
+
+  if (crc16_ccitt(frame + 1, length + 2) != (frame[length + 3] | frame[length + 4] << 8)) {
+    binary_frame_error();
+    return 0;
+  }
+
+  uint8_t seq = frame[1];
+  if (seq != binary_frame_seq) {
+    // Sent again because its ack was lost? It's already queued.
+    if ((uint8_t)(binary_frame_seq - seq) <= BINARY_GCODE_WINDOW)
+      binary_frame_ack(seq);
+    else
+      binary_frame_error();
+    return 0;
+  }
+  binary_frame_seq++;
+  binary_resend_sent = false;
+  binary_mode = length > 0;
+  binary_frame_ack(seq);
+  if (length < 3) return 0;
+
+  // The marker, length, payload and a NUL in place of the CRC
+  frame[1] = BINARY_COMMAND_MARKER;
+  frame[length + 3] = '\0';
+  return length + 3;
+}
+
+int parse_binary_command(command_args_t &args, char *command, char **text) {
+  uint8_t *p = (uint8_t*)command + 5,
+          *end = (uint8_t*)command + 2 + (uint8_t)command[1];
+  args.seen = args.has_value = 0;
+  *text = (char*)end; // The NUL after the payload
+  while (p < end) {
+    uint8_t *field = p++;
+    uint8_t i = *field & 0x1F, type = *field >> 5;
+    if (type == BINARY_FIELD_TEXT) {
+      *text = (char*)p;
+      break;
+    }
+    if (i >= 26 || (type != BINARY_FIELD_FLAG && p + 4 > end)) break;
+    args.seen |= BIT(i);
+    args.pointer[i] = (char*)field; // Before the text, as in a line
+    args.value[i] = args.value_long[i] = 0;
+    if (type == BINARY_FIELD_INT) {
+      int32_t l;
+      memcpy(&l, p, 4);
+      args.value_long[i] = l;
+      args.value[i] = l;
+    }
+    else if (type == BINARY_FIELD_FLOAT) {
+      float f;
+      memcpy(&f, p, 4);
+      args.value[i] = f;
+      args.value_long[i] = f;
+    }
+    else
+      continue;
+    args.has_value |= BIT(i);
+    p += 4;
+  }
+  return BINARY_COMMAND_CODE(command);
+}
+
+#endif // BINARY_GCODE
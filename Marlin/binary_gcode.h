@@ -0,0 +1,54 @@
+/**
+ * binary_gcode.h - Commands in binary frames, as sent by scripts/binary_gcode.py
+ *
+ *   0xFE, sequence, payload length, payload, CRC16 (low byte first)
+ *
+ * The CRC is CCITT (0x1021, from 0xFFFF) over the sequence, length and
+ * payload. The payload is the command letter, its code (16 bits, low byte
+ * first) and then the parameters, each a byte holding the letter (0 for A)
+ * in bits 0-4 and the type in bits 5-7, followed by its value:
+ *
+ *   0: No value
+ *   1: int32, low byte first
+ *   2: float, IEEE 754, low byte first
+ *   3: Text up to the end of the payload, for M23, M117 and the like. Last.
+ *
+ * A frame that's queued is answered with "ack:<seq>", and a bad, missing or
+ * out of order frame with "rs:<seq>", asking for every frame from the next
+ * expected one. Frames sent before the host saw the "rs:" are dropped until
+ * then. Binary commands get no "ok" when done. An empty frame returns to
+ * text, and M110 starts the sequence over from 0.
+ *
+ * The host keeps at most BINARY_GCODE_WINDOW frames, and no more bytes than
+ * the serial receive buffer holds, waiting for their "ack:".
+ */
+
+#ifndef BINARY_GCODE_H
+#define BINARY_GCODE_H
+
+#include <stdint.h>
+#include "gcode_parser.h"
+
+#define BINARY_COMMAND_MARKER 0xFE  // Starts a queued binary command
+#define IS_BINARY_COMMAND(cmd) ((uint8_t)*(cmd) == BINARY_COMMAND_MARKER)
+#define BINARY_COMMAND_CODE(cmd) ((int16_t)((uint8_t)(cmd)[3] | (uint8_t)(cmd)[4] << 8))
+#define IS_BINARY_M29(cmd) (IS_BINARY_COMMAND(cmd) && (cmd)[2] == 'M' && BINARY_COMMAND_CODE(cmd) == 29)
+
+#define BINARY_FRAME_PAYLOAD_MAX (MAX_CMD_SIZE - 5)
+
+extern bool binary_mode;            // Text is ignored between frames
+extern uint8_t binary_frame_count;  // Bytes of the frame read so far
+extern uint8_t binary_frame_seq;    // Sequence number of the next frame
+
+/**
+ * Add a received byte to the frame read into frame, of MAX_CMD_SIZE bytes.
+ * Bytes between frames are dropped. When the frame is complete and correct
+ * it's acknowledged, and the size of its command at frame + 1 is returned,
+ * to be queued before the next byte is read. Else 0.
+ */
+uint8_t binary_frame_byte(char *frame, uint8_t c);
+
+// Fill args from a queued binary command, and point *text at its text or its NUL. Returns the code.
+int parse_binary_command(command_args_t &args, char *command, char **text);
+
+#endif // BINARY_GCODE_H
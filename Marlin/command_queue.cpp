@@ -0,0 +1,279 @@
+/**
+ * command_queue.cpp - The queue of commands to run, see command_queue.h
+ */
+
+#include "Marlin.h"
+#include "command_queue.h"
+#include "gcode_parser.h"
+#include "planner.h"
+#include "ultralcd.h"
+#include "language.h"
+
+#ifdef BINARY_GCODE
+  #include "binary_gcode.h"
+#endif
+
+int cmd_queue_index_r = 0;
+static int cmd_queue_index_w = 0;
+int commands_in_queue = 0;
+
+char command_buffer[CMD_BUFFER_BYTES];
+uint16_t command_offset[BUFSIZE];
+static uint16_t command_buffer_w = 0;  // End of the newest command
+
+#ifdef SDSUPPORT
+  bool fromsd[BUFSIZE];
+#endif
+
+#ifdef SERIAL_PORT_2
+  uint8_t command_port[BUFSIZE];
+  uint8_t port_2_queued = 0;
+#endif
+
+static long gcode_N;
+long gcode_LastN = 0;
+char line_buffer[MAX_CMD_SIZE];
+int serial_count = 0;
+bool comment_mode = false;
+
+/**
+ * Where a command of size bytes (with the NUL) can go in the command buffer,
+ * or -1 if there's no room for it. The free space is the end of the buffer
+ * and the start up to the oldest command, or the gap before the oldest
+ * command once the queue has wrapped. The newest command never reaches the
+ * oldest, so the two only meet when the queue is empty.
+ */
+static int command_buffer_alloc(uint16_t size) {
+  if (commands_in_queue >= BUFSIZE) return -1;
+  if (!commands_in_queue) return size <= CMD_BUFFER_BYTES ? 0 : -1;
+  uint16_t tail = command_offset[cmd_queue_index_r], head = command_buffer_w;
+  if (head > tail) {
+    if (CMD_BUFFER_BYTES - head >= size) return head;
+    return size < tail ? 0 : -1;
+  }
+  return size < tail - head ? head : -1;
+}
+
+bool cmd_queue_has_room() { return command_buffer_alloc(MAX_CMD_SIZE) >= 0; }
+
+#ifdef ADVANCED_OK
+  // How many more lines of any length are sure to be read, as B in the "ok"
+  static int cmd_queue_free_lines() {
+    int lines;
+    if (!commands_in_queue)
+      lines = CMD_BUFFER_BYTES / MAX_CMD_SIZE;
+    else {
+      uint16_t tail = command_offset[cmd_queue_index_r], head = command_buffer_w;
+      if (head > tail)
+        lines = (CMD_BUFFER_BYTES - head) / MAX_CMD_SIZE + (tail - 1) / MAX_CMD_SIZE;
+      else
+        lines = (tail - head - 1) / MAX_CMD_SIZE;
+    }
+    return min(lines, BUFSIZE - commands_in_queue);
+  }
+#endif
+
+bool cmd_queue_push(const char *cmd, uint16_t size, bool sd) {
+  int pos = command_buffer_alloc(size);
+  if (pos < 0) return false;
+  memcpy(command_buffer + pos, cmd, size);
+  command_offset[cmd_queue_index_w] = pos;
+  command_buffer_w = pos + size;
+  #ifdef SDSUPPORT
+    fromsd[cmd_queue_index_w] = sd;
+  #endif
+  #ifdef SERIAL_PORT_2
+    command_port[cmd_queue_index_w] = serial_ports.port;
+    if (serial_ports.port) port_2_queued++;
+  #endif
+  cmd_queue_index_w = (cmd_queue_index_w + 1) % BUFSIZE;
+  commands_in_queue++;
+  return true;
+}
+
+void cmd_queue_pop() {
+  #ifdef SERIAL_PORT_2
+    if (command_port[cmd_queue_index_r]) port_2_queued--;
+  #endif
+  commands_in_queue--;
+  cmd_queue_index_r = (cmd_queue_index_r + 1) % BUFSIZE;
+}
+
+void FlushSerialRequestResend() {
+  #ifdef SERIAL_PORT_2
+    if (SELECTED_PORT)
+      SERIAL_PORT_2.flush();
+    else
+  #endif
+      MYSERIAL.flush();
+  SERIAL_PROTOCOLPGM(MSG_RESEND);
+  SERIAL_PROTOCOLLN(gcode_LastN + 1);
+  ok_to_send();
+}
+
+void ok_to_send() {
+  refresh_cmd_timeout();
+  #ifdef SDSUPPORT
+    if (fromsd[cmd_queue_index_r]) return;
+  #endif
+  SERIAL_PROTOCOLPGM(MSG_OK);
+  #ifdef ADVANCED_OK
+    SERIAL_PROTOCOLPGM(" N"); SERIAL_PROTOCOL(gcode_LastN);
+    SERIAL_PROTOCOLPGM(" P"); SERIAL_PROTOCOL(int(BLOCK_BUFFER_SIZE - movesplanned() - 1));
+    SERIAL_PROTOCOLPGM(" B"); SERIAL_PROTOCOL(cmd_queue_free_lines());
+  #endif
+  SERIAL_EOL;
+}
+
+static void gcode_line_error(const char *err, bool doFlush=true) {
+  SERIAL_ERROR_START;
+  serialprintPGM(err);
+  SERIAL_ERRORLN(gcode_LastN);
+  //Serial.println(gcode_N);
+  if (doFlush) FlushSerialRequestResend();
+}
+
+bool serial_line_done(char *command) {
+  char *npos = strchr(command, 'N');
+  char *apos = strchr(command, '*');
+  if (npos) {
+
+    boolean M110 = strstr_P(command, PSTR("M110")) != NULL;
+
+    if (M110) {
+      char *n2pos = strchr(command + 4, 'N');
+      if (n2pos) npos = n2pos;
+      #ifdef BINARY_GCODE
+        if (!SELECTED_PORT) binary_frame_seq = 0; // Frames on the main port start over too
+      #endif
+    }
+
+    gcode_N = gcode_strtol(npos + 1);
+
+    if (gcode_N != gcode_LastN + 1 && !M110) {
+      gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+      return false;
+    }
+
+    if (apos) {
+      byte checksum = 0, count = 0;
+      while (command[count] != '*') checksum ^= command[count++];
+
+      if (gcode_strtol(apos + 1) != checksum) {
+        gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
+        return false;
+      }
+      // if no errors, continue parsing
+    }
+    else if (npos == command) {
+      gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+      return false;
+    }
+
+    gcode_LastN = gcode_N;
+    // if no errors, continue parsing
+  }
+  else if (apos) { // No '*' without 'N'
+    gcode_line_error(PSTR(MSG_ERR_NO_LINENUMBER_WITH_CHECKSUM), false);
+    return false;
+  }
+
+  // Movement commands alert when stopped
+  if (IsStopped()) {
+    char *gpos = strchr(command, 'G');
+    if (gpos) {
+      int codenum = gcode_strtol(gpos + 1);
+      switch (codenum) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+          SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
+          LCD_MESSAGEPGM(MSG_STOPPED);
+          break;
+      }
+    }
+  }
+
+  // If command was e-stop process now
+  if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
+
+  cmd_queue_push(command, false); // this item in the queue is not from sd
+  return true;
+}
+
+#ifdef BINARY_GCODE
+
+  // Add a command from a binary frame to the queue, as serial_line_done() does a line
+  static void binary_command_done(char *command, uint8_t size) {
+    int16_t code = BINARY_COMMAND_CODE(command);
+    if (command[2] == 'M' && code == 112) kill(PSTR(MSG_KILLED));
+    if (IsStopped() && command[2] == 'G' && code >= 0 && code <= 3) {
+      SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
+      LCD_MESSAGEPGM(MSG_STOPPED);
+    }
+    cmd_queue_push(command, size, false);
+  }
+
+#endif // BINARY_GCODE
+
+void get_serial_commands() {
+
+  #ifdef NO_TIMEOUTS
+    static millis_t last_command_time = 0;
+    millis_t ms = millis();
+
+    if (!SERIAL_IN_AVAILABLE() && commands_in_queue == 0 && ms - last_command_time > NO_TIMEOUTS) {
+      SERIAL_ECHOLNPGM(MSG_WAIT);
+      last_command_time = ms;
+    }
+  #endif
+
+  //
+  // Loop while serial characters are incoming and the queue is not full
+  //
+  while (cmd_queue_has_room() && SERIAL_IN_AVAILABLE() > 0) {
+
+    #ifdef NO_TIMEOUTS
+      last_command_time = ms;
+    #endif
+
+    char serial_char = SERIAL_IN_READ();
+
+    #ifdef BINARY_GCODE
+      if (binary_mode || binary_frame_count || (!serial_count && !comment_mode && (uint8_t)serial_char == BINARY_FRAME_SYNC)) {
+        uint8_t size = binary_frame_byte(line_buffer, serial_char);
+        if (size) binary_command_done(line_buffer + 1, size);
+        continue;
+      }
+    #endif
+
+    //
+    // If the character ends the line, or the line is full...
+    //
+    if (serial_char == '\n' || serial_char == '\r' || serial_count >= MAX_CMD_SIZE-1) {
+
+      // end of line == end of comment
+      comment_mode = false;
+
+      if (!serial_count) return; // empty lines just exit
+
+      line_buffer[serial_count] = 0; // terminate string
+      serial_count = 0; //clear buffer
+
+      if (!serial_line_done(line_buffer)) return;
+    }
+    else if (serial_char == '\\') {  // Handle escapes
+      if (SERIAL_IN_AVAILABLE() > 0) {
+        // if we have one more character, copy it over
+        serial_char = SERIAL_IN_READ();
+        line_buffer[serial_count++] = serial_char;
+      }
+      // otherwise do nothing
+    }
+    else { // its not a newline, carriage return or escape char
+      if (serial_char == ';') comment_mode = true;
+      if (!comment_mode) line_buffer[serial_count++] = serial_char;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * command_queue.h - The queue of commands to run, and the serial lines that fill it
+ *
+ * The queued commands lie one after the other in a ring of CMD_BUFFER_BYTES,
+ * each NUL-terminated and never wrapping past the end, so a command only
+ * takes its own length. command_offset[] is the ring of where they start.
+ *
+ * Lines from the serial port are checked for their line number and checksum
+ * before they're queued, and each command run is answered by ok_to_send().
+ */
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <string.h>
+
+extern int cmd_queue_index_r;   // The oldest command, the one to run next
+extern int commands_in_queue;
+extern char command_buffer[CMD_BUFFER_BYTES];
+extern uint16_t command_offset[BUFSIZE];
+#define QUEUED_COMMAND(i) (command_buffer + command_offset[i])
+
+#ifdef SDSUPPORT
+  extern bool fromsd[BUFSIZE];
+#endif
+
+#ifdef SERIAL_PORT_2
+  #define COMMAND_PORT(i) command_port[i]
+  #define SELECTED_PORT serial_ports.port
+  extern uint8_t command_port[BUFSIZE]; // The port each queued command came from
+  extern uint8_t port_2_queued;         // Commands from SERIAL_PORT_2 in the queue
+#else
+  #define COMMAND_PORT(i) 0
+  #define SELECTED_PORT 0
+#endif
+
+extern long gcode_LastN;                // The last good line number of the selected port
+extern char line_buffer[MAX_CMD_SIZE];  // The line being read from serial or SD
+extern int serial_count;                // Its length so far
+extern bool comment_mode;               // In a comment, up to the end of the line
+
+// Is there room for a line of any length?
+bool cmd_queue_has_room();
+
+// Add size bytes of command to the end of the queue, false if they don't fit
+bool cmd_queue_push(const char *cmd, uint16_t size, bool sd);
+
+// Add a command to the end of the queue, false if it doesn't fit
+inline bool cmd_queue_push(const char *cmd, bool sd) { return cmd_queue_push(cmd, strlen(cmd) + 1, sd); }
+
+// Drop the oldest command, once it has run
+void cmd_queue_pop();
+
+/**
+ * Check a line from a serial port and add it to the queue. The line number
+ * and checksum, if any, must follow on from the port's last good line.
+ * Returns false if the line is refused.
+ */
+bool serial_line_done(char *command);
+
+// Read the main serial port into the queue while it has room
+void get_serial_commands();
+
+#endif // COMMAND_QUEUE_H
@@ -14,7 +14,7 @@
  *
  */
 
-#define EEPROM_VERSION "V20"
+#define EEPROM_VERSION "V23"
 
 /**
  * V19 EEPROM Layout:
@@ -87,6 +87,21 @@
  * Z_DUAL_ENDSTOPS:
  *  M666 Z    z_endstop_adj
  *
+ * BACKLASH_COMPENSATION:
+ *  M425 XYZ  backlash_distance_mm (x3)
+ *  M425 F    backlash_correction
+ *  M425 S    backlash_smoothing_mm
+ *
+ * SKEW_CORRECTION:
+ *  M852 I    skew_factor_xy
+ *  M852 J    skew_factor_xz
+ *  M852 K    skew_factor_yz
+ *
+ * MPCTEMP:
+ *  M306 E0 PCRAFH  mpc[0] heater_power, block_heat_capacity, sensor_responsiveness,
+ *                  ambient_xfer_coeff_fan0, fan255_adjustment, filament_heat_capacity_permm
+ *  M306 E1..E3     mpc[1..3]
+ *
  */
 #include "Marlin.h"
 #include "language.h"
@@ -295,6 +310,37 @@ void Config_StoreSettings()  {
     EEPROM_WRITE_VAR(i, dummy);
   }
 
+  #ifdef BACKLASH_COMPENSATION
+    EEPROM_WRITE_VAR(i, backlash_distance_mm);  // 3 floats
+    EEPROM_WRITE_VAR(i, backlash_correction);   // 1 float
+    EEPROM_WRITE_VAR(i, backlash_smoothing_mm); // 1 float
+  #else
+    dummy = 0.0f;
+    for (int q=5; q--;) EEPROM_WRITE_VAR(i, dummy);
+  #endif
+
+  #ifdef SKEW_CORRECTION
+    EEPROM_WRITE_VAR(i, skew_factor_xy);
+    EEPROM_WRITE_VAR(i, skew_factor_xz);
+    EEPROM_WRITE_VAR(i, skew_factor_yz);
+  #else
+    dummy = 0.0f;
+    for (int q=3; q--;) EEPROM_WRITE_VAR(i, dummy);
+  #endif
+
+  for (int e = 0; e < 4; e++) {
+    #ifdef MPCTEMP
+      if (e < EXTRUDERS) {
+        EEPROM_WRITE_VAR(i, mpc[e]); // 6 floats
+      }
+      else
+    #endif
+      {
+        dummy = 0.0f;
+        for (int q=6; q--;) EEPROM_WRITE_VAR(i, dummy);
+      }
+  }
+
   char ver2[4] = EEPROM_VERSION;
   int j = EEPROM_OFFSET;
   EEPROM_WRITE_VAR(j, ver2); // validate data
@@ -469,6 +515,35 @@ void Config_RetrieveSettings() {
       if (q < EXTRUDERS) filament_size[q] = dummy;
     }
 
+    #ifdef BACKLASH_COMPENSATION
+      EEPROM_READ_VAR(i, backlash_distance_mm);   // 3 floats
+      EEPROM_READ_VAR(i, backlash_correction);    // 1 float
+      EEPROM_READ_VAR(i, backlash_smoothing_mm);  // 1 float
+    #else
+      for (int q=5; q--;) EEPROM_READ_VAR(i, dummy);
+    #endif
+
+    #ifdef SKEW_CORRECTION
+      EEPROM_READ_VAR(i, skew_factor_xy);
+      EEPROM_READ_VAR(i, skew_factor_xz);
+      EEPROM_READ_VAR(i, skew_factor_yz);
+      plan_update_transform();
+    #else
+      for (int q=3; q--;) EEPROM_READ_VAR(i, dummy);
+    #endif
+
+    for (int e = 0; e < 4; e++) {
+      #ifdef MPCTEMP
+        if (e < EXTRUDERS) {
+          EEPROM_READ_VAR(i, mpc[e]); // 6 floats
+        }
+        else
+      #endif
+        {
+          for (int q=6; q--;) EEPROM_READ_VAR(i, dummy);
+        }
+    }
+
     calculate_volumetric_multipliers();
     // Call updatePID (similar to when we have processed M301)
     updatePID();
@@ -573,6 +648,17 @@ void Config_ResetDefault() {
     updatePID();
   #endif // PIDTEMP
 
+  #ifdef MPCTEMP
+    for (int e = 0; e < EXTRUDERS; e++) {
+      mpc[e].heater_power = MPC_HEATER_POWER;
+      mpc[e].block_heat_capacity = MPC_BLOCK_HEAT_CAPACITY;
+      mpc[e].sensor_responsiveness = MPC_SENSOR_RESPONSIVENESS;
+      mpc[e].ambient_xfer_coeff_fan0 = MPC_AMBIENT_XFER_COEFF;
+      mpc[e].fan255_adjustment = MPC_AMBIENT_XFER_COEFF_FAN255 - MPC_AMBIENT_XFER_COEFF;
+      mpc[e].filament_heat_capacity_permm = MPC_FILAMENT_HEAT_CAPACITY_PERMM;
+    }
+  #endif
+
   #ifdef PIDTEMPBED
     bedKp = DEFAULT_bedKp;
     bedKi = scalePID_i(DEFAULT_bedKi);
@@ -607,6 +693,20 @@ void Config_ResetDefault() {
   #endif
   calculate_volumetric_multipliers();
 
+  #ifdef BACKLASH_COMPENSATION
+    float tmp4[] = BACKLASH_DISTANCE_MM;
+    for (int q = 0; q < 3; q++) backlash_distance_mm[q] = tmp4[q];
+    backlash_correction = BACKLASH_CORRECTION;
+    backlash_smoothing_mm = BACKLASH_SMOOTHING_MM;
+  #endif
+
+  #ifdef SKEW_CORRECTION
+    skew_factor_xy = XY_SKEW_FACTOR;
+    skew_factor_xz = XZ_SKEW_FACTOR;
+    skew_factor_yz = YZ_SKEW_FACTOR;
+    plan_update_transform();
+  #endif
+
   SERIAL_ECHO_START;
   SERIAL_ECHOLNPGM("Hardcoded Default Settings Loaded");
 }
@@ -748,6 +848,35 @@ void Config_PrintSettings(bool forReplay) {
     SERIAL_EOL;  
   #endif // DELTA
 
+  #ifdef BACKLASH_COMPENSATION
+    CONFIG_ECHO_START;
+    if (!forReplay) {
+      SERIAL_ECHOLNPGM("Backlash compensation: XYZ=play (mm), F=correction (0.0-1.0), S=smoothing (mm)");
+      CONFIG_ECHO_START;
+    }
+    SERIAL_ECHOPAIR("  M425 X", backlash_distance_mm[X_AXIS]);
+    SERIAL_ECHOPAIR(" Y", backlash_distance_mm[Y_AXIS]);
+    SERIAL_ECHOPAIR(" Z", backlash_distance_mm[Z_AXIS]);
+    SERIAL_ECHOPAIR(" F", backlash_correction);
+    SERIAL_ECHOPAIR(" S", backlash_smoothing_mm);
+    SERIAL_EOL;
+  #endif
+
+  #ifdef SKEW_CORRECTION
+    CONFIG_ECHO_START;
+    if (!forReplay) {
+      SERIAL_ECHOLNPGM("Skew factors: I=XY, J=XZ, K=YZ");
+      CONFIG_ECHO_START;
+    }
+    SERIAL_ECHOPGM("  M852 I");
+    SERIAL_PROTOCOL_F(skew_factor_xy, 6);
+    SERIAL_ECHOPGM(" J");
+    SERIAL_PROTOCOL_F(skew_factor_xz, 6);
+    SERIAL_ECHOPGM(" K");
+    SERIAL_PROTOCOL_F(skew_factor_yz, 6);
+    SERIAL_EOL;
+  #endif
+
   #ifdef ULTIPANEL
     CONFIG_ECHO_START;
     if (!forReplay) {
@@ -812,6 +941,18 @@ void Config_PrintSettings(bool forReplay) {
 
   #endif // PIDTEMP || PIDTEMPBED
 
+  #ifdef MPCTEMP
+    if (!forReplay) {
+      CONFIG_ECHO_START;
+      SERIAL_ECHOLNPGM("MPC settings: P=heater power (W), C=block heat capacity (J/K), R=sensor responsiveness (1/s), A/F=ambient heat loss, fan off/on (W/K), H=filament heat capacity (J/K/mm)");
+    }
+    for (uint8_t e = 0; e < EXTRUDERS; e++) {
+      CONFIG_ECHO_START;
+      SERIAL_ECHOPGM("  ");
+      MPC_print(e);
+    }
+  #endif
+
   #ifdef HAS_LCD_CONTRAST
     CONFIG_ECHO_START;
     if (!forReplay) {
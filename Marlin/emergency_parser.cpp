@@ -0,0 +1,103 @@
+/**
+ * emergency_parser.cpp - Act on emergency commands as they're received
+ */
+
+#include "Marlin.h"
+
+#ifdef EMERGENCY_PARSER
+
+#include "stepper.h"
+#include "language.h"
+
+enum EmergencyState {
+  EP_RESET,         // At the start of a line
+  EP_N,             // In the line number
+  EP_M, EP_M1, EP_M10, EP_M11, EP_M4, EP_M41,
+  EP_CODE,          // After a whole emergency command
+  EP_ARGS,          // After its space or checksum, until the end of the line
+  EP_IGNORE,        // Not an emergency command, until the end of the line
+  #ifdef BINARY_GCODE
+    EP_FRAME_SEQ, EP_FRAME_LEN, EP_FRAME // Skipping a binary frame
+  #endif
+};
+
+bool emergency_quickstop = false;
+
+static uint8_t state = EP_RESET;
+static int code;
+#ifdef BINARY_GCODE
+  static uint16_t frame_left;
+#endif
+
+static uint8_t rx_buffer[EMERGENCY_PARSER_RX_BYTES];
+static uint16_t rx_head, rx_tail;
+
+static void emergency_parser_update(const uint8_t c) {
+  #ifdef BINARY_GCODE
+    // Frames may hold any bytes, so skip them by their length
+    switch (state) {
+      case EP_FRAME_SEQ: state = EP_FRAME_LEN; return;
+      case EP_FRAME_LEN: frame_left = c + 2; state = EP_FRAME; return; // Payload and CRC
+      case EP_FRAME: if (!--frame_left) state = EP_RESET; return;
+    }
+  #endif
+
+  if (c == '\n' || c == '\r') {
+    if (state == EP_CODE || state == EP_ARGS) {
+      switch (code) {
+        case 108: cancel_heatup = true; break;
+        case 112: kill(PSTR(MSG_KILLED)); break;
+        case 410: quickStop(); emergency_quickstop = true; break;
+      }
+    }
+    state = EP_RESET;
+    return;
+  }
+
+  switch (state) {
+    case EP_RESET:
+      switch (c) {
+        case ' ': break;
+        case 'N': state = EP_N; break;
+        case 'M': state = EP_M; break;
+        #ifdef BINARY_GCODE
+          case BINARY_FRAME_SYNC: state = EP_FRAME_SEQ; break;
+        #endif
+        default: state = EP_IGNORE;
+      }
+      break;
+    case EP_N: state = c == 'M' ? EP_M : (NUMERIC(c) || c == '-' || c == ' ') ? EP_N : EP_IGNORE; break;
+    case EP_M: state = c == '1' ? EP_M1 : c == '4' ? EP_M4 : EP_IGNORE; break;
+    case EP_M1: state = c == '0' ? EP_M10 : c == '1' ? EP_M11 : EP_IGNORE; break;
+    case EP_M10: code = 108; state = c == '8' ? EP_CODE : EP_IGNORE; break;
+    case EP_M11: code = 112; state = c == '2' ? EP_CODE : EP_IGNORE; break;
+    case EP_M4: state = c == '1' ? EP_M41 : EP_IGNORE; break;
+    case EP_M41: code = 410; state = c == '0' ? EP_CODE : EP_IGNORE; break;
+    case EP_CODE: state = (c == ' ' || c == '*') ? EP_ARGS : EP_IGNORE; break; // Not M1120, M4100...
+  }
+}
+
+void emergency_parser_poll() {
+  while (MYSERIAL.available() > 0) {
+    uint16_t next = (rx_head + 1) % EMERGENCY_PARSER_RX_BYTES;
+    if (next == rx_tail) break; // Full. The rest waits in MYSERIAL.
+    uint8_t c = MYSERIAL.read();
+    rx_buffer[rx_head] = c;
+    rx_head = next;
+    emergency_parser_update(c);
+  }
+}
+
+int emergency_parser_available() {
+  emergency_parser_poll();
+  return (rx_head - rx_tail + EMERGENCY_PARSER_RX_BYTES) % EMERGENCY_PARSER_RX_BYTES;
+}
+
+int emergency_parser_read() {
+  if (rx_tail == rx_head) return -1;
+  uint8_t c = rx_buffer[rx_tail];
+  rx_tail = (rx_tail + 1) % EMERGENCY_PARSER_RX_BYTES;
+  return c;
+}
+
+#endif // EMERGENCY_PARSER
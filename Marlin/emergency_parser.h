@@ -0,0 +1,30 @@
+/**
+ * emergency_parser.h - Act on emergency commands as they're received
+ *
+ * Every byte from MYSERIAL passes through a small state machine on its way to
+ * get_command(). Bytes are also pulled in from idle(), so these commands act even
+ * while the command queue is full or M109 / M190 are waiting:
+ *
+ *   M108  Stop waiting for heaters
+ *   M112  Emergency stop
+ *   M410  Quickstop. Abort all the planned moves
+ *
+ * A command is recognised alone on its line, with or without a line number and
+ * checksum. When it reaches the command queue it does nothing more. Only MYSERIAL
+ * is watched: from SERIAL_PORT_2 these commands wait their turn in the queue.
+ *
+ * An M410 may stop the steppers in the middle of a command, which goes on
+ * planning from where its moves would have ended. So loop() takes the position
+ * from the steppers once that command is done.
+ */
+
+#ifndef EMERGENCY_PARSER_H
+#define EMERGENCY_PARSER_H
+
+extern bool emergency_quickstop;    // An M410 was received. loop() syncs the position.
+
+void emergency_parser_poll();       // Take in what MYSERIAL has, acting on emergency commands
+int emergency_parser_available();   // Bytes held for get_command()
+int emergency_parser_read();        // The next of those, or -1
+
+#endif // EMERGENCY_PARSER_H
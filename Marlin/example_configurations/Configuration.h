@@ -123,6 +123,7 @@ Here are some standard links for getting your machine calibrated:
 //     Use it for Testing or Development purposes. NEVER for production machine.
 //     #define DUMMY_THERMISTOR_998_VALUE 25
 //     #define DUMMY_THERMISTOR_999_VALUE 100
+// 1000 is a user-defined thermistor, its table is generated from the THERMISTOR_1000_* values in Configuration_adv.h
 
 #define TEMP_SENSOR_0 -1
 #define TEMP_SENSOR_1 -1
@@ -25,12 +25,19 @@
 #ifdef PIDTEMP
   // this adds an experimental additional term to the heating power, proportional to the extrusion speed.
   // if Kc is chosen well, the additional required power due to increased melting should be compensated.
-  #define PID_ADD_EXTRUSION_RATE
+  // Kc is applied to the output, so find a good value for your hotend before enabling this.
+  //#define PID_ADD_EXTRUSION_RATE
   #ifdef PID_ADD_EXTRUSION_RATE
     #define  DEFAULT_Kc (1) //heating power=Kc*(e_speed)
+    #define PID_EXTRUSION_RATE_LOOKAHEAD 2.0 //seconds of queued moves to average e_speed over, so the heater ramps up before the flow does
   #endif
 #endif
 
+// M303 relay autotune: the heater switches when the temperature leaves this band around the target,
+// and the tuning stops early once Ku and Tu change by less than this fraction for two cycles in a row
+#define PID_AUTOTUNE_HYSTERESIS 0.5   // Degrees Celsius
+#define PID_AUTOTUNE_CONVERGENCE 0.05
+
 
 //automatic temperature: The hot end target temperature is calculated by all the buffered lines of gcode.
 //The maximum buffered steps/sec of the extruder motor are called "se".
@@ -66,6 +73,21 @@
 #define TEMP_SENSOR_AD595_OFFSET 0.0
 #define TEMP_SENSOR_AD595_GAIN   1.0
 
+//Sensor type 1000 is a thermistor whose table is generated at compile time from these values.
+//The beta model is used unless the Steinhart-Hart coefficients are defined.
+//More points give a more accurate conversion, fewer points save flash (2-255).
+#if TEMP_SENSOR_0 == 1000 || TEMP_SENSOR_1 == 1000 || TEMP_SENSOR_2 == 1000 || TEMP_SENSOR_3 == 1000 || TEMP_SENSOR_BED == 1000
+  #define THERMISTOR_1000_PULLUP  4700    // Pull-up resistor (ohm)
+  #define THERMISTOR_1000_R25     100000  // Thermistor resistance at 25C (ohm)
+  #define THERMISTOR_1000_BETA    3950    // Beta coefficient
+  //#define THERMISTOR_1000_SH_A  0.000722378300319346  // Steinhart-Hart: 1/T = A + B*ln(R) + C*ln(R)^3
+  //#define THERMISTOR_1000_SH_B  0.000216301852054578
+  //#define THERMISTOR_1000_SH_C  0.000000092641025635702
+  #define THERMISTOR_1000_MINTEMP 0       // Table range (C)
+  #define THERMISTOR_1000_MAXTEMP 350
+  #define THERMISTOR_1000_POINTS  71      // 5C resolution
+#endif
+
 //This is for controlling a fan to cool down the stepper drivers
 //it will turn on when any driver is enabled
 //and turn off after the set amount of seconds from last driver being disabled again
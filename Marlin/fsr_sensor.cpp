@@ -32,6 +32,9 @@ void init_fsr_values()
 		longSamples[i] = 0;
 
 	lastLongTime = millis();
+
+	// Add the sensor to the channels the temperature ISR scans
+	startAdcConversion(pinToAdcChannel(FSR_PIN));
 }
 
 uint16_t UpdateLongSamples(int avg) {
@@ -75,7 +78,10 @@ bool CheckIfTriggered() {
 }
 
 bool get_fsr_value() {
-	int value = getAdcFreerun(pinToAdcChannel(FSR_PIN), true);
+	// Mean of the conversions the temperature ISR collected since the last call
+	CRITICAL_SECTION_START;
+	int value = HAL_adc_scan_average(pinToAdcChannel(FSR_PIN));
+	CRITICAL_SECTION_END;
 
 	shortSamples[averageIndex++] = value;
 	if (averageIndex >= SHORT_SIZE)
@@ -0,0 +1,97 @@
+/**
+ * gcode_parser.cpp - Parse the arguments of a G-code command once
+ */
+
+#include "Marlin.h"
+#include "gcode_parser.h"
+
+// l * 10 + d, or the 32-bit limit when that would overflow
+static inline long add_digit(long l, uint8_t d) {
+  return l < 214748364L || (l == 214748364L && d <= 7) ? l * 10 + d : 2147483647L;
+}
+
+/**
+ * Leading spaces are skipped and parsing stops at the first character that
+ * isn't part of the number.
+ */
+long gcode_strtol(const char *p) {
+  while (*p == ' ') p++;
+  bool neg = *p == '-';
+  if (neg || *p == '+') p++;
+  long l = 0;
+  for (; NUMERIC(*p); p++) l = add_digit(l, *p - '0');
+  return neg ? -l : l;
+}
+
+/**
+ * Up to 24 bits of digits and 10 decimal places the value is one exact integer
+ * over an exact power of 10, so one float division rounds it correctly. Longer
+ * numbers go to strtod.
+ */
+static const float pow10_table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+
+float gcode_strtof(const char *p, long *ival) {
+  while (*p == ' ') p++;
+  const char * const start = p;
+  bool neg = *p == '-';
+  if (neg || *p == '+') p++;
+  const char * const digits = p;
+
+  uint32_t mant = 0;
+  uint8_t places = 0;
+  long l = 0;
+  bool exact = true;
+  for (; NUMERIC(*p); p++) {
+    uint8_t d = *p - '0';
+    l = add_digit(l, d);
+    mant = mant * 10 + d;
+    if (mant > 0xFFFFFF) exact = false;
+  }
+  if (*p == '.') {
+    for (p++; NUMERIC(*p); p++) {
+      uint32_t m = mant * 10 + (*p - '0');
+      if (m > 0xFFFFFF || places >= COUNT(pow10_table) - 1) {
+        if (*p != '0') exact = false; // Trailing zeros change nothing
+        continue;
+      }
+      mant = m;
+      places++;
+    }
+  }
+  *ival = neg ? -l : l;
+
+  if (!exact) { // Only the scanned characters, so strtod won't read an exponent
+    char num[MAX_CMD_SIZE];
+    uint8_t n = p - start;
+    memcpy(num, start, n);
+    num[n] = 0;
+    return strtod(num, NULL);
+  }
+  if (p == digits || (p == digits + 1 && *digits == '.')) return 0; // No number, as strtod
+  float f = (float)mant / pow10_table[places];
+  return neg ? -f : f;
+}
+
+/**
+ * As with the strchr() this replaces, the first occurrence of a letter counts,
+ * wherever it is. Numbers have no exponent, so "X5E2" is X5 and E2. Parsing
+ * stops where the free text of a command like M23 or M117 starts, so a file
+ * name or message isn't taken for numbers.
+ */
+void parse_command_args(command_args_t &args, char *p, const char *text/*=NULL*/) {
+  args.seen = args.has_value = 0;
+  for (; *p && p != text; p++) {
+    uint8_t i = *p - 'A';
+    if (i >= 26 || TEST(args.seen, i)) continue;
+    args.seen |= BIT(i);
+    args.pointer[i] = p;
+
+    int n = 1;
+    char c = p[n];
+    if (c == '-' || c == '+') c = p[++n];
+    if (c == '.') c = p[++n];
+    if (NUMERIC(c)) args.has_value |= BIT(i);
+
+    args.value[i] = gcode_strtof(p + 1, &args.value_long[i]);
+  }
+}
@@ -0,0 +1,35 @@
+/**
+ * gcode_parser.h - Parse the arguments of a G-code command once
+ *
+ * The parameters of a command are parsed into a command_args_t in one pass,
+ * so code_seen() and code_value() are lookups. G-code numbers are an optional
+ * sign, digits and an optional fraction, with no exponent, so they're parsed
+ * without newlib strtod / strtol.
+ */
+
+#ifndef GCODE_PARSER_H
+#define GCODE_PARSER_H
+
+#include <stdint.h>
+
+/**
+ * Each letter A-Z has a bit in `seen` and `has_value`, where it is in the
+ * line and its value as a float and a long.
+ */
+typedef struct {
+  uint32_t seen, has_value;
+  char *pointer[26];
+  float value[26];
+  long value_long[26];
+} command_args_t;
+
+// Like strtol(p, NULL, 10), saturating at the 32-bit limit
+long gcode_strtol(const char *p);
+
+// Like (float)strtod(p, NULL), with the same result, and the integer part in *ival
+float gcode_strtof(const char *p, long *ival);
+
+// Parse the arguments in p, up to the NUL or text, which may be NULL
+void parse_command_args(command_args_t &args, char *p, const char *text=NULL);
+
+#endif // GCODE_PARSER_H
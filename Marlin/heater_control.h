@@ -0,0 +1,137 @@
+/**
+ * heater_control.h - PID, thermal runaway protection and heating watch of the heaters
+ *
+ * The control logic of temperature.cpp, without its globals or the Arduino
+ * core, so the host tests in test/ can run it against heater_sim.h. The
+ * settings come from Configuration.h and Configuration_adv.h.
+ */
+
+#ifndef HEATER_CONTROL_H_
+#define HEATER_CONTROL_H_
+
+#ifdef PIDTEMP
+
+  typedef struct {
+    float iState, dState;         // Sum of the errors, and the last temperature
+    float iState_min, iState_max; // Limits of the sum
+    float pTerm, iTerm, dTerm;
+    bool reset;                   // Clear the sum on coming into the PID range
+  } pid_state_t;
+
+  /**
+   * One PID step of a hotend, from 0 to PID_MAX. Further than PID_FUNCTIONAL_RANGE
+   * from the target the output is BANG_MAX or off. Ki and Kd are per sample.
+   */
+  static inline float pid_step(pid_state_t &s, const float target, const float temperature, const float Kp, const float Ki, const float Kd, const float feedforward) {
+    float output;
+    const float error = target - temperature;
+    s.dTerm = (1.0 - K1) * Kd * (temperature - s.dState) + K1 * s.dTerm;
+    s.dState = temperature;
+    if (error > PID_FUNCTIONAL_RANGE) {
+      output = BANG_MAX;
+      s.reset = true;
+    }
+    else if (error < -PID_FUNCTIONAL_RANGE || target == 0) {
+      output = 0;
+      s.reset = true;
+    }
+    else {
+      if (s.reset) {
+        s.iState = 0.0;
+        s.reset = false;
+      }
+      s.pTerm = Kp * error;
+      s.iState += error;
+      if (s.iState < s.iState_min) s.iState = s.iState_min;
+      else if (s.iState > s.iState_max) s.iState = s.iState_max;
+      s.iTerm = Ki * s.iState;
+
+      output = s.pTerm + s.iTerm - s.dTerm + feedforward;
+
+      if (output > PID_MAX) {
+        if (error > 0) s.iState -= error; // conditional un-integration
+        output = PID_MAX;
+      }
+      else if (output < 0) {
+        if (error < 0) s.iState -= error; // conditional un-integration
+        output = 0;
+      }
+    }
+    return output;
+  }
+
+#endif // PIDTEMP
+
+#if defined(THERMAL_PROTECTION_HOTENDS) || defined(THERMAL_PROTECTION_BED)
+
+  enum TRState { TRReset, TRInactive, TRFirstHeating, TRStable, TRRunaway };
+
+  /**
+   * Step the runaway protection of a heater at ms. Once the heater has reached
+   * its target, it must come back to within hysteresis_degc of it at least every
+   * period_seconds. tr_target holds the target it is watching. True on a runaway.
+   */
+  static inline bool thermal_runaway_step(TRState *state, millis_t *timer, float *tr_target, const float temperature, const float target_temperature, const millis_t ms, const int period_seconds, const int hysteresis_degc) {
+    // If the target temperature changes, restart
+    if (*tr_target != target_temperature)
+      *state = TRReset;
+
+    switch (*state) {
+      case TRReset:
+        *timer = 0;
+        *state = TRInactive;
+      // Inactive state waits for a target temperature to be set
+      case TRInactive:
+        if (target_temperature > 0) {
+          *tr_target = target_temperature;
+          *state = TRFirstHeating;
+        }
+        break;
+      // When first heating, wait for the temperature to be reached then go to Stable state
+      case TRFirstHeating:
+        if (temperature >= *tr_target) *state = TRStable;
+        break;
+      // While the temperature is stable watch for a bad temperature
+      case TRStable:
+        // If the temperature is over the target (-hysteresis) restart the timer
+        if (temperature >= *tr_target - hysteresis_degc)
+          *timer = ms;
+        // If the timer goes too long without a reset, trigger shutdown
+        else if (ms > *timer + period_seconds * 1000UL)
+          *state = TRRunaway;
+        break;
+      case TRRunaway:
+        break;
+    }
+    return *state == TRRunaway;
+  }
+
+#endif // THERMAL_PROTECTION_HOTENDS || THERMAL_PROTECTION_BED
+
+#ifdef THERMAL_PROTECTION_HOTENDS
+
+  /**
+   * Start watching a hotend heating from temperature toward target at ms. Unless
+   * it is already close, it must gain WATCH_TEMP_INCREASE within WATCH_TEMP_PERIOD.
+   * next_ms is 0 while the hotend isn't watched.
+   */
+  static inline void watch_heater_start(const float temperature, const float target, const millis_t ms, int *watch_target, millis_t *next_ms) {
+    if (temperature < target - (WATCH_TEMP_INCREASE + TEMP_HYSTERESIS + 1)) {
+      *watch_target = temperature + WATCH_TEMP_INCREASE;
+      *next_ms = ms + WATCH_TEMP_PERIOD * 1000UL;
+    }
+    else
+      *next_ms = 0;
+  }
+
+  // Check a watched hotend at ms. True if it failed to gain enough, else the watch starts over.
+  static inline bool watch_heater_check(const float temperature, const float target, const millis_t ms, int *watch_target, millis_t *next_ms) {
+    if (!*next_ms || ms <= *next_ms) return false;
+    if (temperature < *watch_target) return true;
+    watch_heater_start(temperature, target, ms, watch_target, next_ms);
+    return false;
+  }
+
+#endif // THERMAL_PROTECTION_HOTENDS
+
+#endif //HEATER_CONTROL_H_
@@ -0,0 +1,40 @@
+/**
+ * heater_sim.h - Simulated heater block and thermistor
+ *
+ * The heater block warms with the power of its heater and loses heat to the
+ * ambient air in proportion to its rise, and the thermistor follows the block
+ * with a first order lag. HEATER_SIMULATION reads the temperature sensors from
+ * this model, and the host tests in test/ run the heater control against it.
+ */
+
+#ifndef HEATER_SIM_H_
+#define HEATER_SIM_H_
+
+#include "thermistor_lookup.h"
+
+typedef struct {
+  float block_temp, sensor_temp;
+} heater_sim_t;
+
+/**
+ * Advance a heater by dt seconds with the given power (W) going in. The block
+ * has a heat capacity (J/K) and a loss (W/K) to the air at ambient, and the
+ * sensor a time constant of lag seconds.
+ */
+static inline void heater_sim_step(heater_sim_t &h, const float power, const float heat_capacity, const float loss, const float lag, const float ambient, const float dt) {
+  h.block_temp += (power - (h.block_temp - ambient) * loss) * dt / heat_capacity;
+  h.sensor_temp += (h.block_temp - h.sensor_temp) * (dt < lag ? dt / lag : 1.0);
+}
+
+// Raw value that reads as the given temperature, the inverse of temptable_lookup
+static inline int temptable_reverse_lookup(const short (*tt)[2], const uint8_t len, const float celsius) {
+  if (celsius >= PGM_RD_W(tt[0][1])) return PGM_RD_W(tt[0][0]);
+  for (uint8_t i = 1; i < len; i++) {
+    if (PGM_RD_W(tt[i][1]) <= celsius)
+      return PGM_RD_W(tt[i-1][0]) + (celsius - PGM_RD_W(tt[i-1][1])) * (PGM_RD_W(tt[i][0]) - PGM_RD_W(tt[i-1][0]))
+                                                                     / (PGM_RD_W(tt[i][1]) - PGM_RD_W(tt[i-1][1]));
+  }
+  return PGM_RD_W(tt[len-1][0]);
+}
+
+#endif //HEATER_SIM_H_
@@ -0,0 +1,92 @@
+/**
+ * isr_profiler.cpp - Cycle-count statistics for the stepper and temperature ISRs
+ *
+ * M801     Report min/max/mean run time, histogram and late runs of both ISRs
+ * M801 R   Report, then reset the statistics
+ *
+ * Times are reported in CPU cycles (F_CPU, 84MHz on the Due) and microseconds.
+ * Compare the mean and max of the stepper ISR with HAL_TIMER_RATE / step rate
+ * to see how much headroom is left before MAX_STEP_FREQUENCY and
+ * DOUBLE_STEP_FREQUENCY (Conditionals.h) are reached.
+ */
+
+#include "Marlin.h"
+
+#ifdef ISR_PROFILING
+
+#include "isr_profiler.h"
+
+isr_profile_t isr_profile_step, isr_profile_temp;
+
+static void isr_profile_clear(isr_profile_t &p) {
+  memset(&p, 0, sizeof(p));
+  p.min = 0xFFFFFFFF;
+}
+
+void isr_profile_reset() {
+  CRITICAL_SECTION_START;
+  isr_profile_clear(isr_profile_step);
+  isr_profile_clear(isr_profile_temp);
+  CRITICAL_SECTION_END;
+}
+
+void isr_profile_init() {
+  HAL_cycle_counter_init();
+  isr_profile_reset();
+}
+
+static void isr_profile_print_cycles(const char *label, const uint32_t cycles) {
+  serialprintPGM(label);
+  SERIAL_PROTOCOL(cycles);
+  SERIAL_PROTOCOLPGM(" (");
+  SERIAL_PROTOCOL_F(cycles / (F_CPU / 1000000.0), 2);
+  SERIAL_PROTOCOLPGM("us)");
+}
+
+static void isr_profile_print(const char *name, const isr_profile_t &p) {
+  SERIAL_ECHO_START;
+  serialprintPGM(name);
+  SERIAL_ECHOPAIR(" runs:", (unsigned long)p.count);
+  if (p.count) {
+    isr_profile_print_cycles(PSTR(" min:"), p.min);
+    isr_profile_print_cycles(PSTR(" max:"), p.max);
+    isr_profile_print_cycles(PSTR(" mean:"), (uint32_t)(p.total / p.count));
+  }
+  SERIAL_ECHOPAIR(" late:", (unsigned long)p.late);
+  SERIAL_EOL;
+
+  SERIAL_ECHO_START;
+  serialprintPGM(name);
+  SERIAL_ECHOPGM(" hist:");
+  for (uint8_t i = 0; i < ISR_PROFILING_BUCKETS; i++) {
+    SERIAL_CHAR(' ');
+    if (i < ISR_PROFILING_BUCKETS - 1) {
+      SERIAL_CHAR('<');
+      SERIAL_PROTOCOL(1UL << (i + ISR_PROFILING_MIN_BITS));
+    }
+    else {
+      SERIAL_PROTOCOLPGM(">=");
+      SERIAL_PROTOCOL(1UL << (i + ISR_PROFILING_MIN_BITS - 1));
+    }
+    SERIAL_CHAR(':');
+    SERIAL_PROTOCOL(p.histogram[i]);
+  }
+  SERIAL_EOL;
+}
+
+void isr_profile_report(const bool reset) {
+  isr_profile_t step, temp;
+
+  // Take a consistent copy, the ISRs keep running while we print
+  CRITICAL_SECTION_START;
+  step = isr_profile_step;
+  temp = isr_profile_temp;
+  CRITICAL_SECTION_END;
+
+  if (reset) isr_profile_reset();
+
+  isr_profile_print(PSTR("Stepper ISR"), step);
+  isr_profile_print(PSTR("Temp ISR"), temp);
+}
+
+#endif // ISR_PROFILING
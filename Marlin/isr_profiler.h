@@ -0,0 +1,56 @@
+/**
+ * isr_profiler.h - Cycle-count statistics for the stepper and temperature ISRs
+ *
+ * Each ISR run is timed with the DWT cycle counter (see HAL_cycle_count).
+ * The collected data is reported and reset with M801.
+ */
+
+#ifndef ISR_PROFILER_H
+#define ISR_PROFILER_H
+
+#include "Marlin.h"
+
+#ifdef ISR_PROFILING
+
+  typedef struct {
+    uint32_t count,     // Number of completed ISR runs
+             min,       // Shortest run in cycles
+             max,       // Longest run in cycles
+             late;      // Runs that could not keep up with the requested timer period
+    uint64_t total;     // Sum of all runs in cycles, for the mean
+    // Bucket 0 counts runs shorter than 2^ISR_PROFILING_MIN_BITS cycles,
+    // bucket n counts runs of [2^(n+ISR_PROFILING_MIN_BITS-1), 2^(n+ISR_PROFILING_MIN_BITS)) cycles.
+    // The last bucket also takes everything longer.
+    uint32_t histogram[ISR_PROFILING_BUCKETS];
+  } isr_profile_t;
+
+  extern isr_profile_t isr_profile_step, isr_profile_temp;
+
+  void isr_profile_init();
+  void isr_profile_reset();
+  void isr_profile_report(const bool reset);
+
+  FORCE_INLINE void isr_profile_record(isr_profile_t &p, const uint32_t cycles) {
+    p.count++;
+    p.total += cycles;
+    if (cycles < p.min) p.min = cycles;
+    if (cycles > p.max) p.max = cycles;
+    int b = (31 - __CLZ(cycles | 1)) - (ISR_PROFILING_MIN_BITS - 1);
+    p.histogram[b < 0 ? 0 : (b >= ISR_PROFILING_BUCKETS ? ISR_PROFILING_BUCKETS - 1 : b)]++;
+  }
+
+  /**
+   * Declared at the top of an ISR, records the run length on every exit path
+   */
+  class IsrProfileScope {
+    public:
+      FORCE_INLINE IsrProfileScope(isr_profile_t &p) : profile(p), start(HAL_cycle_count()) {}
+      FORCE_INLINE ~IsrProfileScope() { isr_profile_record(profile, HAL_cycle_count() - start); }
+    private:
+      isr_profile_t &profile;
+      const uint32_t start;
+  };
+
+#endif // ISR_PROFILING
+
+#endif // ISR_PROFILER_H
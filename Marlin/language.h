@@ -100,6 +100,7 @@
 #define MSG_OK                              "ok"
 #define MSG_WAIT                            "wait"
 #define MSG_FILE_SAVED                      "Done saving file."
+#define MSG_ERR_BINARY_SAVING               "Binary command not saved. Send text until M29"
 #define MSG_ERR_LINE_NO                     "Line Number is not Last Line Number+1, Last Line: "
 #define MSG_ERR_CHECKSUM_MISMATCH           "checksum mismatch, Last Line: "
 #define MSG_ERR_NO_CHECKSUM                 "No Checksum with line number, Last Line: "
@@ -158,6 +159,7 @@
 #define MSG_BABYSTEPPING_X                  "Babystepping X"
 #define MSG_BABYSTEPPING_Y                  "Babystepping Y"
 #define MSG_BABYSTEPPING_Z                  "Babystepping Z"
+#define MSG_BABYSTEP_OFFSET                 "Babystep offset:"
 #define MSG_SERIAL_ERROR_MENU_STRUCTURE     "Error in menu structure"
 
 #define MSG_ERR_EEPROM_WRITE                "Error writing to EEPROM!"
@@ -189,7 +191,16 @@
 #define MSG_PID_DEBUG_PTERM                 " pTerm "
 #define MSG_PID_DEBUG_ITERM                 " iTerm "
 #define MSG_PID_DEBUG_DTERM                 " dTerm "
+#define MSG_PID_DEBUG_CTERM                 " cTerm "
 #define MSG_INVALID_EXTRUDER_NUM            " - Invalid extruder number !"
+#define MSG_MPC_AUTOTUNE                    "MPC Autotune"
+#define MSG_MPC_AUTOTUNE_START              MSG_MPC_AUTOTUNE " start"
+#define MSG_MPC_AUTOTUNE_FAILED             MSG_MPC_AUTOTUNE " failed!"
+#define MSG_MPC_COOLING_TO_AMBIENT          "Cooling to ambient"
+#define MSG_MPC_HEATING_PAST                "Heating at full power to "
+#define MSG_MPC_MEASURING_HEAT_LOSS         "Measuring heat loss"
+#define MSG_MPC_MEASURING_FAN_LOSS          "Measuring heat loss with the fan on"
+#define MSG_MPC_AUTOTUNE_FINISHED           MSG_MPC_AUTOTUNE " finished! Save the values below with M500"
 
 #define MSG_HEATER_BED                      "bed"
 #define MSG_STOPPED_HEATER                  ", system stopped! Heater_ID: "
@@ -14,6 +14,9 @@
 #define NOLESS(v,n) do{ if (v < n) v = n; }while(0)
 #define NOMORE(v,n) do{ if (v > n) v = n; }while(0)
 
+// Macros for character classes
+#define NUMERIC(a) ((a) >= '0' && '9' >= (a))
+
 // Macros to support option testing
 #define _CAT(a, ...) a ## __VA_ARGS__
 #define SWITCH_ENABLED_0 0
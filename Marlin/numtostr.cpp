@@ -0,0 +1,299 @@
+/**
+ * numtostr.cpp - Number to string conversion for serial and LCD output
+ */
+
+#include <limits.h>
+#include "Marlin.h"
+#include "numtostr.h"
+
+static const uint32_t pow10_fixed[FTOSTR_MAX_PLACES + 1] = {
+  1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+
+/**
+ * Split |x| into its whole part and its fraction times 10^places, rounded to the nearest.
+ * A float is m * 2^-shift with m under 2^24, so the fraction times 10^places is exact in 64 bits.
+ * The whole part saturates from 2^32.
+ */
+static void fixed_split(const float &x, const uint8_t places, uint32_t &whole, uint32_t &fraction) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int exponent = (bits >> 23) & 0xFF;
+  uint32_t m = bits & 0x7FFFFFUL;
+  if (exponent) m |= 0x800000UL; else exponent = 1; // Denormals have no hidden bit
+  const int shift = 150 - exponent;
+
+  fraction = 0;
+  if (shift < -8) { whole = 0xFFFFFFFFUL; return; } // 2^32 and more, inf, nan
+  if (shift <= 0) { whole = m << -shift; return; }
+  if (shift < 24) {
+    whole = m >> shift;
+    m &= (1UL << shift) - 1;
+  }
+  else
+    whole = 0;
+  if (shift < 64) fraction = ((uint64_t)m * pow10_fixed[places] + (1ULL << (shift - 1))) >> shift;
+  if (fraction == pow10_fixed[places]) { // Rounded up to the next whole
+    whole++;
+    fraction = 0;
+  }
+}
+
+char *ftostr_fixed(char *buf, const float &x, uint8_t places) {
+  if (isnan(x)) { strcpy(buf, "nan"); return buf + 3; }
+  if (isinf(x)) { strcpy(buf, "inf"); return buf + 3; }
+  if (x > 4294967040.0 || x < -4294967040.0) { strcpy(buf, "ovf"); return buf + 3; }
+  NOMORE(places, FTOSTR_MAX_PLACES);
+
+  uint32_t whole, fraction;
+  fixed_split(x, places, whole, fraction);
+
+  char *p = buf;
+  if (x < 0) *p++ = '-';
+  char digits[10];
+  uint8_t n = 0;
+  do { digits[n++] = '0' + whole % 10; whole /= 10; } while (whole);
+  while (n) *p++ = digits[--n];
+  if (places) {
+    *p++ = '.';
+    for (uint8_t i = places; i--;) { p[i] = '0' + fraction % 10; fraction /= 10; }
+    p += places;
+  }
+  *p = '\0';
+  return p;
+}
+
+long ftol_fixed(const float &x, const uint8_t places) {
+  uint32_t whole, fraction;
+  fixed_split(x, places, whole, fraction);
+  uint64_t xx = (uint64_t)whole * pow10_fixed[places] + fraction;
+  NOMORE(xx, (uint64_t)LONG_MAX);
+  return x < 0 ? -(long)xx : (long)xx;
+}
+
+char conv[8];
+
+// Convert float to string with +123.4 format
+char *ftostr3(const float &x) {
+  return itostr3(ftol_fixed(x, 0));
+}
+
+// Convert int to string with 12 format
+char *itostr2(const uint8_t &x) {
+  //sprintf(conv,"%5.1f",x);
+  int xx = x;
+  conv[0] = (xx / 10) % 10 + '0';
+  conv[1] = xx % 10 + '0';
+  conv[2] = 0;
+  return conv;
+}
+
+// Convert float to string with +123.4 format
+char *ftostr31(const float &x) {
+  long xx = labs(ftol_fixed(x, 1));
+  conv[0] = (x >= 0) ? '+' : '-';
+  conv[1] = (xx / 1000) % 10 + '0';
+  conv[2] = (xx / 100) % 10 + '0';
+  conv[3] = (xx / 10) % 10 + '0';
+  conv[4] = '.';
+  conv[5] = xx % 10 + '0';
+  conv[6] = 0;
+  return conv;
+}
+
+// Convert float to string with 123.4 format, dropping sign
+char *ftostr31ns(const float &x) {
+  long xx = labs(ftol_fixed(x, 1));
+  conv[0] = (xx / 1000) % 10 + '0';
+  conv[1] = (xx / 100) % 10 + '0';
+  conv[2] = (xx / 10) % 10 + '0';
+  conv[3] = '.';
+  conv[4] = xx % 10 + '0';
+  conv[5] = 0;
+  return conv;
+}
+
+// Convert float to string with 123.4 format
+char *ftostr32(const float &x) {
+  long xx = labs(ftol_fixed(x, 2));
+  conv[0] = x >= 0 ? (xx / 10000) % 10 + '0' : '-';
+  conv[1] = (xx / 1000) % 10 + '0';
+  conv[2] = (xx / 100) % 10 + '0';
+  conv[3] = '.';
+  conv[4] = (xx / 10) % 10 + '0';
+  conv[5] = xx % 10 + '0';
+  conv[6] = 0;
+  return conv;
+}
+
+// Convert float to string with 1.234 format
+char *ftostr43(const float &x) {
+  long xx = ftol_fixed(x, 3);
+  if (xx >= 0)
+    conv[0] = (xx / 1000) % 10 + '0';
+  else
+    conv[0] = '-';
+  xx = labs(xx);
+  conv[1] = '.';
+  conv[2] = (xx / 100) % 10 + '0';
+  conv[3] = (xx / 10) % 10 + '0';
+  conv[4] = xx % 10 + '0';
+  conv[5] = 0;
+  return conv;
+}
+
+// Convert float to string with 1.23 format
+char *ftostr12ns(const float &x) {
+  long xx = labs(ftol_fixed(x, 2));
+  conv[0] = (xx / 100) % 10 + '0';
+  conv[1] = '.';
+  conv[2] = (xx / 10) % 10 + '0';
+  conv[3] = xx % 10 + '0';
+  conv[4] = 0;
+  return conv;
+}
+
+// Convert float to space-padded string with -_23.4_ format
+char *ftostr32sp(const float &x) {
+  long xx = labs(ftol_fixed(x, 2));
+  uint8_t dig;
+
+  if (x < 0) { // negative val = -_0
+    conv[0] = '-';
+    dig = (xx / 1000) % 10;
+    conv[1] = dig ? '0' + dig : ' ';
+  }
+  else { // positive val = __0
+    dig = (xx / 10000) % 10;
+    if (dig) {
+      conv[0] = '0' + dig;
+      conv[1] = '0' + (xx / 1000) % 10;
+    }
+    else {
+      conv[0] = ' ';
+      dig = (xx / 1000) % 10;
+      conv[1] = dig ? '0' + dig : ' ';
+    }
+  }
+
+  conv[2] = '0' + (xx / 100) % 10; // lsd always
+
+  dig = xx % 10;
+  if (dig) { // 2 decimal places
+    conv[5] = '0' + dig;
+    conv[4] = '0' + (xx / 10) % 10;
+    conv[3] = '.';
+  }
+  else { // 1 or 0 decimal place
+    dig = (xx / 10) % 10;
+    if (dig) {
+      conv[4] = '0' + dig;
+      conv[3] = '.';
+    }
+    else {
+      conv[3] = conv[4] = ' ';
+    }
+    conv[5] = ' ';
+  }
+  conv[6] = '\0';
+  return conv;
+}
+
+// Convert int to lj string with +123.0 format
+char *itostr31(const int &x) {
+  conv[0] = x >= 0 ? '+' : '-';
+  int xx = abs(x);
+  conv[1] = (xx / 100) % 10 + '0';
+  conv[2] = (xx / 10) % 10 + '0';
+  conv[3] = xx % 10 + '0';
+  conv[4] = '.';
+  conv[5] = '0';
+  conv[6] = 0;
+  return conv;
+}
+
+// Convert int to rj string with 123 or -12 format
+char *itostr3(const int &x) {
+  int xx = x;
+  if (xx < 0) {
+     conv[0] = '-';
+     xx = -xx;
+  }
+  else
+    conv[0] = xx >= 100 ? (xx / 100) % 10 + '0' : ' ';
+
+  conv[1] = xx >= 10 ? (xx / 10) % 10 + '0' : ' ';
+  conv[2] = xx % 10 + '0';
+  conv[3] = 0;
+  return conv;
+}
+
+// Convert int to lj string with 123 format
+char *itostr3left(const int &xx) {
+  if (xx >= 100) {
+    conv[0] = (xx / 100) % 10 + '0';
+    conv[1] = (xx / 10) % 10 + '0';
+    conv[2] = xx % 10 + '0';
+    conv[3] = 0;
+  }
+  else if (xx >= 10) {
+    conv[0] = (xx / 10) % 10 + '0';
+    conv[1] = xx % 10 + '0';
+    conv[2] = 0;
+  }
+  else {
+    conv[0] = xx % 10 + '0';
+    conv[1] = 0;
+  }
+  return conv;
+}
+
+// Convert int to rj string with 1234 format
+char *itostr4(const int &xx) {
+  conv[0] = xx >= 1000 ? (xx / 1000) % 10 + '0' : ' ';
+  conv[1] = xx >= 100 ? (xx / 100) % 10 + '0' : ' ';
+  conv[2] = xx >= 10 ? (xx / 10) % 10 + '0' : ' ';
+  conv[3] = xx % 10 + '0';
+  conv[4] = 0;
+  return conv;
+}
+
+// Convert float to rj string with 12345 format
+char *ftostr5(const float &x) {
+  long xx = labs(ftol_fixed(x, 0));
+  conv[0] = xx >= 10000 ? (xx / 10000) % 10 + '0' : ' ';
+  conv[1] = xx >= 1000 ? (xx / 1000) % 10 + '0' : ' ';
+  conv[2] = xx >= 100 ? (xx / 100) % 10 + '0' : ' ';
+  conv[3] = xx >= 10 ? (xx / 10) % 10 + '0' : ' ';
+  conv[4] = xx % 10 + '0';
+  conv[5] = 0;
+  return conv;
+}
+
+// Convert float to string with +1234.5 format
+char *ftostr51(const float &x) {
+  long xx = labs(ftol_fixed(x, 1));
+  conv[0] = (x >= 0) ? '+' : '-';
+  conv[1] = (xx / 10000) % 10 + '0';
+  conv[2] = (xx / 1000) % 10 + '0';
+  conv[3] = (xx / 100) % 10 + '0';
+  conv[4] = (xx / 10) % 10 + '0';
+  conv[5] = '.';
+  conv[6] = xx % 10 + '0';
+  conv[7] = 0;
+  return conv;
+}
+
+// Convert float to string with +123.45 format
+char *ftostr52(const float &x) {
+  conv[0] = (x >= 0) ? '+' : '-';
+  long xx = labs(ftol_fixed(x, 2));
+  conv[1] = (xx / 10000) % 10 + '0';
+  conv[2] = (xx / 1000) % 10 + '0';
+  conv[3] = (xx / 100) % 10 + '0';
+  conv[4] = '.';
+  conv[5] = (xx / 10) % 10 + '0';
+  conv[6] = xx % 10 + '0';
+  conv[7] = 0;
+  return conv;
+}
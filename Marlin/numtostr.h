@@ -0,0 +1,40 @@
+/**
+ * numtostr.h - Number to string conversion for serial and LCD output
+ *
+ * Floats are converted to fixed point with integer arithmetic only, rounded to
+ * the nearest. The LCD formats return a shared buffer, overwritten by the next call.
+ */
+
+#ifndef NUMTOSTR_H
+#define NUMTOSTR_H
+
+#include <stdint.h>
+
+#define FTOSTR_MAX_PLACES 9
+#define FTOSTR_SIZE 22 // "-4294967039.123456789" and the NUL
+
+// x with the given decimal places, as Print::print(x, places) writes it.
+// Returns the end of the string in buf, which must hold FTOSTR_SIZE bytes.
+char *ftostr_fixed(char *buf, const float &x, uint8_t places);
+
+// x times 10^places, rounded to the nearest
+long ftol_fixed(const float &x, const uint8_t places);
+
+char *itostr2(const uint8_t &x);
+char *itostr31(const int &xx);
+char *itostr3(const int &xx);
+char *itostr3left(const int &xx);
+char *itostr4(const int &xx);
+
+char *ftostr3(const float &x);
+char *ftostr31ns(const float &x); // float to string without sign character
+char *ftostr31(const float &x);
+char *ftostr32(const float &x);
+char *ftostr43(const float &x);
+char *ftostr12ns(const float &x);
+char *ftostr32sp(const float &x); // remove zero-padding from ftostr32
+char *ftostr5(const float &x);
+char *ftostr51(const float &x);
+char *ftostr52(const float &x);
+
+#endif // NUMTOSTR_H
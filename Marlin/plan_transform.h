@@ -0,0 +1,40 @@
+/**
+ * plan_transform.h - The skew correction of the planner, as a 3x3 matrix
+ *
+ * Matrices have the layout of matrix_3x3 and apply to row vectors like
+ * vector_3::apply_rotation. Only inline functions, so the host tests in
+ * Marlin/test can build them without the rest of the planner.
+ */
+
+#ifndef PLAN_TRANSFORM_H
+#define PLAN_TRANSFORM_H
+
+#include <stdint.h>
+
+// result = a * b
+static inline void matrix_multiply(const float a[9], const float b[9], float result[9]) {
+  for (uint8_t i = 0; i < 3; i++)
+    for (uint8_t j = 0; j < 3; j++)
+      result[3*i+j] = a[3*i+0] * b[3*0+j] + a[3*i+1] * b[3*1+j] + a[3*i+2] * b[3*2+j];
+}
+
+/**
+ * Skewed frame: X moves by xy per unit of Y and xz per unit of Z, Y by yz per unit of Z.
+ * The correction is the inverse of that.
+ */
+static inline void skew_matrices(const float xy, const float xz, const float yz, float skew[9], float unskew[9]) {
+  const float s[9] = { 1, 0, 0,  -xy, 1, 0,  -(xz - xy * yz), -yz, 1 },
+              u[9] = { 1, 0, 0,  xy, 1, 0,  xz, yz, 1 };
+  for (uint8_t i = 0; i < 9; i++) { skew[i] = s[i]; unskew[i] = u[i]; }
+}
+
+static inline void apply_transform(const float m[9], float &x, float &y, float &z) {
+  const float rx = x * m[3*0+0] + y * m[3*1+0] + z * m[3*2+0],
+              ry = x * m[3*0+1] + y * m[3*1+1] + z * m[3*2+1],
+              rz = x * m[3*0+2] + y * m[3*1+2] + z * m[3*2+2];
+  x = rx;
+  y = ry;
+  z = rz;
+}
+
+#endif // PLAN_TRANSFORM_H
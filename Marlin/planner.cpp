@@ -93,6 +93,18 @@ unsigned long axis_steps_per_sqr_second[NUM_AXIS];
   bool autotemp_enabled = false;
 #endif
 
+#ifdef BACKLASH_COMPENSATION
+  float backlash_distance_mm[3] = BACKLASH_DISTANCE_MM;
+  float backlash_correction = BACKLASH_CORRECTION;
+  float backlash_smoothing_mm = BACKLASH_SMOOTHING_MM;
+#endif
+
+#ifdef SKEW_CORRECTION
+  float skew_factor_xy = XY_SKEW_FACTOR,
+        skew_factor_xz = XZ_SKEW_FACTOR,
+        skew_factor_yz = YZ_SKEW_FACTOR;
+#endif
+
 //===========================================================================
 //============ semi-private variables, used in inline functions =============
 //===========================================================================
@@ -125,6 +137,43 @@ unsigned char g_uc_extruder_last_move[4] = {0,0,0,0};
   static char meas_sample; //temporary variable to hold filament measurement sample
 #endif
 
+#ifdef BACKLASH_COMPENSATION
+  // Direction of the last move of each X, Y, Z motor, set bits are negative as in direction_bits
+  static uint8_t backlash_last_direction_bits = 0;
+  // Correction steps still to be taken up, per motor
+  static float backlash_residual_steps[3] = { 0 };
+
+  // How far each X, Y, Z motor turns for a move of dx, dy, dz
+  #ifdef COREXY
+    #define BACKLASH_MOTOR_DELTA(dx, dy, dz) { (dx) + (dy), (dx) - (dy), (dz) }
+  #elif defined(COREXZ)
+    #define BACKLASH_MOTOR_DELTA(dx, dy, dz) { (dx) + (dz), (dy), (dx) - (dz) }
+  #else
+    #define BACKLASH_MOTOR_DELTA(dx, dy, dz) { (dx), (dy), (dz) }
+  #endif
+
+  void plan_backlash_homed(const uint8_t axis, const int home_dir) {
+    float d[3] = { 0 };
+    d[axis] = home_dir;
+    const float motor_delta[3] = BACKLASH_MOTOR_DELTA(d[X_AXIS], d[Y_AXIS], d[Z_AXIS]);
+    for (uint8_t m = 0; m < 3; m++) {
+      if (motor_delta[m] == 0) continue;
+      const bool negative = motor_delta[m] < 0;
+      SET_BIT(backlash_last_direction_bits, m, negative);
+      backlash_residual_steps[m] = 0;
+    }
+  }
+#endif
+
+#ifdef SKEW_CORRECTION
+  #include "plan_transform.h"
+
+  // Bed leveling rotation followed by skew correction, and its inverse.
+  // Same layout as matrix_3x3, applied to row vectors like vector_3::apply_rotation.
+  static float plan_transform[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 },
+               plan_transform_inverse[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+#endif
+
 //===========================================================================
 //================================ functions ================================
 //===========================================================================
@@ -134,6 +183,33 @@ unsigned char g_uc_extruder_last_move[4] = {0,0,0,0};
 FORCE_INLINE int8_t next_block_index(int8_t block_index) { return BLOCK_MOD(block_index + 1); }
 FORCE_INLINE int8_t prev_block_index(int8_t block_index) { return BLOCK_MOD(block_index - 1); }
 
+#ifdef SKEW_CORRECTION
+
+  static bool skew_enabled = true;
+
+  void plan_update_transform() {
+    float skew[9], unskew[9];
+    if (skew_enabled)
+      skew_matrices(skew_factor_xy, skew_factor_xz, skew_factor_yz, skew, unskew);
+    else
+      skew_matrices(0, 0, 0, skew, unskew);
+    #ifdef ENABLE_AUTO_BED_LEVELING
+      matrix_3x3 inverse = matrix_3x3::transpose(plan_bed_level_matrix); // Rotation, so the transpose is the inverse
+      matrix_multiply(plan_bed_level_matrix.matrix, skew, plan_transform);
+      matrix_multiply(unskew, inverse.matrix, plan_transform_inverse);
+    #else
+      memcpy(plan_transform, skew, sizeof(skew));
+      memcpy(plan_transform_inverse, unskew, sizeof(unskew));
+    #endif
+  }
+
+  void plan_set_skew_enabled(const bool enabled) {
+    skew_enabled = enabled;
+    plan_update_transform();
+  }
+
+#endif // SKEW_CORRECTION
+
 // Calculates the distance (not time) it takes to accelerate from initial_rate to target_rate using the 
 // given acceleration:
 FORCE_INLINE float estimate_acceleration_distance(float initial_rate, float target_rate, float acceleration) {
@@ -358,6 +434,9 @@ void plan_init() {
   memset(position, 0, sizeof(position)); // clear position
   for (int i=0; i<NUM_AXIS; i++) previous_speed[i] = 0.0; 
   previous_nominal_speed = 0.0;
+  #ifdef SKEW_CORRECTION
+    plan_update_transform();
+  #endif
 }
 
 
@@ -391,6 +470,31 @@ void plan_init() {
   }
 #endif
 
+#if defined(MPCTEMP) || defined(PID_ADD_EXTRUSION_RATE)
+  float plan_e_speed(uint8_t extruder, float lookahead) {
+    float e_mm = 0, time = 0;
+    for (uint8_t b = block_buffer_tail; b != block_buffer_head; b = next_block_index(b)) {
+      // Copy the block with the stepper ISR held off, the float math comes after
+      CRITICAL_SECTION_START;
+      const block_t *block = &block_buffer[b];
+      const float millimeters = block->millimeters, nominal_speed = block->nominal_speed;
+      // Retractions take no heat from the hotend
+      const long e_steps = block->active_extruder == extruder && !(block->direction_bits & BIT(E_AXIS)) ? block->steps[E_AXIS] : 0;
+      CRITICAL_SECTION_END;
+
+      float block_time = millimeters / nominal_speed, e_speed = 0;
+      if (e_steps) e_speed = e_steps / axis_steps_per_unit[E_AXIS] / block_time;
+      if (lookahead <= 0) return e_speed;
+
+      float t = min(block_time, lookahead - time);
+      e_mm += e_speed * t;
+      time += t;
+      if (time >= lookahead) break;
+    }
+    return time > 0 ? e_mm / time : 0;
+  }
+#endif
+
 void check_axes_activity() {
   unsigned char axis_active[NUM_AXIS] = { 0 },
                 tail_fan_speed = fanSpeed;
@@ -472,7 +576,7 @@ float junction_deviation = 0.1;
 // Add a new linear movement to the buffer. steps[X_AXIS], _y and _z is the absolute position in 
 // mm. Microseconds specify how many microseconds the move should take to perform. To aid acceleration
 // calculation the caller must also provide the physical length of the line in millimeters.
-#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING)
+#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING) || defined(SKEW_CORRECTION)
   void plan_buffer_line(float x, float y, float z, const float &e, float feed_rate, const uint8_t &extruder)
 #else
   void plan_buffer_line(const float &x, const float &y, const float &z, const float &e, float feed_rate, const uint8_t &extruder)
@@ -487,9 +591,12 @@ float junction_deviation = 0.1;
 
   #ifdef MESH_BED_LEVELING
     if (mbl.active) z += mbl.get_z(x, y);
-  #elif defined(ENABLE_AUTO_BED_LEVELING)
+  #elif defined(ENABLE_AUTO_BED_LEVELING) && !defined(SKEW_CORRECTION)
     apply_rotation_xyz(plan_bed_level_matrix, x, y, z);
   #endif
+  #ifdef SKEW_CORRECTION
+    apply_transform(plan_transform, x, y, z); // Bed leveling rotation and skew in one multiply
+  #endif
 
   // The target position of the tool in absolute steps
   // Calculate target position in absolute steps
@@ -729,6 +836,41 @@ float junction_deviation = 0.1;
       #endif
     );
   }
+
+  #ifdef BACKLASH_COMPENSATION
+    /**
+     * When a motor reverses, the play of its axis becomes a residual that is
+     * taken up by adding steps to this and the following blocks that move the
+     * motor in the same direction. With backlash_smoothing_mm set, a block takes
+     * up only millimeters / backlash_smoothing_mm of what is left.
+     * The block length is left as planned, but the added steps count toward
+     * the motor's max_feedrate below, which may slow the block down.
+     */
+    for (uint8_t axis = 0; axis < 3; axis++) block->backlash_steps[axis] = 0;
+    if (backlash_correction > 0) {
+      const float motor_delta[3] = BACKLASH_MOTOR_DELTA(dx, dy, dz);
+      const float proportion = backlash_smoothing_mm > 0 ? min(1.0, block->millimeters / backlash_smoothing_mm) : 1.0;
+      for (uint8_t axis = 0; axis < 3; axis++) {
+        if (motor_delta[axis] == 0) continue;
+        const bool reversing = TEST(db, axis);
+        if (reversing != TEST(backlash_last_direction_bits, axis)) {
+          backlash_residual_steps[axis] += (reversing ? -1 : 1) * backlash_correction * backlash_distance_mm[axis] * axis_steps_per_unit[axis];
+          backlash_last_direction_bits ^= BIT(axis);
+        }
+        const float residual = backlash_residual_steps[axis];
+        if (residual == 0 || (residual < 0) != reversing) continue;
+        long steps = lround(fabs(residual) * proportion);
+        if (!steps) steps = lround(fabs(residual)); // Don't leave a remainder that never gets taken up
+        if (!steps) continue;
+        block->steps[axis] += steps;
+        if (reversing) steps = -steps;
+        backlash_residual_steps[axis] -= steps;
+        block->backlash_steps[axis] = steps;
+      }
+      block->step_event_count = max(block->steps[X_AXIS], max(block->steps[Y_AXIS], max(block->steps[Z_AXIS], block->steps[E_AXIS])));
+    }
+  #endif // BACKLASH_COMPENSATION
+
   float inverse_millimeters = 1.0 / block->millimeters;  // Inverse millimeters to remove multiple divides 
 
   // Calculate speed in mm/second for each axis. No divide by zero due to previous checks.
@@ -792,6 +934,11 @@ float junction_deviation = 0.1;
   for (int i = 0; i < NUM_AXIS; i++) {
     current_speed[i] = delta_mm[i] * inverse_second;
     float cs = fabs(current_speed[i]), mf = max_feedrate[i];
+    #ifdef BACKLASH_COMPENSATION
+      // The motor takes up its backlash steps in the same time, so they count toward its limit
+      if (i < 3 && block->backlash_steps[i])
+        cs = fabs((delta_mm[i] + block->backlash_steps[i] / axis_steps_per_unit[i]) * inverse_second);
+    #endif
     if (cs > mf) speed_factor = min(speed_factor, mf / cs);
   }
 
@@ -991,32 +1138,39 @@ float junction_deviation = 0.1;
 
 } // plan_buffer_line()
 
+#if (defined(ENABLE_AUTO_BED_LEVELING) && !defined(DELTA)) || defined(SKEW_CORRECTION)
+  void plan_unapply_transform(float &x, float &y, float &z) {
+    #ifdef SKEW_CORRECTION
+      apply_transform(plan_transform_inverse, x, y, z);
+    #else
+      apply_rotation_xyz(matrix_3x3::transpose(plan_bed_level_matrix), x, y, z);
+    #endif
+  }
+#endif
+
 #if defined(ENABLE_AUTO_BED_LEVELING) && !defined(DELTA)
   vector_3 plan_get_position() {
-    vector_3 position = vector_3(st_get_position_mm(X_AXIS), st_get_position_mm(Y_AXIS), st_get_position_mm(Z_AXIS));
-
-    //position.debug("in plan_get position");
-    //plan_bed_level_matrix.debug("in plan_get_position");
-    matrix_3x3 inverse = matrix_3x3::transpose(plan_bed_level_matrix);
-    //inverse.debug("in plan_get inverse");
-    position.apply_rotation(inverse);
-    //position.debug("after rotation");
-
-    return position;
+    float pos[NUM_AXIS];
+    st_get_positions_mm(pos); // X, Y and Z from the same instant
+    plan_unapply_transform(pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS]);
+    return vector_3(pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS]);
   }
 #endif // ENABLE_AUTO_BED_LEVELING && !DELTA
 
-#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING)
+#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING) || defined(SKEW_CORRECTION)
   void plan_set_position(float x, float y, float z, const float &e)
 #else
   void plan_set_position(const float &x, const float &y, const float &z, const float &e)
-#endif // ENABLE_AUTO_BED_LEVELING || MESH_BED_LEVELING
+#endif // ENABLE_AUTO_BED_LEVELING || MESH_BED_LEVELING || SKEW_CORRECTION
   {
     #ifdef MESH_BED_LEVELING
       if (mbl.active) z += mbl.get_z(x, y);
-    #elif defined(ENABLE_AUTO_BED_LEVELING)
+    #elif defined(ENABLE_AUTO_BED_LEVELING) && !defined(SKEW_CORRECTION)
       apply_rotation_xyz(plan_bed_level_matrix, x, y, z);
     #endif
+    #ifdef SKEW_CORRECTION
+      apply_transform(plan_transform, x, y, z);
+    #endif
 
     float nx = position[X_AXIS] = lround(x * axis_steps_per_unit[X_AXIS]),
           ny = position[Y_AXIS] = lround(y * axis_steps_per_unit[Y_AXIS]),
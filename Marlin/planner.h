@@ -43,6 +43,9 @@ typedef struct {
     volatile long final_advance;
     float advance;
   #endif
+  #ifdef BACKLASH_COMPENSATION
+    long backlash_steps[3];                 // Correction steps among steps[], negative when moving backwards
+  #endif
 
   // Fields used by the motion planner to manage acceleration
   // float speed_x, speed_y, speed_z, speed_e;          // Nominal mm/sec for each axis
@@ -79,7 +82,7 @@ extern volatile unsigned char block_buffer_head;
 extern volatile unsigned char block_buffer_tail;
 FORCE_INLINE uint8_t movesplanned() { return BLOCK_MOD(block_buffer_head - block_buffer_tail + BLOCK_BUFFER_SIZE); }
 
-#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING)
+#if defined(ENABLE_AUTO_BED_LEVELING) || defined(MESH_BED_LEVELING) || defined(SKEW_CORRECTION)
 
   #if defined(ENABLE_AUTO_BED_LEVELING)
     #include "vector_3.h"
@@ -111,10 +114,42 @@ FORCE_INLINE uint8_t movesplanned() { return BLOCK_MOD(block_buffer_head - block
   void plan_buffer_line(const float &x, const float &y, const float &z, const float &e, float feed_rate, const uint8_t &extruder);
   void plan_set_position(const float &x, const float &y, const float &z, const float &e);
 
-#endif // ENABLE_AUTO_BED_LEVELING || MESH_BED_LEVELING
+#endif // ENABLE_AUTO_BED_LEVELING || MESH_BED_LEVELING || SKEW_CORRECTION
+
+#ifdef SKEW_CORRECTION
+  /**
+   * Rebuild the planner transform from the skew factors and plan_bed_level_matrix.
+   * Call after changing either.
+   */
+  void plan_update_transform();
+
+  /**
+   * Switch the skew correction off, for G28 to home in machine coordinates,
+   * and back on. The bed leveling rotation is kept.
+   */
+  void plan_set_skew_enabled(const bool enabled);
+#else
+  FORCE_INLINE void plan_update_transform() {}
+#endif
+
+#if (defined(ENABLE_AUTO_BED_LEVELING) && !defined(DELTA)) || defined(SKEW_CORRECTION)
+  /**
+   * Undo the bed leveling rotation and skew correction of a machine position
+   */
+  void plan_unapply_transform(float &x, float &y, float &z);
+#endif
 
 void plan_set_e_position(const float &e);
 
+#if defined(MPCTEMP) || defined(PID_ADD_EXTRUSION_RATE)
+  /**
+   * Filament feedrate (mm/s) of the given extruder for the heater feed-forward:
+   * of the move being executed, or averaged over the queued moves of the next
+   * lookahead seconds
+   */
+  float plan_e_speed(uint8_t extruder, float lookahead=0);
+#endif
+
 //===========================================================================
 //============================= public variables ============================
 //===========================================================================
@@ -133,6 +168,19 @@ extern float max_e_jerk;
 extern float mintravelfeedrate;
 extern unsigned long axis_steps_per_sqr_second[NUM_AXIS];
 
+#ifdef BACKLASH_COMPENSATION
+  extern float backlash_distance_mm[3];   // Play of each X, Y, Z motor. M425 XYZ
+  extern float backlash_correction;       // Fraction of the play to compensate (0.0-1.0). M425 F
+  extern float backlash_smoothing_mm;     // Distance to spread the correction over. M425 S
+
+  // Take up the play of an axis on the side it was homed towards
+  void plan_backlash_homed(const uint8_t axis, const int home_dir);
+#endif
+
+#ifdef SKEW_CORRECTION
+  extern float skew_factor_xy, skew_factor_xz, skew_factor_yz; // M852 I J K
+#endif
+
 #ifdef AUTOTEMP
   extern bool autotemp_enabled;
   extern float autotemp_max;
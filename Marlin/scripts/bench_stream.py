@@ -0,0 +1,208 @@
+#!/usr/bin/python3
+
+# Measure how fast a printer running Marlin takes a stream of G-code, so changes to parsing,
+# queueing or flow control can be compared against a recorded baseline. The file is streamed
+# as a host would and each "ok" is timed. The port is a printer, or with --printer a program
+# that prints the name of the pty it reads, such as Marlin/test/pty_printer: the firmware's
+# command queue and parsing built for Linux, with a stub planner. "make bench" in Marlin/test
+# runs it against the baselines there. Without a file, a generated print like a slicer's is
+# streamed, the same every time.
+#
+#   bench_stream.py /dev/ttyACM0 [print.gcode] [--no-checksum] [--rx-buffer 127]
+#                   [--save run.json] [--baseline run.json]
+#   bench_stream.py --printer './pty_printer --move-us 1500' [print.gcode] ...
+#
+# Lines go one at a time, or by counting characters with --rx-buffer. With ADVANCED_OK each
+# "ok" also gives the free planner blocks (P) and command lines (B), for the queue occupancy
+# and the planner starvations: the planner down to the move just added, or none, while there
+# are lines left to send. The "ok" only samples it, so --printer also records the printer's count.
+
+import argparse
+import collections
+import json
+import random
+import re
+import shlex
+import subprocess
+import sys
+import time
+
+from binary_gcode import Port, strip_line
+from stream_gcode import command, numbered
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100 * (len(values) - 1))))]
+
+
+def generated_print(count):
+    """Perimeters and infill in short G1 moves, with retractions, layer changes and the fan."""
+    rnd = random.Random(1)
+    lines = ['G21', 'G90', 'M82', 'M107', 'G28', 'G1 Z0.2 F9000', 'G92 E0']
+    x, y, z, e = 100.0, 100.0, 0.2, 0.0
+    while len(lines) < count:
+        if rnd.random() < 0.01:
+            z += 0.2
+            lines += ['G1 E%.5f F2400' % (e - 1), 'G1 Z%.3f F9000' % z, 'G1 E%.5f F2400' % e, 'G92 E0']
+            e = 0.0
+            if z < 1:
+                lines.append('M106 S%d' % int(255 * z))
+        x = min(max(x + rnd.uniform(-5, 5), 0), 200)
+        y = min(max(y + rnd.uniform(-5, 5), 0), 200)
+        e += rnd.uniform(0.01, 0.3)
+        if rnd.random() < 0.05:
+            lines.append('G1 X%.3f Y%.3f E%.5f F%d' % (x, y, e, rnd.choice((1800, 2400, 3600))))
+        else:
+            lines.append('G1 X%.3f Y%.3f E%.5f' % (x, y, e))
+    return lines
+
+
+def start_printer(cmd):
+    """Run the printer program, returning it and the path of its pty."""
+    printer = subprocess.Popen(shlex.split(cmd), stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                               universal_newlines=True)
+    return printer, printer.stdout.readline().strip()
+
+
+def bench(port, lines, checksums, rx_buffer, timeout, verbose=False):
+    port.write(b'\n')
+    command(port, 'M110 N0', timeout)
+
+    in_flight = collections.deque()  # (line number, bytes, time sent) not yet answered
+    queued = 0                       # Bytes of those
+    index = 0                        # Next line to send, numbered from 1
+    last_ok = 0                      # Line number of the last "ok N"
+    latencies, free_lines, free_blocks = [], [], []
+    planner_size = 0                 # Most free planner blocks seen: the planner is empty
+    planner_busy = False
+    sent_bytes = resends = starvations = 0
+    start = time.time()
+    while index < len(lines) or in_flight:
+        while index < len(lines):
+            data = numbered(index + 1, lines[index]) if checksums else (lines[index] + '\n').encode()
+            if in_flight and queued + len(data) > (rx_buffer or 0):
+                break
+            port.write(data)
+            in_flight.append((index + 1, len(data), time.time()))
+            queued += len(data)
+            sent_bytes += len(data)
+            index += 1
+
+        reply = port.readline(timeout)
+        now = time.time()
+        if reply is None:
+            if not checksums:
+                sys.exit('No answer in %g s' % timeout)
+            # Go on from the last line the printer took, as stream_gcode.py does
+            index = last_ok
+            in_flight.clear()
+            queued = 0
+            resends += 1
+        elif reply.startswith('ok'):
+            if in_flight:
+                _, size, sent = in_flight.popleft()
+                queued -= size
+                latencies.append(now - sent)
+            fields = dict(re.findall(r' ([NPB])(\d+)', reply))
+            if 'N' in fields:
+                last_ok = int(fields['N'])
+            if 'B' in fields:
+                free_lines.append(int(fields['B']))
+            if 'P' in fields:
+                free = int(fields['P'])
+                free_blocks.append(free)
+                planner_size = max(planner_size, free)
+                if free < planner_size - 1:
+                    planner_busy = True
+                elif planner_busy and index < len(lines):
+                    starvations += 1
+                    planner_busy = False
+        elif reply.startswith('Resend:'):
+            want = int(reply.split(':')[1])
+            if want <= index and all(number != want for number, _, _ in list(in_flight)[1:]):
+                index = want - 1
+                resends += 1
+        elif verbose:
+            print(reply)
+    elapsed = time.time() - start
+
+    result = {
+        'lines': len(lines),
+        'bytes': sent_bytes,
+        'seconds': elapsed,
+        'lines_per_s': len(lines) / elapsed,
+        'bytes_per_s': sent_bytes / elapsed,
+        'ok_ms_p50': percentile(latencies, 50) * 1000,
+        'ok_ms_p90': percentile(latencies, 90) * 1000,
+        'ok_ms_p99': percentile(latencies, 99) * 1000,
+        'ok_ms_max': max(latencies, default=0) * 1000,
+        'resends': resends,
+    }
+    if free_lines:
+        result['free_lines_min'] = min(free_lines)
+        result['free_lines_mean'] = sum(free_lines) / len(free_lines)
+    if free_blocks:
+        result['free_blocks_mean'] = sum(free_blocks) / len(free_blocks)
+        result['planner_starvations'] = starvations
+    return result
+
+
+def report(result, baseline=None):
+    for key, value in result.items():
+        line = '%-20s %12.2f' % (key, value) if isinstance(value, float) else '%-20s %12d' % (key, value)
+        if baseline and baseline.get(key):
+            line += '  %+7.1f%%' % ((value - baseline[key]) * 100 / baseline[key])
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure G-code streaming throughput and latency.')
+    parser.add_argument('--baud', type=int, default=250000)
+    parser.add_argument('--no-checksum', action='store_true', help='send lines without line numbers and checksums')
+    parser.add_argument('--rx-buffer', type=int, help='count characters against this receive buffer, instead of one line at a time')
+    parser.add_argument('--timeout', type=float, default=30, help='seconds without an answer before sending again')
+    parser.add_argument('--save', help='write the results to this JSON file')
+    parser.add_argument('--baseline', help='compare with results saved before')
+    parser.add_argument('--verbose', action='store_true', help='print the printer\'s other output')
+    parser.add_argument('--printer', help='run this printer program and stream to its pty, instead of a port')
+    parser.add_argument('--lines', type=int, default=5000, help='lines of the generated print')
+    parser.add_argument('files', nargs='*', metavar='[port] [gcode]')
+    args = parser.parse_args()
+
+    files = ([None] if args.printer else []) + args.files
+    if not 1 <= len(files) <= 2:
+        parser.error('give a port, or --printer, and optionally a G-code file')
+    if len(files) > 1:
+        with open(files[1]) as f:
+            lines = [line for line in map(strip_line, f) if line]
+    else:
+        lines = generated_print(args.lines)
+
+    printer = None
+    port = files[0]
+    if args.printer:
+        printer, port = start_printer(args.printer)
+    result = bench(Port(port, args.baud), lines, not args.no_checksum, args.rx_buffer,
+                   args.timeout, verbose=args.verbose)
+    if printer:
+        # The printer's own count of the times its planner ran empty
+        out = printer.communicate('')[0]
+        starved = re.search(r'^starved (\d+)$', out, re.M)
+        if starved:
+            result['printer_starvations'] = int(starved.group(1))
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    report(result, baseline)
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(result, f, indent=2)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,221 @@
+#!/usr/bin/python3
+
+# Stream a G-code file to Marlin in binary frames (BINARY_GCODE in Configuration_adv.h)
+# and report the throughput. Frames are described in binary_gcode.h.
+#
+#   binary_gcode.py /dev/ttyACM0 print.gcode [--baud 250000] [--window 4] [--rx-buffer 127]
+#   binary_gcode.py --encode print.gcode frames.bin
+#
+# With --encode the frames are only written to a file, to check the encoding or to feed
+# another program. No packages are needed beyond the standard library.
+# At most --window frames are in flight, and no more bytes than the printer's receive buffer,
+# from Cap:RX_BUFFER in M115 unless given, so none is lost while the command queue is full.
+# A file to save on the SD card with M28 is sent as text: until M29 the printer refuses other binary commands.
+
+import argparse
+import os
+import re
+import select
+import struct
+import sys
+import termios
+import time
+
+SYNC = 0xFE
+PAYLOAD_MAX = 96 - 5  # MAX_CMD_SIZE - 5
+
+FIELD_FLAG, FIELD_INT, FIELD_FLOAT, FIELD_TEXT = range(4)
+
+# Commands taking a file name or message, sent as text after the code
+TEXT_COMMANDS = {('M', 23), ('M', 28), ('M', 30), ('M', 32), ('M', 33), ('M', 117), ('M', 928)}
+
+COMMAND_RE = re.compile(r'\s*([GMT])\s*(\d+)\s*(.*)$', re.IGNORECASE)
+FIELD_RE = re.compile(r'([A-Za-z])\s*([-+]?(\d+\.?\d*|\.\d+))?')
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def strip_line(line):
+    line = line.split(';', 1)[0].strip()
+    if line[:1].upper() == 'N':  # Line number and checksum are the frame's job
+        line = re.sub(r'^[Nn]\s*-?\d+\s*', '', line)
+        line = line.split('*', 1)[0].strip()
+    return line
+
+
+def encode(line):
+    """The payload for one line of G-code, or None for a blank line."""
+    line = strip_line(line)
+    if not line:
+        return None
+    match = COMMAND_RE.match(line)
+    if not match:
+        raise ValueError('not a G, M or T command: ' + line)
+    letter, code, args = match.group(1).upper(), int(match.group(2)), match.group(3)
+    payload = bytearray(struct.pack('<cH', letter.encode(), code))
+    if (letter, code) in TEXT_COMMANDS:
+        if args:
+            payload.append(FIELD_TEXT << 5)
+            payload += args.encode()
+    else:
+        for field in FIELD_RE.finditer(args):
+            index = ord(field.group(1).upper()) - ord('A')
+            value = field.group(2)
+            if value is None:
+                payload.append(FIELD_FLAG << 5 | index)
+            elif '.' in value or not -2**31 <= int(value) < 2**31:
+                payload.append(FIELD_FLOAT << 5 | index)
+                payload += struct.pack('<f', float(value))
+            else:
+                payload.append(FIELD_INT << 5 | index)
+                payload += struct.pack('<i', int(value))
+    if len(payload) > PAYLOAD_MAX:
+        raise ValueError('command too long for a frame: ' + line)
+    return bytes(payload)
+
+
+def frame(seq, payload):
+    body = bytes([seq & 0xFF, len(payload)]) + payload
+    return bytes([SYNC]) + body + struct.pack('<H', crc16(body))
+
+
+def read_payloads(path):
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            try:
+                payload = encode(line)
+            except ValueError as e:
+                sys.exit('%s:%d: %s' % (path, number, e))
+            if payload is not None:
+                yield payload
+
+
+class Port:
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = attrs[1] = attrs[3] = 0               # Raw in, out and local
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        speed = getattr(termios, 'B%d' % baud, None)
+        if speed is not None:
+            attrs[4] = attrs[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.pending = b''
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def readline(self, timeout):
+        """The next line from the printer, or None after timeout seconds."""
+        end = time.time() + timeout
+        while b'\n' not in self.pending:
+            left = end - time.time()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None
+            self.pending += os.read(self.fd, 4096)
+        line, self.pending = self.pending.split(b'\n', 1)
+        return line.decode(errors='replace').strip()
+
+
+def command(port, line, timeout):
+    """Send a text command, returning its answer up to the "ok"."""
+    port.write(line.encode() + b'\n')
+    answer = []
+    while True:
+        reply = port.readline(timeout)
+        if reply is None or reply.startswith('ok'):
+            return answer
+        answer.append(reply)
+
+
+def stream(port, payloads, window, timeout, rx_buffer=None, verbose=False):
+    port.write(b'\n')
+    command(port, 'M110 N0', timeout)  # Frames start from sequence 0
+    if rx_buffer is None:
+        caps = dict(re.findall(r'Cap:(\w+):(\d+)', ' '.join(command(port, 'M115', timeout))))
+        if 'RX_BUFFER' not in caps:
+            sys.exit('No Cap:RX_BUFFER in M115. Give --rx-buffer.')
+        rx_buffer = int(caps['RX_BUFFER'])
+
+    payloads.append(b'')  # The empty frame returns to text
+    base = 0              # Oldest frame not acknowledged
+    sent = 0              # Next frame to send
+    in_flight = 0         # Bytes of the frames from base to sent
+    dropped = 0           # Bytes of frames dropped after an "rs:", maybe still in the receive buffer
+    sent_bytes = resends = 0
+    start = time.time()
+    while base < len(payloads):
+        while sent < len(payloads) and sent - base < window:
+            data = frame(sent, payloads[sent])
+            if in_flight + dropped + len(data) > rx_buffer and sent > base:
+                break
+            port.write(data)
+            in_flight += len(data)
+            sent_bytes += len(data)
+            sent += 1
+        line = port.readline(timeout)
+        if line is None:
+            # The last frame or its ack may be lost. Only the oldest goes again, as the
+            # printer may just be busy with the others still in its receive buffer.
+            data = frame(base, payloads[base])
+            port.write(data)
+            sent_bytes += len(data)
+            resends += 1
+        elif line.startswith('rs:'):
+            # Go back to the frame the printer expects. Those after it are dropped, but
+            # only once read, so they count against the buffer until the next ack.
+            ahead = (int(line[3:]) - base) & 0xFF
+            if ahead <= sent - base:
+                in_flight -= sum(len(p) + 5 for p in payloads[base:base + ahead])
+                base += ahead
+            dropped += in_flight
+            sent = base
+            in_flight = 0
+            resends += 1
+        elif line.startswith('ack:'):
+            ack = int(line[4:])
+            ahead = (ack - base) & 0xFF
+            if ahead < sent - base:
+                in_flight -= sum(len(p) + 5 for p in payloads[base:base + ahead + 1])
+                base += ahead + 1
+                dropped = 0
+        elif verbose and line != 'ok':
+            print(line)
+    elapsed = time.time() - start
+
+    commands = len(payloads) - 1
+    print('%d commands, %d bytes in %.2f s: %.0f commands/s, %.0f bytes/s, %d resends'
+          % (commands, sent_bytes, elapsed, commands / elapsed, sent_bytes / elapsed, resends))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stream G-code to Marlin in binary frames.')
+    parser.add_argument('--encode', action='store_true', help='write the frames to a file instead')
+    parser.add_argument('--baud', type=int, default=250000)
+    parser.add_argument('--window', type=int, default=4, help='frames in flight, as BINARY_GCODE_WINDOW')
+    parser.add_argument('--rx-buffer', type=int, help='receive buffer bytes, instead of asking M115')
+    parser.add_argument('--timeout', type=float, default=10, help='seconds without an answer before sending again')
+    parser.add_argument('--verbose', action='store_true', help='print the printer\'s other output')
+    parser.add_argument('source', help='serial port, or the G-code file with --encode')
+    parser.add_argument('target', help='G-code file, or the output file with --encode')
+    args = parser.parse_args()
+
+    if args.encode:
+        with open(args.target, 'wb') as out:
+            for seq, payload in enumerate(read_payloads(args.source)):
+                out.write(frame(seq, payload))
+    else:
+        stream(Port(args.source, args.baud), list(read_payloads(args.target)), args.window,
+               args.timeout, args.rx_buffer, verbose=args.verbose)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+
+# Stream a G-code file to Marlin as text by counting characters, and report the throughput.
+# Lines go out as long as those not yet answered with "ok" fit in the printer's serial
+# receive buffer, so the printer never waits on the host and nothing overruns. Build the
+# firmware with ADVANCED_OK, which reports the buffer size in M115 and the line number in
+# each "ok".
+#
+#   stream_gcode.py /dev/ttyACM0 print.gcode [--baud 250000] [--rx-buffer 127]
+
+import argparse
+import collections
+import re
+import sys
+import time
+
+from binary_gcode import Port, strip_line
+
+
+def numbered(number, line):
+    line = 'N%d %s' % (number, line)
+    checksum = 0
+    for byte in line.encode():
+        checksum ^= byte
+    return ('%s*%d\n' % (line, checksum)).encode()
+
+
+def command(port, line, timeout):
+    """Send a line and return the printer's answer, up to the "ok"."""
+    port.write(line.encode() + b'\n')
+    answer = []
+    while True:
+        reply = port.readline(timeout)
+        if reply is None or reply.startswith('ok'):
+            return answer
+        answer.append(reply)
+
+
+def stream(port, lines, rx_buffer, timeout, verbose=False):
+    port.write(b'\n')
+    command(port, 'M110 N0', timeout)
+    if rx_buffer is None:
+        caps = dict(re.findall(r'Cap:(\w+):(\d+)', ' '.join(command(port, 'M115', timeout))))
+        if 'RX_BUFFER' not in caps:
+            sys.exit('No Cap:RX_BUFFER in M115. Enable ADVANCED_OK or give --rx-buffer.')
+        rx_buffer = int(caps['RX_BUFFER'])
+
+    in_flight = collections.deque()  # (line number, bytes) sent and not yet answered
+    queued = 0                       # Bytes of those
+    index = 0                        # Next line to send, numbered from 1
+    last_ok = 0                      # Line number of the last "ok N"
+    sent_bytes = resends = 0
+    start = time.time()
+    while index < len(lines) or in_flight:
+        while index < len(lines):
+            data = numbered(index + 1, lines[index])
+            if queued + len(data) > rx_buffer and in_flight:
+                break
+            port.write(data)
+            in_flight.append((index + 1, len(data)))
+            queued += len(data)
+            sent_bytes += len(data)
+            index += 1
+
+        reply = port.readline(timeout)
+        if reply is None:
+            # A garbled line can go unanswered. Go on from the last one the printer took,
+            # and lines it already has are refused by number.
+            index = last_ok
+            in_flight.clear()
+            queued = 0
+            resends += 1
+        elif reply.startswith('ok'):
+            if in_flight:
+                queued -= in_flight.popleft()[1]
+            match = re.search(r' N(\d+)', reply)
+            if match:
+                last_ok = int(match.group(1))
+        elif reply.startswith('Resend:'):
+            # Every line in flight after the bad one is refused and asks again, so only
+            # go back when the line wanted hasn't been sent since. The oldest line in
+            # flight is the one being answered.
+            want = int(reply.split(':')[1])
+            if want <= index and all(number != want for number, _ in list(in_flight)[1:]):
+                index = want - 1
+                resends += 1
+        elif verbose:
+            print(reply)
+    elapsed = time.time() - start
+
+    print('%d lines, %d bytes in %.2f s: %.0f lines/s, %.0f bytes/s, %d resends'
+          % (len(lines), sent_bytes, elapsed, len(lines) / elapsed, sent_bytes / elapsed, resends))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stream G-code to Marlin by counting characters.')
+    parser.add_argument('--baud', type=int, default=250000)
+    parser.add_argument('--rx-buffer', type=int, help='receive buffer bytes, instead of asking M115')
+    parser.add_argument('--timeout', type=float, default=30, help='seconds without an answer before sending again')
+    parser.add_argument('--verbose', action='store_true', help='print the printer\'s other output')
+    parser.add_argument('port')
+    parser.add_argument('gcode')
+    args = parser.parse_args()
+
+    with open(args.gcode) as f:
+        lines = [line for line in map(strip_line, f) if line]
+    stream(Port(args.port, args.baud), lines, args.rx_buffer, args.timeout, verbose=args.verbose)
+
+
+if __name__ == '__main__':
+    main()
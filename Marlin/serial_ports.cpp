@@ -0,0 +1,15 @@
+/**
+ * serial_ports.cpp - Output to the serial port a command came from
+ */
+
+#include "Marlin.h"
+
+#ifdef SERIAL_PORT_2
+
+SerialPorts serial_ports;
+
+size_t SerialPorts::write(uint8_t c) {
+  return port ? SERIAL_PORT_2.write(c) : SERIAL_OUT_MAIN.write(c);
+}
+
+#endif // SERIAL_PORT_2
@@ -0,0 +1,23 @@
+/**
+ * serial_ports.h - Output to the serial port a command came from
+ *
+ * With SERIAL_PORT_2, SERIAL_OUT is a SerialPorts. Its output goes to the selected
+ * port: the one the command being handled came from, the main port otherwise.
+ */
+
+#ifndef SERIAL_PORTS_H
+#define SERIAL_PORTS_H
+
+#include <Print.h>
+
+class SerialPorts : public Print {
+  public:
+    virtual size_t write(uint8_t c);
+    using Print::write;
+
+    uint8_t port;               // 0 for the main port, 1 for SERIAL_PORT_2
+};
+
+extern SerialPorts serial_ports;
+
+#endif // SERIAL_PORTS_H
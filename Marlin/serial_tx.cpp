@@ -0,0 +1,91 @@
+/**
+ * serial_tx.cpp - Buffered serial output
+ */
+
+#include "Marlin.h"
+
+#ifdef SERIAL_TX_BUFFER_SIZE
+
+SerialTX serial_tx;
+
+#define TX_USED() ((uint16_t)(head - tail + SERIAL_TX_BUFFER_SIZE) % SERIAL_TX_BUFFER_SIZE)
+#define TX_FREE() (SERIAL_TX_BUFFER_SIZE - 1 - TX_USED())
+
+size_t SerialTX::write(uint8_t c) {
+  if (dropping) {
+    if (c != '\n') return 1;
+    dropping = false;
+    if (!line_started) { // Nothing of the line went out, so neither does its end
+      echo_line = false;
+      return 1;
+    }
+  }
+
+  // A line can always be ended, so a line cut short still ends
+  const uint16_t needed = c == '\n' ? 1 : 2;
+  for (;;) {
+    CRITICAL_SECTION_START;
+    bool room = TX_FREE() >= needed;
+    if (room) {
+      buffer[head] = c;
+      head = (head + 1) % SERIAL_TX_BUFFER_SIZE;
+    }
+    CRITICAL_SECTION_END;
+    if (room) break;
+
+    drain();
+    if (TX_FREE() >= needed) continue;
+
+    // Waiting needs the UART interrupt, so not from an interrupt or with them off
+    if (SERIAL_TX_OVERFLOW == TX_OVERFLOW_DROP || (SERIAL_TX_OVERFLOW == TX_OVERFLOW_DROP_ECHO && echo_line)
+        || __get_IPSR() || __get_PRIMASK()) {
+      dropped_lines++;
+      if (c != '\n') dropping = true; // Else an empty line, as the others keep room to end
+      return 1;
+    }
+  }
+
+  if (c == '\n')
+    echo_line = line_started = false;
+  else
+    line_started = true;
+  uint16_t used = TX_USED();
+  if (used > peak) peak = used;
+
+  drain();
+  return 1;
+}
+
+void SerialTX::drain() {
+  // A few bytes at a time, so interrupts are never held off for long
+  while (tail != head) {
+    uint8_t n = 0;
+    CRITICAL_SECTION_START;
+    for (int room = MYSERIAL.availableForWrite(); n < 16 && room > 0 && tail != head; n++, room--) {
+      MYSERIAL.write(buffer[tail]);
+      tail = (tail + 1) % SERIAL_TX_BUFFER_SIZE;
+    }
+    CRITICAL_SECTION_END;
+    if (!n) break;
+  }
+}
+
+void SerialTX::flush() {
+  while (tail != head) drain();
+}
+
+void SerialTX::report(const bool reset) {
+  uint16_t p = peak;
+  uint32_t d = dropped_lines;
+  if (reset) {
+    peak = 0;
+    dropped_lines = 0;
+  }
+  SERIAL_ECHO_START;
+  SERIAL_ECHOPAIR("TX buffer peak:", p);
+  SERIAL_ECHOPAIR("/", SERIAL_TX_BUFFER_SIZE);
+  SERIAL_ECHOPAIR(" dropped lines:", d);
+  SERIAL_EOL;
+}
+
+#endif // SERIAL_TX_BUFFER_SIZE
@@ -0,0 +1,43 @@
+/**
+ * serial_tx.h - Buffered serial output
+ *
+ * All output from the SERIAL_* macros goes to a ring of SERIAL_TX_BUFFER_SIZE bytes
+ * in RAM. It's moved on to MYSERIAL no faster than the UART's own interrupt-driven
+ * buffer takes it, so printing never waits for the line. What happens when the ring
+ * is full is up to SERIAL_TX_OVERFLOW. The statistics are reported with M802.
+ */
+
+#ifndef SERIAL_TX_H
+#define SERIAL_TX_H
+
+#include <Print.h>
+
+// What write() does when the ring is full
+#define TX_OVERFLOW_BLOCK     0 // Wait for room
+#define TX_OVERFLOW_DROP      1 // Drop the rest of the line
+#define TX_OVERFLOW_DROP_ECHO 2 // Drop the rest of an "echo:" line, wait for room for others
+
+class SerialTX : public Print {
+  public:
+    virtual size_t write(uint8_t c);
+    using Print::write;
+
+    void drain();               // Pass on as much as MYSERIAL takes without waiting
+    void flush();               // Wait until everything is passed on
+    void start_echo() { echo_line = true; }
+
+    void report(const bool reset);
+
+  private:
+    uint8_t buffer[SERIAL_TX_BUFFER_SIZE];
+    volatile uint16_t head, tail;
+    bool echo_line,             // The current line is an "echo:" line
+         line_started,          // Some of the current line is in the ring
+         dropping;              // The rest of the current line is dropped
+    uint16_t peak;              // Most bytes held at once
+    uint32_t dropped_lines;     // Lines cut short or dropped
+};
+
+extern SerialTX serial_tx;
+
+#endif // SERIAL_TX_H
@@ -29,6 +29,7 @@
 #include "ultralcd.h"
 #include "language.h"
 #include "cardreader.h"
+#include "isr_profiler.h"
 #if HAS_DIGIPOTSS
   #include <SPI.h>
 #endif
@@ -95,6 +96,19 @@ static bool check_endstops = true;
 volatile long count_position[NUM_AXIS] = { 0 };
 volatile signed char count_direction[NUM_AXIS] = { 1, 1, 1, 1 };
 
+#ifdef BACKLASH_COMPENSATION
+  // Correction steps in count_position from the blocks done since st_set_position, per motor
+  static long backlash_steps_done[3] = { 0 };
+  // Those of the current block, in proportion to its step events done
+  #define BACKLASH_STEPS_TAKEN(i) (current_block ? (long)((int64_t)current_block->backlash_steps[i] * step_events_completed / current_block->step_event_count) : 0)
+  // The current block is cut short: count only what it took, not its whole correction
+  #define BACKLASH_BLOCK_CUT() do{ for (uint8_t i = 0; i < 3; i++) backlash_steps_done[i] += BACKLASH_STEPS_TAKEN(i) - current_block->backlash_steps[i]; }while(0)
+  #define BACKLASH_BLOCK_DONE() do{ for (uint8_t i = 0; i < 3; i++) backlash_steps_done[i] += current_block->backlash_steps[i]; }while(0)
+#else
+  #define BACKLASH_BLOCK_CUT() do{}while(0)
+  #define BACKLASH_BLOCK_DONE() do{}while(0)
+#endif
+
 
 //===========================================================================
 //================================ functions ================================
@@ -233,6 +247,7 @@ inline void update_endstops() {
     if (TEST_ENDSTOP(_ENDSTOP(AXIS, MINMAX))  && (current_block->steps[_AXIS(AXIS)] > 0)) { \
       endstops_trigsteps[_AXIS(AXIS)] = count_position[_AXIS(AXIS)]; \
       _ENDSTOP_HIT(AXIS); \
+      BACKLASH_BLOCK_CUT(); \
       step_events_completed = current_block->step_event_count; \
     }
 
@@ -321,8 +336,10 @@ inline void update_endstops() {
             if (z_test && current_block->steps[Z_AXIS] > 0) { // z_test = Z_MIN || Z2_MIN
               endstops_trigsteps[Z_AXIS] = count_position[Z_AXIS];
               endstop_hit_bits |= BIT(Z_MIN);
-              if (!performing_homing || (z_test == 0x3))  //if not performing home or if both endstops were trigged during homing...
+              if (!performing_homing || (z_test == 0x3)) { //if not performing home or if both endstops were trigged during homing...
+                BACKLASH_BLOCK_CUT();
                 step_events_completed = current_block->step_event_count;
+              }
             }
           #else // !Z_DUAL_ENDSTOPS
 
@@ -357,8 +374,10 @@ inline void update_endstops() {
             if (z_test && current_block->steps[Z_AXIS] > 0) {  // t_test = Z_MAX || Z2_MAX
               endstops_trigsteps[Z_AXIS] = count_position[Z_AXIS];
               endstop_hit_bits |= BIT(Z_MIN);
-              if (!performing_homing || (z_test == 0x3))  //if not performing home or if both endstops were trigged during homing...
+              if (!performing_homing || (z_test == 0x3)) { //if not performing home or if both endstops were trigged during homing...
+                BACKLASH_BLOCK_CUT();
                 step_events_completed = current_block->step_event_count;
+              }
             }
 
           #else // !Z_DUAL_ENDSTOPS
@@ -486,6 +505,9 @@ void HAL_timer_stepper_count(uint32_t count) {
 
   uint32_t counter_value = stepperChannel->TC_CV + 42;  // we need time for other stuff!
   //if(count < 105) count = 105;
+  #ifdef ISR_PROFILING
+    if (counter_value > count) isr_profile_step.late++; // the requested step period is already over
+  #endif
   stepperChannel->TC_RC = (counter_value <= count) ? count : counter_value;
 }
 
@@ -528,6 +550,10 @@ FORCE_INLINE void trapezoid_generator_reset() {
 
 HAL_STEP_TIMER_ISR {
 
+  #ifdef ISR_PROFILING
+    IsrProfileScope isr_profile_scope(isr_profile_step);
+  #endif
+
   //STEP_TIMER_COUNTER->TC_CHANNEL[STEP_TIMER_CHANNEL].TC_SR;
   stepperChannel->TC_SR;
   //stepperChannel->TC_RC = 1000000;
@@ -714,6 +740,7 @@ HAL_STEP_TIMER_ISR {
 
     // If current block is finished, reset pointer
     if (step_events_completed >= current_block->step_event_count) {
+      BACKLASH_BLOCK_DONE();
       current_block = NULL;
       plan_discard_current_block();
     }
@@ -1014,10 +1041,25 @@ void st_synchronize() { while (blocks_queued()) idle(); }
 
 void st_set_position(const long &x, const long &y, const long &z, const long &e) {
   CRITICAL_SECTION_START;
-  count_position[X_AXIS] = x;
-  count_position[Y_AXIS] = y;
-  count_position[Z_AXIS] = z;
+  #ifdef COREXY
+    // The stepper ISR counts motor steps, A = X + Y and B = X - Y
+    count_position[A_AXIS] = x + y;
+    count_position[B_AXIS] = x - y;
+    count_position[Z_AXIS] = z;
+  #elif defined(COREXZ)
+    // A = X + Z and C = X - Z
+    count_position[A_AXIS] = x + z;
+    count_position[Y_AXIS] = y;
+    count_position[C_AXIS] = x - z;
+  #else
+    count_position[X_AXIS] = x;
+    count_position[Y_AXIS] = y;
+    count_position[Z_AXIS] = z;
+  #endif
   count_position[E_AXIS] = e;
+  #ifdef BACKLASH_COMPENSATION
+    for (uint8_t i = 0; i < 3; i++) backlash_steps_done[i] = -BACKLASH_STEPS_TAKEN(i);
+  #endif
   CRITICAL_SECTION_END;
 }
 
@@ -1031,11 +1073,49 @@ long st_get_position(uint8_t axis) {
   long count_pos;
   CRITICAL_SECTION_START;
   count_pos = count_position[axis];
+  #ifdef BACKLASH_COMPENSATION
+    // Report the commanded position, not the one including the play taken up
+    if (axis < 3) count_pos -= backlash_steps_done[axis] + BACKLASH_STEPS_TAKEN(axis);
+  #endif
   CRITICAL_SECTION_END;
   return count_pos;
 }
 
-float st_get_position_mm(AxisEnum axis) { return st_get_position(axis) / axis_steps_per_unit[axis]; }
+void st_get_positions(long count_pos[NUM_AXIS]) {
+  CRITICAL_SECTION_START;
+  for (uint8_t i = 0; i < NUM_AXIS; i++) count_pos[i] = count_position[i];
+  #ifdef BACKLASH_COMPENSATION
+    for (uint8_t i = 0; i < 3; i++) count_pos[i] -= backlash_steps_done[i] + BACKLASH_STEPS_TAKEN(i);
+  #endif
+  CRITICAL_SECTION_END;
+}
+
+void st_get_positions_mm(float pos[NUM_AXIS]) {
+  long count_pos[NUM_AXIS];
+  st_get_positions(count_pos);
+  #ifdef COREXY
+    pos[X_AXIS] = (count_pos[A_AXIS] + count_pos[B_AXIS]) / 2.0 / axis_steps_per_unit[X_AXIS];
+    pos[Y_AXIS] = (count_pos[A_AXIS] - count_pos[B_AXIS]) / 2.0 / axis_steps_per_unit[Y_AXIS];
+    pos[Z_AXIS] = count_pos[Z_AXIS] / axis_steps_per_unit[Z_AXIS];
+  #elif defined(COREXZ)
+    pos[X_AXIS] = (count_pos[A_AXIS] + count_pos[C_AXIS]) / 2.0 / axis_steps_per_unit[X_AXIS];
+    pos[Y_AXIS] = count_pos[Y_AXIS] / axis_steps_per_unit[Y_AXIS];
+    pos[Z_AXIS] = (count_pos[A_AXIS] - count_pos[C_AXIS]) / 2.0 / axis_steps_per_unit[Z_AXIS];
+  #else
+    for (uint8_t i = 0; i < 3; i++) pos[i] = count_pos[i] / axis_steps_per_unit[i];
+  #endif
+  pos[E_AXIS] = count_pos[E_AXIS] / axis_steps_per_unit[E_AXIS];
+}
+
+float st_get_position_mm(AxisEnum axis) {
+  #if defined(COREXY) || defined(COREXZ)
+    float pos[NUM_AXIS];
+    st_get_positions_mm(pos);
+    return pos[axis];
+  #else
+    return st_get_position(axis) / axis_steps_per_unit[axis];
+  #endif
+}
 
 void finishAndDisableSteppers() {
   st_synchronize();
@@ -1045,6 +1125,9 @@ void finishAndDisableSteppers() {
 void quickStop() {
   cleaning_buffer_counter = 5000;
   DISABLE_STEPPER_DRIVER_INTERRUPT();
+  #ifdef BACKLASH_COMPENSATION
+    if (current_block) for (uint8_t i = 0; i < 3; i++) backlash_steps_done[i] += BACKLASH_STEPS_TAKEN(i);
+  #endif
   while (blocks_queued()) plan_discard_current_block();
   current_block = NULL;
   ENABLE_STEPPER_DRIVER_INTERRUPT();
@@ -66,9 +66,17 @@ void st_set_e_position(const long &e);
 // Get current position in steps
 long st_get_position(uint8_t axis);
 
+// Get the step counts of all axes at the same instant, without waiting for moves to finish
+void st_get_positions(long count_pos[NUM_AXIS]);
+
 // Get current position in mm
 float st_get_position_mm(AxisEnum axis);
 
+// Get the position of all axes in mm from one snapshot of the step counts.
+// COREXY and COREXZ motor counts are converted back to the head position,
+// DELTA and SCARA positions are left in tower / arm space.
+void st_get_positions_mm(float pos[NUM_AXIS]);
+
 // The stepper subsystem goes to sleep when it runs out of things to execute. Call this
 // to notify the subsystem that it is time to go to work.
 void st_wake_up();
@@ -23,6 +23,12 @@
 #include "temperature.h"
 #include "watchdog.h"
 #include "language.h"
+#include "isr_profiler.h"
+#include "thermistor_lookup.h"
+#include "heater_control.h"
+#ifdef HEATER_SIMULATION
+  #include "heater_sim.h"
+#endif
 
 #include "Sd2PinMap.h"
 
@@ -34,7 +40,7 @@
   #define K2 (1.0-K1)
 #endif
 
-#if defined(PIDTEMPBED) || defined(PIDTEMP)
+#if defined(PIDTEMPBED) || defined(PIDTEMP) || defined(MPCTEMP)
   #define PID_dT (((OVERSAMPLENR + 2) * 12.0)/ TEMP_FREQUENCY)
   #define RECI_PID_dT ( 1 / PID_dT )
 #endif
@@ -54,6 +60,10 @@ float current_temperature_bed = 0.0;
   float redundant_temperature = 0.0;
 #endif
 
+#ifdef MPCTEMP
+  mpc_t mpc[EXTRUDERS];
+#endif
+
 #ifdef PIDTEMPBED
   float bedKp=DEFAULT_bedKp;
   float bedKi=(DEFAULT_bedKi*PID_dT);
@@ -68,6 +78,7 @@ unsigned char soft_pwm_bed;
   
 #ifdef BABYSTEPPING
   volatile int babystepsTodo[3] = { 0 };
+  long babystepsTotal[3] = { 0 };
 #endif
 
 #ifdef FILAMENT_SENSOR
@@ -75,7 +86,6 @@ unsigned char soft_pwm_bed;
 #endif  
 
 #if defined(THERMAL_PROTECTION_HOTENDS) || defined(THERMAL_PROTECTION_BED)
-  enum TRState { TRReset, TRInactive, TRFirstHeating, TRStable, TRRunaway };
   void thermal_runaway_protection(TRState *state, millis_t *timer, float temperature, float target_temperature, int heater_id, int period_seconds, int hysteresis_degc);
   #ifdef THERMAL_PROTECTION_HOTENDS
     static TRState thermal_runaway_state_machine[4] = { TRReset, TRReset, TRReset, TRReset };
@@ -95,16 +105,10 @@ static volatile bool temp_meas_ready = false;
 
 #ifdef PIDTEMP
   //static cannot be external:
-  static float temp_iState[EXTRUDERS] = { 0 };
-  static float temp_dState[EXTRUDERS] = { 0 };
-  static float pTerm[EXTRUDERS];
-  static float iTerm[EXTRUDERS];
-  static float dTerm[EXTRUDERS];
-  //int output;
-  static float pid_error[EXTRUDERS];
-  static float temp_iState_min[EXTRUDERS];
-  static float temp_iState_max[EXTRUDERS];
-  static bool pid_reset[EXTRUDERS];
+  static pid_state_t pid_state[EXTRUDERS];
+  #ifdef PID_ADD_EXTRUSION_RATE
+    static float cTerm[EXTRUDERS];
+  #endif
 #endif //PIDTEMP
 #ifdef PIDTEMPBED
   //static cannot be external:
@@ -120,8 +124,32 @@ static volatile bool temp_meas_ready = false;
 #else //PIDTEMPBED
   static millis_t  next_bed_check_ms;
 #endif //PIDTEMPBED
+#ifdef MPCTEMP
+  // Modeled temperatures of each hotend
+  static bool mpc_model_ready[EXTRUDERS] = { false };
+  static float mpc_block_temp[EXTRUDERS];
+  static float mpc_sensor_temp[EXTRUDERS];
+  static float mpc_ambient_temp[EXTRUDERS];
+#endif
   static unsigned char soft_pwm[EXTRUDERS];
 
+#ifdef HEATERS_HARDWARE_PWM
+  // Heaters driven by a PWM channel instead of soft PWM, the bed after the hotends if HEATER_BED_HARDWARE_PWM
+  static bool heater_on_pwm[EXTRUDERS + 1] = { false };
+  static int heater_pwm_pin[EXTRUDERS + 1];
+  static uint16_t heater_pwm_duty[EXTRUDERS + 1];
+  #define HEATER_PWM_INDEX(heater) ((heater) < 0 ? EXTRUDERS : (heater))
+  #ifdef HEATER_SIMULATION
+    #define HEATER_PWM_INIT(i, pin) // The simulated heaters stay on soft PWM, the pins off
+  #elif defined(INVERTED_MOSFET_CHANNELS)
+    #define HEATER_PWM_INIT(i, pin) { heater_pwm_pin[i] = pin; heater_on_pwm[i] = HAL_pwm_init(pin, HEATER_PWM_FREQUENCY, true); }
+  #else
+    #define HEATER_PWM_INIT(i, pin) { heater_pwm_pin[i] = pin; heater_on_pwm[i] = HAL_pwm_init(pin, HEATER_PWM_FREQUENCY); }
+  #endif
+#else
+  #define HEATER_PWM_INIT(i, pin)
+#endif
+
 #ifdef FAN_SOFT_PWM
   static unsigned char soft_pwm_fan;
 #endif
@@ -167,6 +195,18 @@ static int bed_minttemp_raw = HEATER_BED_RAW_LO_TEMP;
   static uint8_t heater_ttbllen_map[EXTRUDERS] = ARRAY_BY_EXTRUDERS( HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN, HEATER_2_TEMPTABLE_LEN, HEATER_3_TEMPTABLE_LEN );
 #endif
 
+// Slope of each thermistor table segment in °C per raw unit, filled by init_temptable_slopes()
+#ifdef BEDTEMPTABLE
+  #define BEDTEMPTABLE_SLOPES BEDTEMPTABLE_LEN
+#else
+  #define BEDTEMPTABLE_SLOPES 0
+#endif
+static float temptable_slopes[HEATER_0_TEMPTABLE_LEN + HEATER_1_TEMPTABLE_LEN + HEATER_2_TEMPTABLE_LEN + HEATER_3_TEMPTABLE_LEN + BEDTEMPTABLE_SLOPES + 1];
+static float *heater_ttbl_slope[COUNT(heater_ttbl_map)];
+#ifdef BED_USES_THERMISTOR
+  static float *bed_ttbl_slope;
+#endif
+
 static float analog2temp(int raw, uint8_t e);
 static float analog2tempBed(int raw);
 static void updateTemperaturesFromRawValues();
@@ -192,172 +232,237 @@ static void updateTemperaturesFromRawValues();
 //================================ Functions ================================
 //===========================================================================
 
-void PID_autotune(float temp, int extruder, int ncycles) {
-  float input = 0.0;
-  int cycles = 0;
-  bool heating = true;
-
-  millis_t temp_ms = millis(), t1 = temp_ms, t2 = temp_ms;
-  long t_high = 0, t_low = 0;
-
-  long bias, d;
-  float Ku, Tu;
-  float Kp, Ki, Kd;
-  float max = 0, min = 10000;
-
-  #if HAS_AUTO_FAN
-    millis_t next_auto_fan_check_ms = temp_ms + 2500;
+/**
+ * Set the output of a hotend, or the bed for heater -1, from 0 to 255.
+ * A heater on a PWM channel gets the full resolution of the channel,
+ * soft PWM keeps the upper 7 bits for the temperature ISR.
+ */
+static void set_heater_output(int heater, float output) {
+  #ifdef HEATERS_HARDWARE_PWM
+    const int i = HEATER_PWM_INDEX(heater);
+    if (heater_on_pwm[i]) {
+      heater_pwm_duty[i] = output * HAL_PWM_MAX / 255 + 0.5;
+      HAL_pwm_write(heater_pwm_pin[i], heater_pwm_duty[i]);
+      output = 0; // Nothing for the ISR to switch
+    }
   #endif
+  if (heater < 0)
+    soft_pwm_bed = (int)output >> 1;
+  else
+    soft_pwm[heater] = (int)output >> 1;
+}
 
-  if (extruder >= EXTRUDERS
-    #if !HAS_TEMP_BED
-       || extruder < 0
+#if defined(MPCTEMP) || defined(HEATER_SIMULATION)
+  // Fraction of the full power that a heater is getting
+  static float heater_duty_fraction(int heater) {
+    #ifdef HEATERS_HARDWARE_PWM
+      const int i = HEATER_PWM_INDEX(heater);
+      if (heater_on_pwm[i]) return heater_pwm_duty[i] * (1.0 / HAL_PWM_MAX);
     #endif
-  ) {
-    SERIAL_ECHOLN(MSG_PID_BAD_EXTRUDER_NUM);
-    return;
+    return getHeaterPower(heater) / 128.0;
   }
-  
-  SERIAL_ECHOLN(MSG_PID_AUTOTUNE_START);
+#endif
+
+/**
+ * M303 relay autotune
+ *
+ * The heater switches between bias + d and bias - d whenever the temperature
+ * leaves a band of PID_AUTOTUNE_HYSTERESIS around the target, and the bias
+ * moves to make the heating and cooling times equal. The peaks of each cycle
+ * are timed to a fraction of a sample with a parabola through the samples
+ * around them, so the period holds up at the slow rate of a bed. Ku and Tu
+ * follow from the relay and the oscillation, and the tuning stops once two
+ * cycles in a row agree with the one before, or after the given count.
+ *
+ * PID_autotune() only starts the tuning. It runs from manage_heater() at each
+ * temperature sample, so commands and the LCD stay alive in the meantime.
+ */
+#define MAX_OVERSHOOT_PID_AUTOTUNE 20
 
-  disable_all_heaters(); // switch off all heaters.
+typedef struct {
+  bool active, heating;
+  int heater;                   // -1 for the bed
+  float temp;
+  int cycles, ncycles, converged;
+  long bias, d;
+  float sample[3];              // The last three samples, for the peak fit
+  millis_t sample_ms[3];
+  float max, min;               // Peaks of this cycle and their times
+  millis_t max_ms, min_ms, last_max_ms, last_min_ms;
+  millis_t high_ms, low_ms;     // Times of the last switches to high and to low output
+  float Ku, Tu, Kp, Ki, Kd;
+  millis_t next_report_ms;
+} pid_autotune_t;
+
+static pid_autotune_t autotune = { false };
+
+#define AUTOTUNING(heater) (autotune.active && autotune.heater == (heater))
+// The target that thermal protection watches, the tuning temperature while autotuning
+#define PROTECTED_TARGET(heater, target) (AUTOTUNING(heater) ? autotune.temp : (target))
+
+static void pid_autotune_stop() {
+  autotune.active = false;
+  set_heater_output(autotune.heater, 0);
+}
 
-  if (extruder < 0)
-    soft_pwm_bed = bias = d = MAX_BED_POWER / 2;
-  else
-    soft_pwm[extruder] = bias = d = PID_MAX / 2;
+// Vertex of the parabola through the last three samples
+static void pid_autotune_peak(float &value, millis_t &ms) {
+  const float *y = autotune.sample;
+  const float curvature = y[0] - 2 * y[1] + y[2];
+  const float offset = curvature ? 0.5 * (y[0] - y[2]) / curvature : 0; // In samples from the middle one
+  value = y[1] - 0.25 * (y[0] - y[2]) * offset;
+  ms = autotune.sample_ms[1] + (long)(offset * (long)(autotune.sample_ms[2] - autotune.sample_ms[0]) / 2);
+}
 
-  // PID Tuning loop
-  for (;;) {
+static void pid_autotune_update() {
+  pid_autotune_t &at = autotune;
+  const float input = at.heater < 0 ? current_temperature_bed : current_temperature[at.heater];
+  const millis_t ms = millis();
 
-    millis_t ms = millis();
+  if (input > at.temp + MAX_OVERSHOOT_PID_AUTOTUNE) {
+    SERIAL_PROTOCOLLNPGM(MSG_PID_TEMP_TOO_HIGH);
+    pid_autotune_stop();
+    return;
+  }
 
-    if (temp_meas_ready) { // temp sample ready
-      updateTemperaturesFromRawValues();
+  if (ms >= at.next_report_ms) {
+    if (at.heater < 0)
+      SERIAL_PROTOCOLPGM(MSG_B);
+    else
+      SERIAL_PROTOCOLPGM(MSG_T);
+    SERIAL_PROTOCOL(input);
+    SERIAL_PROTOCOLPGM(MSG_AT);
+    SERIAL_PROTOCOLLN(getHeaterPower(at.heater));
+    at.next_report_ms = ms + 2000;
+  }
 
-      input = (extruder<0)?current_temperature_bed:current_temperature[extruder];
+  if (((ms - at.low_ms) + (ms - at.high_ms)) > (10L*60L*1000L*2L)) {
+    SERIAL_PROTOCOLLNPGM(MSG_PID_TIMEOUT);
+    pid_autotune_stop();
+    return;
+  }
 
-      max = max(max, input);
-      min = min(min, input);
+  for (uint8_t i = 0; i < 2; i++) {
+    at.sample[i] = at.sample[i + 1];
+    at.sample_ms[i] = at.sample_ms[i + 1];
+  }
+  at.sample[2] = input;
+  at.sample_ms[2] = ms;
 
-      #if HAS_AUTO_FAN
-        if (ms > next_auto_fan_check_ms) {
-          checkExtruderAutoFans();
-          next_auto_fan_check_ms = ms + 2500;
-        }
-      #endif
+  // The minimum comes after the switch to high output, the maximum after the switch to low
+  const float *y = at.sample;
+  if (at.heating) {
+    if (y[1] <= y[0] && y[1] < y[2] && y[1] <= at.min) pid_autotune_peak(at.min, at.min_ms);
+  }
+  else {
+    if (y[1] >= y[0] && y[1] > y[2] && y[1] >= at.max) pid_autotune_peak(at.max, at.max_ms);
+  }
 
-      if (heating && input > temp) {
-        if (ms > t2 + 5000) {
-          heating = false;
-          if (extruder < 0)
-            soft_pwm_bed = (bias - d) >> 1;
-          else
-            soft_pwm[extruder] = (bias - d) >> 1;
-          t1 = ms;
-          t_high = t1 - t2;
-          max = temp;
-        }
+  if (at.heating && input > at.temp + PID_AUTOTUNE_HYSTERESIS) {
+    at.heating = false;
+    at.low_ms = ms;
+    at.max = input;
+    at.max_ms = ms;
+    set_heater_output(at.heater, at.bias - at.d);
+  }
+  else if (!at.heating && input < at.temp - PID_AUTOTUNE_HYSTERESIS) {
+    at.heating = true;
+    const long t_high = at.low_ms - at.high_ms, t_low = ms - at.low_ms;
+    at.high_ms = ms;
+
+    if (at.cycles > 0) {
+      const long max_pow = at.heater < 0 ? MAX_BED_POWER : PID_MAX;
+      at.bias += (at.d * (t_high - t_low)) / (t_low + t_high);
+      at.bias = constrain(at.bias, 20, max_pow - 20);
+      at.d = (at.bias > max_pow / 2) ? max_pow - 1 - at.bias : at.bias;
+
+      SERIAL_PROTOCOLPGM(MSG_BIAS); SERIAL_PROTOCOL(at.bias);
+      SERIAL_PROTOCOLPGM(MSG_D);    SERIAL_PROTOCOL(at.d);
+      SERIAL_PROTOCOLPGM(MSG_T_MIN);  SERIAL_PROTOCOL(at.min);
+      SERIAL_PROTOCOLPGM(MSG_T_MAX);  SERIAL_PROTOCOLLN(at.max);
+
+      // The first minimum is the start temperature, so the period needs three cycles
+      if (at.cycles > 2) {
+        const float last_Ku = at.Ku, last_Tu = at.Tu,
+                    a = max((at.max - at.min) / 2, 1.1 * PID_AUTOTUNE_HYSTERESIS);
+        // Describing function of a relay with hysteresis
+        at.Ku = (4.0 * at.d) / (M_PI * sqrt(a * a - PID_AUTOTUNE_HYSTERESIS * PID_AUTOTUNE_HYSTERESIS));
+        at.Tu = ((at.max_ms - at.last_max_ms) + (at.min_ms - at.last_min_ms)) / 2000.0;
+        SERIAL_PROTOCOLPGM(MSG_KU); SERIAL_PROTOCOL(at.Ku);
+        SERIAL_PROTOCOLPGM(MSG_TU); SERIAL_PROTOCOLLN(at.Tu);
+        at.Kp = 0.6 * at.Ku;
+        at.Ki = 2 * at.Kp / at.Tu;
+        at.Kd = at.Kp * at.Tu / 8;
+        SERIAL_PROTOCOLLNPGM(MSG_CLASSIC_PID);
+        SERIAL_PROTOCOLPGM(MSG_KP); SERIAL_PROTOCOLLN(at.Kp);
+        SERIAL_PROTOCOLPGM(MSG_KI); SERIAL_PROTOCOLLN(at.Ki);
+        SERIAL_PROTOCOLPGM(MSG_KD); SERIAL_PROTOCOLLN(at.Kd);
+
+        if (fabs(at.Ku - last_Ku) <= PID_AUTOTUNE_CONVERGENCE * at.Ku && fabs(at.Tu - last_Tu) <= PID_AUTOTUNE_CONVERGENCE * at.Tu)
+          at.converged++;
+        else
+          at.converged = 0;
       }
-
-      if (!heating && input < temp) {
-        if (ms > t1 + 5000) {
-          heating = true;
-          t2 = ms;
-          t_low = t2 - t1;
-          if (cycles > 0) {
-            long max_pow = extruder < 0 ? MAX_BED_POWER : PID_MAX;
-            bias += (d*(t_high - t_low))/(t_low + t_high);
-            bias = constrain(bias, 20, max_pow - 20);
-            d = (bias > max_pow / 2) ? max_pow - 1 - bias : bias;
-
-            SERIAL_PROTOCOLPGM(MSG_BIAS); SERIAL_PROTOCOL(bias);
-            SERIAL_PROTOCOLPGM(MSG_D);    SERIAL_PROTOCOL(d);
-            SERIAL_PROTOCOLPGM(MSG_T_MIN);  SERIAL_PROTOCOL(min);
-            SERIAL_PROTOCOLPGM(MSG_T_MAX);  SERIAL_PROTOCOLLN(max);
-            if (cycles > 2) {
-              Ku = (4.0 * d) / (3.14159265 * (max - min) / 2.0);
-              Tu = ((float)(t_low + t_high) / 1000.0);
-              SERIAL_PROTOCOLPGM(MSG_KU); SERIAL_PROTOCOL(Ku);
-              SERIAL_PROTOCOLPGM(MSG_TU); SERIAL_PROTOCOLLN(Tu);
-              Kp = 0.6 * Ku;
-              Ki = 2 * Kp / Tu;
-              Kd = Kp * Tu / 8;
-              SERIAL_PROTOCOLLNPGM(MSG_CLASSIC_PID);
-              SERIAL_PROTOCOLPGM(MSG_KP); SERIAL_PROTOCOLLN(Kp);
-              SERIAL_PROTOCOLPGM(MSG_KI); SERIAL_PROTOCOLLN(Ki);
-              SERIAL_PROTOCOLPGM(MSG_KD); SERIAL_PROTOCOLLN(Kd);
-              /*
-              Kp = 0.33*Ku;
-              Ki = Kp/Tu;
-              Kd = Kp*Tu/3;
-              SERIAL_PROTOCOLLNPGM(" Some overshoot ");
-              SERIAL_PROTOCOLPGM(" Kp: "); SERIAL_PROTOCOLLN(Kp);
-              SERIAL_PROTOCOLPGM(" Ki: "); SERIAL_PROTOCOLLN(Ki);
-              SERIAL_PROTOCOLPGM(" Kd: "); SERIAL_PROTOCOLLN(Kd);
-              Kp = 0.2*Ku;
-              Ki = 2*Kp/Tu;
-              Kd = Kp*Tu/3;
-              SERIAL_PROTOCOLLNPGM(" No overshoot ");
-              SERIAL_PROTOCOLPGM(" Kp: "); SERIAL_PROTOCOLLN(Kp);
-              SERIAL_PROTOCOLPGM(" Ki: "); SERIAL_PROTOCOLLN(Ki);
-              SERIAL_PROTOCOLPGM(" Kd: "); SERIAL_PROTOCOLLN(Kd);
-              */
-            }
-          }
-          if (extruder < 0)
-            soft_pwm_bed = (bias + d) >> 1;
-          else
-            soft_pwm[extruder] = (bias + d) >> 1;
-          cycles++;
-          min = temp;
-        }
-      } 
     }
-    #define MAX_OVERSHOOT_PID_AUTOTUNE 20
-    if (input > temp + MAX_OVERSHOOT_PID_AUTOTUNE) {
-      SERIAL_PROTOCOLLNPGM(MSG_PID_TEMP_TOO_HIGH);
-      return;
-    }
-    // Every 2 seconds...
-    if (ms > temp_ms + 2000) {
-      int p;
-      if (extruder < 0) {
-        p = soft_pwm_bed;
-        SERIAL_PROTOCOLPGM(MSG_B);
-      }
-      else {
-        p = soft_pwm[extruder];
-        SERIAL_PROTOCOLPGM(MSG_T);
-      }
 
-      SERIAL_PROTOCOL(input);
-      SERIAL_PROTOCOLPGM(MSG_AT);
-      SERIAL_PROTOCOLLN(p);
+    at.last_max_ms = at.max_ms;
+    at.last_min_ms = at.min_ms;
+    at.min = input;
+    at.min_ms = ms;
+    set_heater_output(at.heater, at.bias + at.d);
+    at.cycles++;
 
-      temp_ms = ms;
-    } // every 2 seconds
-    // Over 2 minutes?
-    if (((ms - t1) + (ms - t2)) > (10L*60L*1000L*2L)) {
-      SERIAL_PROTOCOLLNPGM(MSG_PID_TIMEOUT);
-      return;
-    }
-    if (cycles > ncycles) {
+    if (at.converged >= 2 || at.cycles > at.ncycles) {
       SERIAL_PROTOCOLLNPGM(MSG_PID_AUTOTUNE_FINISHED);
-      const char *estring = extruder < 0 ? "bed" : "";
-      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Kp "); SERIAL_PROTOCOLLN(Kp);
-      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Ki "); SERIAL_PROTOCOLLN(Ki);
-      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Kd "); SERIAL_PROTOCOLLN(Kd);
-      return;
+      const char *estring = at.heater < 0 ? "bed" : "";
+      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Kp "); SERIAL_PROTOCOLLN(at.Kp);
+      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Ki "); SERIAL_PROTOCOLLN(at.Ki);
+      SERIAL_PROTOCOLPGM("#define  DEFAULT_"); SERIAL_PROTOCOL(estring); SERIAL_PROTOCOLPGM("Kd "); SERIAL_PROTOCOLLN(at.Kd);
+      pid_autotune_stop();
     }
-    lcd_update();
   }
 }
 
+void PID_autotune(float temp, int extruder, int ncycles) {
+  if (extruder >= EXTRUDERS
+    #if !HAS_TEMP_BED
+       || extruder < 0
+    #endif
+  ) {
+    SERIAL_ECHOLN(MSG_PID_BAD_EXTRUDER_NUM);
+    return;
+  }
+
+  SERIAL_ECHOLN(MSG_PID_AUTOTUNE_START);
+
+  disable_all_heaters(); // switch off all heaters, and any tuning in progress
+
+  pid_autotune_t &at = autotune;
+  const float input = extruder < 0 ? current_temperature_bed : current_temperature[extruder];
+  const millis_t ms = millis();
+  at.heater = extruder;
+  at.temp = temp;
+  at.cycles = 0;
+  at.ncycles = ncycles;
+  at.converged = 0;
+  at.heating = true;
+  at.bias = at.d = (extruder < 0 ? MAX_BED_POWER : PID_MAX) / 2;
+  for (uint8_t i = 0; i < 3; i++) {
+    at.sample[i] = input;
+    at.sample_ms[i] = ms;
+  }
+  at.max = at.min = input;
+  at.max_ms = at.min_ms = at.last_max_ms = at.last_min_ms = at.high_ms = at.low_ms = ms;
+  at.Ku = at.Tu = at.Kp = at.Ki = at.Kd = 0;
+  at.next_report_ms = ms + 2000;
+  set_heater_output(extruder, at.bias + at.d);
+  at.active = true;
+}
+
 void updatePID() {
   #ifdef PIDTEMP
     for (int e = 0; e < EXTRUDERS; e++) {
-      temp_iState_max[e] = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki,e);
+      pid_state[e].iState_max = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki,e);
     }
   #endif
   #ifdef PIDTEMPBED
@@ -366,6 +471,10 @@ void updatePID() {
 }
 
 int getHeaterPower(int heater) {
+  #ifdef HEATERS_HARDWARE_PWM
+    const int i = HEATER_PWM_INDEX(heater);
+    if (heater_on_pwm[i]) return heater_pwm_duty[i] >> (HAL_PWM_RESOLUTION - 7);
+  #endif
   return heater < 0 ? soft_pwm_bed : soft_pwm[heater];
 }
 
@@ -476,37 +585,14 @@ float get_pid_output(int e) {
   float pid_output;
   #ifdef PIDTEMP
     #ifndef PID_OPENLOOP
-      pid_error[e] = target_temperature[e] - current_temperature[e];
-      dTerm[e] = K2 * PID_PARAM(Kd,e) * (current_temperature[e] - temp_dState[e]) + K1 * dTerm[e];
-      temp_dState[e] = current_temperature[e];
-      if (pid_error[e] > PID_FUNCTIONAL_RANGE) {
-        pid_output = BANG_MAX;
-        pid_reset[e] = true;
-      }
-      else if (pid_error[e] < -PID_FUNCTIONAL_RANGE || target_temperature[e] == 0) {
-        pid_output = 0;
-        pid_reset[e] = true;
-      }
-      else {
-        if (pid_reset[e]) {
-          temp_iState[e] = 0.0;
-          pid_reset[e] = false;
-        }
-        pTerm[e] = PID_PARAM(Kp,e) * pid_error[e];
-        temp_iState[e] += pid_error[e];
-        temp_iState[e] = constrain(temp_iState[e], temp_iState_min[e], temp_iState_max[e]);
-        iTerm[e] = PID_PARAM(Ki,e) * temp_iState[e];
-
-        pid_output = pTerm[e] + iTerm[e] - dTerm[e];
-        if (pid_output > PID_MAX) {
-          if (pid_error[e] > 0) temp_iState[e] -= pid_error[e]; // conditional un-integration
-          pid_output = PID_MAX;
-        }
-        else if (pid_output < 0) {
-          if (pid_error[e] < 0) temp_iState[e] -= pid_error[e]; // conditional un-integration
-          pid_output = 0;
-        }
-      }
+      #ifdef PID_ADD_EXTRUSION_RATE
+        // Feed forward the heat the upcoming filament flow will take
+        cTerm[e] = PID_PARAM(Kc,e) * plan_e_speed(e, PID_EXTRUSION_RATE_LOOKAHEAD);
+        const float feedforward = cTerm[e];
+      #else
+        const float feedforward = 0;
+      #endif
+      pid_output = pid_step(pid_state[e], target_temperature[e], current_temperature[e], PID_PARAM(Kp,e), PID_PARAM(Ki,e), PID_PARAM(Kd,e), feedforward);
     #else
       pid_output = constrain(target_temperature[e], 0, PID_MAX);
     #endif //PID_OPENLOOP
@@ -520,11 +606,16 @@ float get_pid_output(int e) {
       SERIAL_ECHO(MSG_PID_DEBUG_OUTPUT);
       SERIAL_ECHO(pid_output);
       SERIAL_ECHO(MSG_PID_DEBUG_PTERM);
-      SERIAL_ECHO(pTerm[e]);
+      SERIAL_ECHO(pid_state[e].pTerm);
       SERIAL_ECHO(MSG_PID_DEBUG_ITERM);
-      SERIAL_ECHO(iTerm[e]);
+      SERIAL_ECHO(pid_state[e].iTerm);
       SERIAL_ECHO(MSG_PID_DEBUG_DTERM);
-      SERIAL_ECHOLN(dTerm[e]);
+      SERIAL_ECHO(pid_state[e].dTerm);
+      #ifdef PID_ADD_EXTRUSION_RATE
+        SERIAL_ECHO(MSG_PID_DEBUG_CTERM);
+        SERIAL_ECHO(cTerm[e]);
+      #endif
+      SERIAL_EOL;
     #endif //PID_DEBUG
 
   #else /* PID off */
@@ -579,6 +670,294 @@ float get_pid_output(int e) {
   }
 #endif
 
+#ifdef MPCTEMP
+
+  // Start the model from the measured temperature
+  static void mpc_init_model(int e, float ambient) {
+    mpc_block_temp[e] = mpc_sensor_temp[e] = current_temperature[e];
+    mpc_ambient_temp[e] = ambient;
+    mpc_model_ready[e] = true;
+  }
+
+  /**
+   * Advance the thermal model of the hotend by one sample, pull it toward
+   * the measured temperature, and return the heater output that brings the
+   * modeled block to the target while covering the predicted losses.
+   */
+  float get_mpc_output(int e) {
+    const mpc_t &m = mpc[e];
+
+    // Assume a warm room, the model corrects the ambient temperature over time
+    if (!mpc_model_ready[e]) mpc_init_model(e, min(current_temperature[e], 30));
+
+    const float ambient_xfer_coeff = m.ambient_xfer_coeff_fan0 + fanSpeed * (1.0 / 255) * m.fan255_adjustment,
+                filament_xfer_coeff = plan_e_speed(e) * m.filament_heat_capacity_permm;
+
+    // Heat from the power applied since the last sample, less the losses
+    const float applied_power = m.heater_power * heater_duty_fraction(e);
+    float blocktempdelta = (applied_power - (mpc_block_temp[e] - mpc_ambient_temp[e]) * (ambient_xfer_coeff + filament_xfer_coeff))
+                           * PID_dT / m.block_heat_capacity;
+    mpc_block_temp[e] += blocktempdelta;
+    mpc_sensor_temp[e] += (mpc_block_temp[e] - mpc_sensor_temp[e]) * m.sensor_responsiveness * PID_dT;
+
+    // The difference to the measured temperature is model error or an ambient change
+    const float delta_to_apply = (current_temperature[e] - mpc_sensor_temp[e]) * MPC_SMOOTHING_FACTOR;
+    mpc_block_temp[e] += delta_to_apply;
+    mpc_sensor_temp[e] += delta_to_apply;
+
+    // Only blame the ambient temperature near steady state
+    if ((getHeaterPower(e) > 0 && getHeaterPower(e) < (MPC_MAX >> 1)) || fabs(blocktempdelta + delta_to_apply) < MPC_STEADYSTATE * PID_dT)
+      mpc_ambient_temp[e] += delta_to_apply > 0 ? max(delta_to_apply, MPC_MIN_AMBIENT_CHANGE * PID_dT)
+                                                 : min(delta_to_apply, -MPC_MIN_AMBIENT_CHANGE * PID_dT);
+
+    float power = 0;
+    if (target_temperature[e] > 0) {
+      // Reach the target within one sample, then hold it against the losses
+      power = (target_temperature[e] - mpc_block_temp[e]) * m.block_heat_capacity / PID_dT
+            + (target_temperature[e] - mpc_ambient_temp[e]) * (ambient_xfer_coeff + filament_xfer_coeff);
+    }
+
+    float mpc_output = constrain(power * 256 / m.heater_power, 0, MPC_MAX);
+
+    #ifdef PID_DEBUG
+      SERIAL_ECHO_START;
+      SERIAL_ECHO(" MPC_DEBUG ");
+      SERIAL_ECHO(e);
+      SERIAL_ECHO(MSG_PID_DEBUG_INPUT);
+      SERIAL_ECHO(current_temperature[e]);
+      SERIAL_ECHO(MSG_PID_DEBUG_OUTPUT);
+      SERIAL_ECHO(mpc_output);
+      SERIAL_ECHO(" block ");
+      SERIAL_ECHO(mpc_block_temp[e]);
+      SERIAL_ECHO(" ambient ");
+      SERIAL_ECHOLN(mpc_ambient_temp[e]);
+    #endif
+
+    return mpc_output;
+  }
+
+  void MPC_print(int e) {
+    const mpc_t &m = mpc[e];
+    SERIAL_PROTOCOLPGM("M306 E");
+    SERIAL_PROTOCOL(e);
+    SERIAL_PROTOCOLPGM(" P");
+    SERIAL_PROTOCOL_F(m.heater_power, 2);
+    SERIAL_PROTOCOLPGM(" C");
+    SERIAL_PROTOCOL_F(m.block_heat_capacity, 2);
+    SERIAL_PROTOCOLPGM(" R");
+    SERIAL_PROTOCOL_F(m.sensor_responsiveness, 4);
+    SERIAL_PROTOCOLPGM(" A");
+    SERIAL_PROTOCOL_F(m.ambient_xfer_coeff_fan0, 4);
+    SERIAL_PROTOCOLPGM(" F");
+    SERIAL_PROTOCOL_F(m.ambient_xfer_coeff_fan0 + m.fan255_adjustment, 4);
+    SERIAL_PROTOCOLPGM(" H");
+    SERIAL_PROTOCOL_F(m.filament_heat_capacity_permm, 4);
+    SERIAL_EOL;
+  }
+
+  #define MAX_OVERSHOOT_MPC_AUTOTUNE 20
+  #define MPC_AUTOTUNE_COOLING_TIMEOUT (15L*60L*1000L)
+
+  static void mpc_autotune_fan(int speed) {
+    fanSpeed = speed;
+    check_axes_activity(); // Apply it now, no moves are queued
+  }
+
+  // What idle() does but manage_heater(), which would fight the tuning for the heater
+  static void mpc_autotune_idle() {
+    #ifdef EMERGENCY_PARSER
+      emergency_parser_poll(); // M108 cancels, M112 kills
+    #endif
+    #ifdef SERIAL_TX_BUFFER_SIZE
+      serial_tx.drain();
+    #endif
+    lcd_update();
+  }
+
+  /**
+   * Wait for the next temperature sample into t, reporting every 2 seconds like M303.
+   * manage_heater() doesn't run while tuning, so the heater is protected here as
+   * it would be, against target_temperature[e].
+   * Returns false once the tuning is cancelled by M108 or the LCD, or stopped by an error.
+   */
+  static bool mpc_autotune_sample(int e, float &t) {
+    static millis_t next_report_ms = 0;
+    while (!temp_meas_ready) mpc_autotune_idle();
+    updateTemperaturesFromRawValues();
+    t = current_temperature[e];
+
+    #ifdef THERMAL_PROTECTION_HOTENDS
+      thermal_runaway_protection(&thermal_runaway_state_machine[e], &thermal_runaway_timer[e], t, target_temperature[e], e, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS);
+      if (watch_heater_check(t, target_temperature[e], millis(), &watch_target_temp[e], &watch_heater_next_ms[e]))
+        _temp_error(e, PSTR(MSG_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
+    #endif
+    if (!IsRunning()) return false;
+
+    if (cancel_heatup) {
+      SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FAILED " cancelled");
+      return false;
+    }
+
+    millis_t ms = millis();
+    if (ms >= next_report_ms) {
+      SERIAL_PROTOCOLPGM(MSG_T);
+      SERIAL_PROTOCOL(current_temperature[e]);
+      SERIAL_PROTOCOLPGM(MSG_AT);
+      SERIAL_PROTOCOLLN(getHeaterPower(e));
+      next_report_ms = ms + 2000;
+    }
+    return true;
+  }
+
+  // Hold the target with the model and average the power it takes to stay there
+  static bool mpc_autotune_hold(int e, float &power, float &temp) {
+    const millis_t settle_ms = 30000UL, measure_ms = 60000UL, start_ms = millis();
+    float power_sum = 0, temp_sum = 0;
+    long count = 0;
+    for (;;) {
+      float t;
+      if (!mpc_autotune_sample(e, t)) return false;
+      if (t > target_temperature[e] + MAX_OVERSHOOT_MPC_AUTOTUNE) {
+        SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FAILED);
+        return false;
+      }
+      set_heater_output(e, get_mpc_output(e));
+
+      millis_t elapsed = millis() - start_ms;
+      if (elapsed > settle_ms + measure_ms) break;
+      if (elapsed > settle_ms) {
+        power_sum += mpc[e].heater_power * heater_duty_fraction(e);
+        temp_sum += t;
+        count++;
+      }
+    }
+    power = power_sum / count;
+    temp = temp_sum / count;
+    return true;
+  }
+
+  static bool mpc_autotune_run(int e, float temp) {
+    mpc_t &m = mpc[e];
+
+    // Let the hotend cool with the fan on until the temperature stops falling
+    SERIAL_PROTOCOLLNPGM(MSG_MPC_COOLING_TO_AMBIENT);
+    mpc_autotune_fan(255);
+    float ambient, t;
+    if (!mpc_autotune_sample(e, ambient)) return false;
+    for (millis_t start_ms = millis(), next_ms = start_ms + 10000UL;;) {
+      if (!mpc_autotune_sample(e, t)) return false;
+      if (millis() - start_ms > MPC_AUTOTUNE_COOLING_TIMEOUT) {
+        SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FAILED " timeout");
+        return false;
+      }
+      if (millis() >= next_ms) {
+        if (ambient - t < 0.5) { ambient = t; break; }
+        ambient = t;
+        next_ms += 10000UL;
+      }
+    }
+    mpc_autotune_fan(0);
+
+    /**
+     * Heat at full power. The block approaches its asymptotic temperature
+     * exponentially, so three equally spaced samples of the rise give the
+     * asymptote and the rate. Sampling starts past the sensor dead time and
+     * the interval doubles whenever the buffer fills.
+     */
+    SERIAL_PROTOCOLPGM(MSG_MPC_HEATING_PAST);
+    SERIAL_PROTOCOLLN(temp);
+    target_temperature[e] = temp; // For the runaway and heating checks, the output is set here
+    #ifdef THERMAL_PROTECTION_HOTENDS
+      start_watching_heater(e);
+    #endif
+    set_heater_output(e, MPC_MAX);
+    const float power = m.heater_power * heater_duty_fraction(e);
+    float samples[16];
+    uint8_t sample_count = 0;
+    millis_t interval_ms = 1000, start_ms = millis(), first_sample_ms = 0, next_sample_ms = 0;
+    for (;;) {
+      if (!mpc_autotune_sample(e, t)) return false;
+      millis_t ms = millis();
+      if (t >= temp) break;
+      if (ms - start_ms > 20L*60L*1000L) {
+        SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FAILED " timeout");
+        return false;
+      }
+      if (!sample_count) {
+        if (t < ambient + 10) continue;
+        first_sample_ms = next_sample_ms = ms;
+      }
+      if (ms >= next_sample_ms) {
+        if (sample_count == COUNT(samples)) {
+          for (uint8_t i = 0; i < COUNT(samples) / 2; i++) samples[i] = samples[i * 2];
+          sample_count = COUNT(samples) / 2;
+          interval_ms *= 2;
+        }
+        samples[sample_count++] = t;
+        next_sample_ms += interval_ms;
+      }
+    }
+
+    const uint8_t k = (sample_count - 1) / 2;
+    if (k < 1 || 2 * samples[k] - samples[0] - samples[2 * k] <= 0) {
+      SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FAILED);
+      return false;
+    }
+    const float t1 = samples[0], t2 = samples[k], t3 = samples[2 * k],
+                asymp_temp = (t2 * t2 - t1 * t3) / (2 * t2 - t1 - t3),
+                block_responsiveness = -log((t2 - asymp_temp) / (t1 - asymp_temp)) / (k * interval_ms / 1000.0);
+
+    m.ambient_xfer_coeff_fan0 = power / (asymp_temp - ambient);
+    m.fan255_adjustment = 0;
+    m.block_heat_capacity = m.ambient_xfer_coeff_fan0 / block_responsiveness;
+    m.sensor_responsiveness = block_responsiveness / (1 - (ambient - asymp_temp) * exp(-block_responsiveness * (first_sample_ms - start_ms) / 1000.0) / (t1 - asymp_temp));
+
+    // Refine the losses from the power needed to hold the target, with and without the fan
+    SERIAL_PROTOCOLLNPGM(MSG_MPC_MEASURING_HEAT_LOSS);
+    target_temperature[e] = temp;
+    mpc_init_model(e, ambient);
+    float hold_power, hold_temp;
+    if (!mpc_autotune_hold(e, hold_power, hold_temp)) return false;
+    m.ambient_xfer_coeff_fan0 = hold_power / (hold_temp - ambient);
+    m.block_heat_capacity = m.ambient_xfer_coeff_fan0 / block_responsiveness;
+
+    SERIAL_PROTOCOLLNPGM(MSG_MPC_MEASURING_FAN_LOSS);
+    mpc_autotune_fan(255);
+    if (!mpc_autotune_hold(e, hold_power, hold_temp)) return false;
+    m.fan255_adjustment = hold_power / (hold_temp - ambient) - m.ambient_xfer_coeff_fan0;
+
+    return true;
+  }
+
+  /**
+   * Identify the thermal model of a hotend (M306 T). Blocks like M303 did,
+   * until done, failed or cancelled with M108 or the LCD.
+   */
+  void MPC_autotune(int e, float temp) {
+    if (e < 0 || e >= EXTRUDERS) {
+      SERIAL_ECHOLN(MSG_MPC_AUTOTUNE_FAILED " Bad extruder number");
+      return;
+    }
+
+    SERIAL_ECHOLN(MSG_MPC_AUTOTUNE_START);
+    disable_all_heaters();
+    int old_fan_speed = fanSpeed;
+    cancel_heatup = false;
+
+    bool ok = mpc_autotune_run(e, temp);
+
+    disable_all_heaters();
+    mpc_autotune_fan(old_fan_speed);
+    mpc_model_ready[e] = false;
+
+    if (ok) {
+      SERIAL_PROTOCOLLNPGM(MSG_MPC_AUTOTUNE_FINISHED);
+      MPC_print(e);
+    }
+  }
+
+#endif // MPCTEMP
+
 /**
  * Manage heating activities for extruder hot-ends and a heated bed
  *  - Acquire updated temperature readings
@@ -603,33 +982,31 @@ void manage_heater() {
     millis_t ms = millis();
   #endif
 
+  if (autotune.active) pid_autotune_update();
+
   // Loop through all extruders
   for (int e = 0; e < EXTRUDERS; e++) {
 
     #ifdef THERMAL_PROTECTION_HOTENDS
-      thermal_runaway_protection(&thermal_runaway_state_machine[e], &thermal_runaway_timer[e], current_temperature[e], target_temperature[e], e, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS);
+      thermal_runaway_protection(&thermal_runaway_state_machine[e], &thermal_runaway_timer[e], current_temperature[e], PROTECTED_TARGET(e, target_temperature[e]), e, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS);
     #endif
 
-    float pid_output = get_pid_output(e);
+    #ifdef MPCTEMP
+      float pid_output = get_mpc_output(e);
+    #else
+      float pid_output = get_pid_output(e);
+    #endif
 
     // Check if temperature is within the correct range
-    soft_pwm[e] = current_temperature[e] > minttemp[e] && current_temperature[e] < maxttemp[e] ? (int)pid_output >> 1 : 0;
+    if (!AUTOTUNING(e))
+      set_heater_output(e, current_temperature[e] > minttemp[e] && current_temperature[e] < maxttemp[e] ? pid_output : 0);
 
     // Check if the temperature is failing to increase
     #ifdef THERMAL_PROTECTION_HOTENDS
 
-      // Is it time to check this extruder's heater?
-      if (watch_heater_next_ms[e] && ms > watch_heater_next_ms[e]) {
-        // Has it failed to increase enough?
-        if (degHotend(e) < watch_target_temp[e]) {
-          // Stop!
-          _temp_error(e, PSTR(MSG_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
-        }
-        else {
-          // Start again if the target is still far off
-          start_watching_heater(e);
-        }
-      }
+      // Has it failed to increase enough since the last check? Stop!
+      if (watch_heater_check(degHotend(e), degTargetHotend(e), ms, &watch_target_temp[e], &watch_heater_next_ms[e]))
+        _temp_error(e, PSTR(MSG_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
 
     #endif // THERMAL_PROTECTION_HOTENDS
 
@@ -669,42 +1046,56 @@ void manage_heater() {
   #endif
 
   #if TEMP_SENSOR_BED != 0
-  
+
     #ifdef THERMAL_PROTECTION_BED
-      thermal_runaway_protection(&thermal_runaway_bed_state_machine, &thermal_runaway_bed_timer, current_temperature_bed, target_temperature_bed, -1, THERMAL_PROTECTION_BED_PERIOD, THERMAL_PROTECTION_BED_HYSTERESIS);
+      thermal_runaway_protection(&thermal_runaway_bed_state_machine, &thermal_runaway_bed_timer, current_temperature_bed, PROTECTED_TARGET(-1, target_temperature_bed), -1, THERMAL_PROTECTION_BED_PERIOD, THERMAL_PROTECTION_BED_HYSTERESIS);
     #endif
 
+    if (AUTOTUNING(-1)) return; // The tuning sets the output
+
     #ifdef PIDTEMPBED
       float pid_output = get_pid_output_bed();
 
-      soft_pwm_bed = current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP ? (int)pid_output >> 1 : 0;
+      set_heater_output(-1, current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP ? pid_output : 0);
 
     #elif defined(BED_LIMIT_SWITCHING)
       // Check if temperature is within the correct band
       if (current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP) {
         if (current_temperature_bed >= target_temperature_bed + BED_HYSTERESIS)
-          soft_pwm_bed = 0;
+          set_heater_output(-1, 0);
         else if (current_temperature_bed <= target_temperature_bed - BED_HYSTERESIS)
-          soft_pwm_bed = MAX_BED_POWER >> 1;
+          set_heater_output(-1, MAX_BED_POWER);
       }
       else {
-        soft_pwm_bed = 0;
+        set_heater_output(-1, 0);
         WRITE_HEATER_BED(LOW);
       }
     #else // BED_LIMIT_SWITCHING
       // Check if temperature is within the correct range
       if (current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP) {
-        soft_pwm_bed = current_temperature_bed < target_temperature_bed ? MAX_BED_POWER >> 1 : 0;
+        set_heater_output(-1, current_temperature_bed < target_temperature_bed ? MAX_BED_POWER : 0);
       }
       else {
-        soft_pwm_bed = 0;
+        set_heater_output(-1, 0);
         WRITE_HEATER_BED(LOW);
       }
     #endif
   #endif //TEMP_SENSOR_BED != 0
 }
 
-#define PGM_RD_W(x)   (short)pgm_read_word(&x)
+static void init_temptables() {
+  float *slope = temptable_slopes;
+  for (uint8_t e = 0; e < COUNT(heater_ttbl_map); e++) {
+    heater_ttbl_slope[e] = slope;
+    if (heater_ttbl_map[e] != NULL)
+      slope = init_temptable_slopes((const short (*)[2])heater_ttbl_map[e], heater_ttbllen_map[e], slope);
+  }
+  #ifdef BED_USES_THERMISTOR
+    bed_ttbl_slope = slope;
+    init_temptable_slopes(BEDTEMPTABLE, BEDTEMPTABLE_LEN, slope);
+  #endif
+}
+
 // Derived from RepRap FiveD extruder::getTemperature()
 // For hot end temperature measurement.
 static float analog2temp(int raw, uint8_t e) {
@@ -725,26 +1116,9 @@ static float analog2temp(int raw, uint8_t e) {
     if (e == 0) return 0.25 * raw;
   #endif
 
-  if (heater_ttbl_map[e] != NULL) {
-    float celsius = 0;
-    uint8_t i;
-    short (*tt)[][2] = (short (*)[][2])(heater_ttbl_map[e]);
-
-    for (i = 1; i < heater_ttbllen_map[e]; i++) {
-      if (PGM_RD_W((*tt)[i][0]) > raw) {
-        celsius = PGM_RD_W((*tt)[i-1][1]) + 
-          (raw - PGM_RD_W((*tt)[i-1][0])) * 
-          (float)(PGM_RD_W((*tt)[i][1]) - PGM_RD_W((*tt)[i-1][1])) /
-          (float)(PGM_RD_W((*tt)[i][0]) - PGM_RD_W((*tt)[i-1][0]));
-        break;
-      }
-    }
-
-    // Overflow: Set to last value in the table
-    if (i == heater_ttbllen_map[e]) celsius = PGM_RD_W((*tt)[i-1][1]);
+  if (heater_ttbl_map[e] != NULL)
+    return temptable_lookup((const short (*)[2])heater_ttbl_map[e], heater_ttbl_slope[e], heater_ttbllen_map[e], raw);
 
-    return celsius;
-  }
   return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
 }
 
@@ -752,23 +1126,7 @@ static float analog2temp(int raw, uint8_t e) {
 // For bed temperature measurement.
 static float analog2tempBed(int raw) {
   #ifdef BED_USES_THERMISTOR
-    float celsius = 0;
-    byte i;
-
-    for (i = 1; i < BEDTEMPTABLE_LEN; i++) {
-      if (PGM_RD_W(BEDTEMPTABLE[i][0]) > raw) {
-        celsius  = PGM_RD_W(BEDTEMPTABLE[i-1][1]) + 
-          (raw - PGM_RD_W(BEDTEMPTABLE[i-1][0])) * 
-          (float)(PGM_RD_W(BEDTEMPTABLE[i][1]) - PGM_RD_W(BEDTEMPTABLE[i-1][1])) /
-          (float)(PGM_RD_W(BEDTEMPTABLE[i][0]) - PGM_RD_W(BEDTEMPTABLE[i-1][0]));
-        break;
-      }
-    }
-
-    // Overflow: Set to last value in the table
-    if (i == BEDTEMPTABLE_LEN) celsius = PGM_RD_W(BEDTEMPTABLE[i-1][1]);
-
-    return celsius;
+    return temptable_lookup(BEDTEMPTABLE, bed_ttbl_slope, BEDTEMPTABLE_LEN, raw);
   #elif defined BED_USES_AD595
     return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
   #else
@@ -776,9 +1134,80 @@ static float analog2tempBed(int raw) {
   #endif
 }
 
+#ifdef HEATER_SIMULATION
+
+  /**
+   * Simulated heaters of heater_sim.h, driven by the duty of the heater
+   * outputs. The temperature ISR reads the ADC values that the thermistors
+   * would give instead of the real sensors.
+   */
+  static heater_sim_t heater_sim[EXTRUDERS + 1]; // The bed after the hotends
+  static volatile uint16_t heater_sim_adc[5];    // 12 bit readings by temp_id, the bed at 4
+  static millis_t heater_sim_ms = 0;
+
+  static int heater_sim_raw(uint8_t e, const float celsius) {
+    if (e == EXTRUDERS) {
+      #ifdef BED_USES_THERMISTOR
+        return temptable_reverse_lookup(BEDTEMPTABLE, BEDTEMPTABLE_LEN, celsius);
+      #elif defined BED_USES_AD595
+        return (celsius - TEMP_SENSOR_AD595_OFFSET) / TEMP_SENSOR_AD595_GAIN * (1024.0 / (5.0 * 100.0)) * OVERSAMPLENR;
+      #else
+        return 0;
+      #endif
+    }
+    if (heater_ttbl_map[e] != NULL)
+      return temptable_reverse_lookup((const short (*)[2])heater_ttbl_map[e], heater_ttbllen_map[e], celsius);
+    return (celsius - TEMP_SENSOR_AD595_OFFSET) / TEMP_SENSOR_AD595_GAIN * (1024.0 / (5.0 * 100.0)) * OVERSAMPLENR;
+  }
+
+  static void heater_sim_init() {
+    for (uint8_t e = 0; e <= EXTRUDERS; e++)
+      heater_sim[e].block_temp = heater_sim[e].sensor_temp = SIM_AMBIENT_TEMP;
+    heater_sim_ms = millis();
+  }
+
+  static void heater_sim_update() {
+    millis_t ms = millis();
+    float dt = (ms - heater_sim_ms) / 1000.0;
+    heater_sim_ms = ms;
+
+    for (uint8_t e = 0; e <= EXTRUDERS; e++) {
+      heater_sim_t &h = heater_sim[e];
+      float power, heat_capacity, loss, lag;
+      if (e == EXTRUDERS) {
+        power = SIM_BED_POWER * heater_duty_fraction(-1);
+        heat_capacity = SIM_BED_HEAT_CAPACITY;
+        loss = SIM_BED_LOSS;
+        lag = SIM_BED_SENSOR_LAG;
+      }
+      else {
+        power = SIM_HOTEND_POWER * heater_duty_fraction(e);
+        #ifdef SIM_HOTEND_FAILURE_TIME
+          if (e == 0 && ms > SIM_HOTEND_FAILURE_TIME * 1000UL) power = 0;
+        #endif
+        heat_capacity = SIM_HOTEND_HEAT_CAPACITY;
+        loss = SIM_HOTEND_LOSS + SIM_HOTEND_FAN_LOSS * fanSpeed / 255.0;
+        lag = SIM_HOTEND_SENSOR_LAG;
+      }
+      heater_sim_step(h, power, heat_capacity, loss, lag, SIM_AMBIENT_TEMP, dt);
+    }
+
+    // The temp ISR sums OVERSAMPLENR readings of 12 bits, the tables are in 10 bit units
+    for (uint8_t i = 0; i < 5; i++) {
+      uint8_t e = i == 4 ? EXTRUDERS : i < EXTRUDERS ? i : 0; // A redundant sensor reads hotend 0
+      long raw = heater_sim_raw(e, heater_sim[e].sensor_temp) * 4 / OVERSAMPLENR + random(-SIM_ADC_NOISE, SIM_ADC_NOISE + 1);
+      heater_sim_adc[i] = constrain(raw, 0, 4095);
+    }
+  }
+
+#endif // HEATER_SIMULATION
+
 /* Called to get the raw values into the the actual temperatures. The raw values are created in interrupt context,
     and this function is called from normal context as it is too slow to run in interrupts and will block the stepper routine otherwise */
 static void updateTemperaturesFromRawValues() {
+  #ifdef HEATER_SIMULATION
+    heater_sim_update();
+  #endif
   #ifdef HEATER_0_USES_MAX6675
     current_temperature_raw[0] = read_max6675();
   #endif
@@ -831,13 +1260,19 @@ void tp_init() {
     MCUCR=BIT(JTD);
   #endif
   
+  init_temptables();
+  #ifdef HEATER_SIMULATION
+    heater_sim_init();
+    heater_sim_update();
+  #endif
+
   // Finish init of mult extruder arrays 
   for (int e = 0; e < EXTRUDERS; e++) {
     // populate with the first value 
     maxttemp[e] = maxttemp[0];
     #ifdef PIDTEMP
-      temp_iState_min[e] = 0.0;
-      temp_iState_max[e] = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki,e);
+      pid_state[e].iState_min = 0.0;
+      pid_state[e].iState_max = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki,e);
     #endif //PIDTEMP
     #ifdef PIDTEMPBED
       temp_iState_min_bed = 0.0;
@@ -848,22 +1283,35 @@ void tp_init() {
   #if HAS_HEATER_0
     SET_OUTPUT(HEATER_0_PIN);
     WRITE_HEATER(HEATER_0_PIN,LOW);
+    HEATER_PWM_INIT(0, HEATER_0_PIN);
   #endif
   #if HAS_HEATER_1
     SET_OUTPUT(HEATER_1_PIN);
     WRITE_HEATER(HEATER_1_PIN,LOW);
+    #if EXTRUDERS > 1
+      HEATER_PWM_INIT(1, HEATER_1_PIN);
+    #endif
   #endif
   #if HAS_HEATER_2
     SET_OUTPUT(HEATER_2_PIN);
     WRITE_HEATER(HEATER_2_PIN,LOW);
+    #if EXTRUDERS > 2
+      HEATER_PWM_INIT(2, HEATER_2_PIN);
+    #endif
   #endif
   #if HAS_HEATER_3
     SET_OUTPUT(HEATER_3_PIN);
     WRITE_HEATER(HEATER_3_PIN,LOW);
+    #if EXTRUDERS > 3
+      HEATER_PWM_INIT(3, HEATER_3_PIN);
+    #endif
   #endif
   #if HAS_HEATER_BED
     SET_OUTPUT(HEATER_BED_PIN);
     WRITE_HEATER_BED(LOW);
+    #ifdef HEATER_BED_HARDWARE_PWM
+      HEATER_PWM_INIT(EXTRUDERS, HEATER_BED_PIN);
+    #endif
   #endif  
   #if HAS_FAN
     SET_OUTPUT(FAN_PIN);
@@ -892,30 +1340,29 @@ void tp_init() {
   #endif //HEATER_0_USES_MAX6675
 
   // Set analog inputs
-  
-  // Setup channels
-
-    ADC->ADC_MR |= ADC_MR_FREERUN_ON |
-    		  	  	 ADC_MR_LOWRES_BITS_12;
-
-    #define START_TEMP(temp_id) startAdcConversion(pinToAdcChannel(TEMP_## temp_id ##_PIN))
-    #define START_BED_TEMP() startAdcConversion(pinToAdcChannel(TEMP_BED_PIN))
 
-    #if HAS_TEMP_0
-      START_TEMP(0);
-    #endif
-    #if HAS_TEMP_BED
-      START_BED_TEMP();
-    #endif
-    #if HAS_TEMP_1
-      START_TEMP(1);
-    #endif
-    #if HAS_TEMP_2
-      START_TEMP(2);
-    #endif
-    #if HAS_TEMP_3
-      START_TEMP(3);
-    #endif
+  // Scan all sensor channels, the ISR collects the averages
+  uint32_t adc_channels = 0;
+  #define ADC_SCAN_PIN(pin) adc_channels |= BIT(pinToAdcChannel(pin))
+  #if HAS_TEMP_0
+    ADC_SCAN_PIN(TEMP_0_PIN);
+  #endif
+  #if HAS_TEMP_BED
+    ADC_SCAN_PIN(TEMP_BED_PIN);
+  #endif
+  #if HAS_TEMP_1
+    ADC_SCAN_PIN(TEMP_1_PIN);
+  #endif
+  #if HAS_TEMP_2
+    ADC_SCAN_PIN(TEMP_2_PIN);
+  #endif
+  #if HAS_TEMP_3
+    ADC_SCAN_PIN(TEMP_3_PIN);
+  #endif
+  #if HAS_FILAMENT_SENSOR
+    ADC_SCAN_PIN(FILWIDTH_PIN);
+  #endif
+  HAL_adc_scan_start(adc_channels);
 
   // Use timer0 for temperature measurement
   // Interleave temperature interrupt with millies interrupt
@@ -1001,12 +1448,7 @@ void tp_init() {
    * This is called when the temperature is set. (M104, M109)
    */
   void start_watching_heater(int e) {
-    if (degHotend(e) < degTargetHotend(e) - (WATCH_TEMP_INCREASE + TEMP_HYSTERESIS + 1)) {
-      watch_target_temp[e] = degHotend(e) + WATCH_TEMP_INCREASE;
-      watch_heater_next_ms[e] = millis() + WATCH_TEMP_PERIOD * 1000UL;
-    }
-    else
-      watch_heater_next_ms[e] = 0;
+    watch_heater_start(degHotend(e), degTargetHotend(e), millis(), &watch_target_temp[e], &watch_heater_next_ms[e]);
   }
 #endif
 
@@ -1033,54 +1475,26 @@ void tp_init() {
 
     int heater_index = heater_id >= 0 ? heater_id : EXTRUDERS;
 
-    // If the target temperature changes, restart
-    if (tr_target_temperature[heater_index] != target_temperature)
-      *state = TRReset;
-
-    switch (*state) {
-      case TRReset:
-        *timer = 0;
-        *state = TRInactive;
-      // Inactive state waits for a target temperature to be set
-      case TRInactive:
-        if (target_temperature > 0) {
-          tr_target_temperature[heater_index] = target_temperature;
-          *state = TRFirstHeating;
-        }
-        break;
-      // When first heating, wait for the temperature to be reached then go to Stable state
-      case TRFirstHeating:
-        if (temperature >= tr_target_temperature[heater_index]) *state = TRStable;
-        break;
-      // While the temperature is stable watch for a bad temperature
-      case TRStable:
-        // If the temperature is over the target (-hysteresis) restart the timer
-        if (temperature >= tr_target_temperature[heater_index] - hysteresis_degc)
-          *timer = millis();
-          // If the timer goes too long without a reset, trigger shutdown
-        else if (millis() > *timer + period_seconds * 1000UL)
-          *state = TRRunaway;
-        break;
-      case TRRunaway:
-        _temp_error(heater_id, PSTR(MSG_T_THERMAL_RUNAWAY), PSTR(MSG_THERMAL_RUNAWAY));
-    }
+    if (thermal_runaway_step(state, timer, &tr_target_temperature[heater_index], temperature, target_temperature, millis(), period_seconds, hysteresis_degc))
+      _temp_error(heater_id, PSTR(MSG_T_THERMAL_RUNAWAY), PSTR(MSG_THERMAL_RUNAWAY));
   }
 
 #endif // THERMAL_PROTECTION_HOTENDS || THERMAL_PROTECTION_BED
 
 void disable_all_heaters() {
+  autotune.active = false;
   for (int i=0; i<EXTRUDERS; i++) setTargetHotend(0, i);
   setTargetBed(0);
 
   #define DISABLE_HEATER(NR) { \
     target_temperature[NR] = 0; \
-    soft_pwm[NR] = 0; \
+    set_heater_output(NR, 0); \
     WRITE_HEATER_ ## NR (LOW); \
   }
 
   #if HAS_TEMP_0
     target_temperature[0] = 0;
-    soft_pwm[0] = 0;
+    set_heater_output(0, 0);
     WRITE_HEATER_0P(LOW); // Should HEATERS_PARALLEL apply here? Then change to DISABLE_HEATER(0)
   #endif
 
@@ -1098,7 +1512,7 @@ void disable_all_heaters() {
 
   #if HAS_TEMP_BED
     target_temperature_bed = 0;
-    soft_pwm_bed = 0;
+    set_heater_output(-1, 0);
     #if HAS_HEATER_BED
       WRITE_HEATER_BED(LOW);
     #endif
@@ -1163,6 +1577,76 @@ void disable_all_heaters() {
 
 #endif //HEATER_0_USES_MAX6675
 
+/**
+ * Smoothing over the last MEDIAN_COUNT oversampled readings of a sensor.
+ * The mean keeps a running sum, the median keeps the window sorted so an
+ * update only moves the entries between the old and the new value.
+ */
+typedef struct {
+  unsigned long ring[MEDIAN_COUNT];   // Readings in arrival order
+  unsigned long sorted[MEDIAN_COUNT]; // The same readings in ascending order
+  unsigned long sum;
+  unsigned char index;
+} temp_filter_t;
+
+static void temp_filter_init(temp_filter_t &f, unsigned long value) {
+  for (uint8_t i = 0; i < MEDIAN_COUNT; i++) f.ring[i] = f.sorted[i] = value;
+  f.sum = value * MEDIAN_COUNT;
+  f.index = 0;
+}
+
+static unsigned long temp_filter_mean(temp_filter_t &f, unsigned long value) {
+  f.sum += value - f.ring[f.index];
+  f.ring[f.index] = value;
+  if (++f.index >= MEDIAN_COUNT) f.index = 0;
+  return f.sum / MEDIAN_COUNT;
+}
+
+static unsigned long temp_filter_median(temp_filter_t &f, unsigned long value) {
+  unsigned long old = f.ring[f.index];
+  f.ring[f.index] = value;
+  if (++f.index >= MEDIAN_COUNT) f.index = 0;
+
+  // Replace the old reading in the sorted window and shift the new one into place
+  uint8_t i = 0;
+  while (f.sorted[i] != old) i++;
+  for (; i > 0 && f.sorted[i - 1] > value; i--) f.sorted[i] = f.sorted[i - 1];
+  for (; i < MEDIAN_COUNT - 1 && f.sorted[i + 1] < value; i++) f.sorted[i] = f.sorted[i + 1];
+  f.sorted[i] = value;
+
+  #if MEDIAN_COUNT % 2
+    return f.sorted[MEDIAN_COUNT / 2];
+  #else
+    return (f.sorted[MEDIAN_COUNT / 2 - 1] + f.sorted[MEDIAN_COUNT / 2]) / 2;
+  #endif
+}
+
+#ifdef TEMP_0_MEDIAN_FILTER
+  #define TEMP_FILTER_0 temp_filter_median
+#else
+  #define TEMP_FILTER_0 temp_filter_mean
+#endif
+#ifdef TEMP_1_MEDIAN_FILTER
+  #define TEMP_FILTER_1 temp_filter_median
+#else
+  #define TEMP_FILTER_1 temp_filter_mean
+#endif
+#ifdef TEMP_2_MEDIAN_FILTER
+  #define TEMP_FILTER_2 temp_filter_median
+#else
+  #define TEMP_FILTER_2 temp_filter_mean
+#endif
+#ifdef TEMP_3_MEDIAN_FILTER
+  #define TEMP_FILTER_3 temp_filter_median
+#else
+  #define TEMP_FILTER_3 temp_filter_mean
+#endif
+#ifdef TEMP_BED_MEDIAN_FILTER
+  #define TEMP_FILTER_4 temp_filter_median
+#else
+  #define TEMP_FILTER_4 temp_filter_mean
+#endif
+
 /**
  * Stages in the ISR loop
  */
@@ -1186,6 +1670,14 @@ enum TempState {
 // Timer 0 is shared with millies
 //
 HAL_TEMP_TIMER_ISR {
+  #ifdef ISR_PROFILING
+    IsrProfileScope isr_profile_scope(isr_profile_temp);
+    // The counter restarts on the RC compare, so it holds the entry latency.
+    // More than half a period late means the stepper ISR starved us.
+    TcChannel *tempChannel = TEMP_TIMER_COUNTER->TC_CHANNEL + TEMP_TIMER_CHANNEL;
+    if (tempChannel->TC_CV > tempChannel->TC_RC / 2) isr_profile_temp.late++;
+  #endif
+
   //these variables are only accesible from the ISR, but static, so they don't lose their value
   static unsigned char temp_count = 0;
   static unsigned long raw_temp_value[4] = { 0 };
@@ -1196,8 +1688,7 @@ HAL_TEMP_TIMER_ISR {
   static int min_temp[5] = { 123000 };
   static int temp_read = 0;
 
-  static unsigned char median_counter = 0;
-  static unsigned long raw_median_temp[5][MEDIAN_COUNT] = { { 3950 * OVERSAMPLENR } };
+  static temp_filter_t raw_filter[5];
   static bool first_start = true;
   // Static members for each heater
   #ifdef SLOW_PWM_HEATERS
@@ -1234,7 +1725,7 @@ HAL_TEMP_TIMER_ISR {
   {
     for (uint8_t i = 0; i < 5; i++)
     {
-      for (int j = 0; j < MEDIAN_COUNT; j++) raw_median_temp[i][j] = 3600 * OVERSAMPLENR;
+      temp_filter_init(raw_filter[i], 3600 * OVERSAMPLENR);
       max_temp[i] = 0;
       min_temp[i] = 123000;
     }
@@ -1243,6 +1734,8 @@ HAL_TEMP_TIMER_ISR {
   }
   
   HAL_timer_isr_status (TEMP_TIMER_COUNTER, TEMP_TIMER_CHANNEL);
+  HAL_adc_scan_update();
+
   #ifndef SLOW_PWM_HEATERS
     /**
      * standard PWM modulation
@@ -1403,12 +1896,18 @@ HAL_TEMP_TIMER_ISR {
   
   #endif // SLOW_PWM_HEATERS
   
-  #define READ_TEMP(temp_id) temp_read = getAdcFreerun(pinToAdcChannel(TEMP_## temp_id ##_PIN)); \
+  #ifdef HEATER_SIMULATION
+    #define READ_TEMP_ADC(temp_id, pin) heater_sim_adc[temp_id]
+  #else
+    #define READ_TEMP_ADC(temp_id, pin) HAL_adc_scan_average(pinToAdcChannel(pin))
+  #endif
+
+  #define READ_TEMP(temp_id) temp_read = READ_TEMP_ADC(temp_id, TEMP_## temp_id ##_PIN); \
     raw_temp_value[temp_id] += temp_read; \
     max_temp[temp_id] = max(max_temp[temp_id], temp_read); \
     min_temp[temp_id] = min(min_temp[temp_id], temp_read)
     
-  #define READ_BED_TEMP(temp_id) temp_read = getAdcFreerun(pinToAdcChannel(TEMP_BED_PIN)); \
+  #define READ_BED_TEMP(temp_id) temp_read = READ_TEMP_ADC(temp_id, TEMP_BED_PIN); \
     raw_temp_bed_value += temp_read; \
     max_temp[temp_id] = max(max_temp[temp_id], temp_read); \
     min_temp[temp_id] = min(min_temp[temp_id], temp_read)
@@ -1416,9 +1915,6 @@ HAL_TEMP_TIMER_ISR {
   // Prepare or measure a sensor, each one every 12th frame
   switch(temp_state) {
     case PrepareTemp_0:
-      #if HAS_TEMP_0
-        //START_TEMP(0);
-      #endif
       lcd_buttons_update();
       temp_state = MeasureTemp_0;
       break;
@@ -1430,9 +1926,6 @@ HAL_TEMP_TIMER_ISR {
       break;
 
     case PrepareTemp_BED:
-      #if HAS_TEMP_BED
-        //START_BED_TEMP();
-      #endif
       lcd_buttons_update();
       temp_state = MeasureTemp_BED;
       break;
@@ -1444,9 +1937,6 @@ HAL_TEMP_TIMER_ISR {
       break;
 
     case PrepareTemp_1:
-      #if HAS_TEMP_1
-        //START_TEMP(1)
-      #endif
       lcd_buttons_update();
       temp_state = MeasureTemp_1;
       break;
@@ -1458,9 +1948,6 @@ HAL_TEMP_TIMER_ISR {
       break;
 
     case PrepareTemp_2:
-      #if HAS_TEMP_2
-        //START_TEMP(2)
-      #endif
       lcd_buttons_update();
       temp_state = MeasureTemp_2;
       break;
@@ -1472,9 +1959,6 @@ HAL_TEMP_TIMER_ISR {
       break;
 
     case PrepareTemp_3:
-      #if HAS_TEMP_3
-        //START_TEMP(3)
-      #endif
       lcd_buttons_update();
       temp_state = MeasureTemp_3;
       break;
@@ -1486,18 +1970,15 @@ HAL_TEMP_TIMER_ISR {
       break;
 
     case Prepare_FILWIDTH:
-      #if HAS_FILAMENT_SENSOR
-      // nothing todo for Due
-      #endif
       lcd_buttons_update();
       temp_state = Measure_FILWIDTH;
       break;
     case Measure_FILWIDTH:
       #if HAS_FILAMENT_SENSOR
-        // raw_filwidth_value += ADC;  //remove to use an IIR filter approach
-        if (ADC > 102) { //check that ADC is reading a voltage > 0.5 volts, otherwise don't take in the data.
+        temp_read = HAL_adc_scan_average(pinToAdcChannel(FILWIDTH_PIN)) >> 2; // 10 bits, as the AVR ADC
+        if (temp_read > 102) { //check that ADC is reading a voltage > 0.5 volts, otherwise don't take in the data.
           raw_filwidth_value -= (raw_filwidth_value>>7);  //multiply raw_filwidth_value by 127/128
-          raw_filwidth_value += ((unsigned long)ADC<<7);  //add new ADC reading
+          raw_filwidth_value += ((unsigned long)temp_read<<7);  //add new ADC reading
         }
       #endif
       temp_state = PrepareTemp_0;
@@ -1514,24 +1995,13 @@ HAL_TEMP_TIMER_ISR {
     //   break;
   } // switch(temp_state)
 
-  #define SET_CURRENT_TEMP_RAW(temp_id) raw_median_temp[temp_id][median_counter] = (raw_temp_value[temp_id] - (min_temp[temp_id] + max_temp[temp_id])); \
-    sum = 0; \
-    for(int i = 0; i < MEDIAN_COUNT; i++) sum += raw_median_temp[temp_id][i]; \
-    current_temperature_raw[temp_id] = (sum / MEDIAN_COUNT + 4) >> 2
-      
-  #define SET_CURRENT_BED_RAW(temp_id) raw_median_temp[temp_id][median_counter] = (raw_temp_bed_value - (min_temp[temp_id] + max_temp[temp_id])); \
-    sum = 0; \
-    for(int i = 0; i < MEDIAN_COUNT; i++) sum += raw_median_temp[temp_id][i]; \
-    current_temperature_bed_raw = (sum / MEDIAN_COUNT + 4) >> 2
-    
-  #define SET_REDUNDANT_RAW(temp_id) raw_median_temp[temp_id][median_counter] = (raw_temp_bed_value - (min_temp[temp_id] + max_temp[temp_id])); \
-    sum = 0; \
-    for(int i = 0; i < MEDIAN_COUNT; i++) sum += raw_median_temp[temp_id][i]; \
-    redundant_temperature_raw = (sum / MEDIAN_COUNT + 4) >> 2
+  #define FILTER_RAW(temp_id, value) ((TEMP_FILTER_ ## temp_id(raw_filter[temp_id], (value) - (min_temp[temp_id] + max_temp[temp_id])) + 4) >> 2)
+  #define SET_CURRENT_TEMP_RAW(temp_id) current_temperature_raw[temp_id] = FILTER_RAW(temp_id, raw_temp_value[temp_id])
+  #define SET_CURRENT_BED_RAW(temp_id) current_temperature_bed_raw = FILTER_RAW(temp_id, raw_temp_bed_value)
+  #define SET_REDUNDANT_RAW(temp_id) redundant_temperature_raw = FILTER_RAW(temp_id, raw_temp_value[temp_id])
   
   if(temp_count >= OVERSAMPLENR + 2) { // 10 * 16 * 1/(16000000/64/256)  = 164ms.
     if (!temp_meas_ready) { //Only update the raw values if they have been read. Else we could be updating them during reading.
-      unsigned long sum = 0;
       #ifndef HEATER_0_USES_MAX6675
         SET_CURRENT_TEMP_RAW(0);
       #endif
@@ -1561,9 +2031,6 @@ HAL_TEMP_TIMER_ISR {
       current_raw_filwidth = raw_filwidth_value >> 10;  // Divide to get to 0-16384 range since we used 1/128 IIR filter approach
     #endif
 
-    median_counter++;
-    if (median_counter >= MEDIAN_COUNT) median_counter = 0;
-
     temp_meas_ready = true;
     temp_count = 0;
     for (int i = 0; i < 4; i++) raw_temp_value[i] = 0;
@@ -1626,17 +2093,41 @@ HAL_TEMP_TIMER_ISR {
       int curTodo = babystepsTodo[axis]; //get rid of volatile for performance
      
       if (curTodo > 0) {
+        // The stepper ISR has priority, keep it out while the DIR pins are borrowed
+        CRITICAL_SECTION_START;
         babystep(axis,/*fwd*/true);
+        CRITICAL_SECTION_END;
         babystepsTodo[axis]--; //fewer to do next time
       }
       else if (curTodo < 0) {
+        CRITICAL_SECTION_START;
         babystep(axis,/*fwd*/false);
+        CRITICAL_SECTION_END;
         babystepsTodo[axis]++; //fewer to do next time
       }
     }
   #endif //BABYSTEPPING
 }
 
+#ifdef BABYSTEPPING
+
+  /**
+   * Queue babysteps on one axis, applied by the temperature ISR a step per tick.
+   *
+   * Babysteps only pulse the motor. count_position and the planner position
+   * are left untouched, so they keep agreeing with each other and the
+   * queue never stalls; the physical machine shifts relative to its
+   * coordinates like a live home offset.
+   */
+  void babystep_axis(const AxisEnum axis, const int distance) {
+    CRITICAL_SECTION_START;
+    babystepsTodo[axis] += distance;
+    CRITICAL_SECTION_END;
+    babystepsTotal[axis] += distance;
+  }
+
+#endif //BABYSTEPPING
+
 #ifdef PIDTEMP
   // Apply the scale factors to the PID values
   float scalePID_i(float i)   { return i * PID_dT; }
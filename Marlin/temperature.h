@@ -76,9 +76,28 @@ extern float current_temperature_bed;
 #ifdef PIDTEMPBED
   extern float bedKp,bedKi,bedKd;
 #endif
+
+#ifdef MPCTEMP
+  // Thermal model of a hotend, set with M306
+  typedef struct {
+    float heater_power;                 // P: W
+    float block_heat_capacity;          // C: J/K
+    float sensor_responsiveness;        // R: 1/s
+    float ambient_xfer_coeff_fan0;      // A: W/K with the fan off
+    float fan255_adjustment;            // F - A: extra W/K with the fan at full speed
+    float filament_heat_capacity_permm; // H: J/K per mm of filament
+  } mpc_t;
+
+  extern mpc_t mpc[EXTRUDERS];
+
+  void MPC_autotune(int e, float temp);
+  void MPC_print(int e);
+#endif
   
 #ifdef BABYSTEPPING
   extern volatile int babystepsTodo[3];
+  extern long babystepsTotal[3];  // Babysteps queued since the axis was homed
+  void babystep_axis(const AxisEnum axis, const int distance);
 #endif
   
 //high level conversion routines, for use outside of temperature.cpp
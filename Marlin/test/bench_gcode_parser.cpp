@@ -0,0 +1,143 @@
+/**
+ * bench_gcode_parser.cpp - Host benchmark of the G-code argument parsing
+ *
+ *   bench_gcode_parser [file.gcode]
+ *
+ * Times the G0/G1 lines of the file, or of a generated stream like a slicer's,
+ * through what gcode_get_destination() asks for: code_seen() and code_value()
+ * for X, Y, Z, E and F. Once with parse_command_args() and lookups, once with
+ * the strchr() and strtod() of each call that it replaced. Both must agree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define MARLIN_H // Only the parser, without the Arduino core
+#include "macros.h"
+#define MAX_CMD_SIZE 96
+#include "gcode_parser.cpp"
+
+static const char axis_codes[] = { 'X', 'Y', 'Z', 'E', 'F' };
+
+// The arguments of a G0/G1 line, found as process_next_command() does, without a comment or checksum
+static bool g0_g1_args(const char *line, std::string &args) {
+  std::string l(line);
+  l.erase(std::min(l.find_first_of(";*\r\n"), l.size()));
+  const char *p = l.c_str();
+  while (*p == ' ') p++;
+  if (*p == 'N') while (*p && *p != ' ') p++;
+  while (*p == ' ') p++;
+  if (p[0] != 'G' || !NUMERIC(p[1]) || gcode_strtol(p + 1) > 1) return false;
+  while (*p && *p != ' ') p++;
+  while (*p == ' ') p++;
+  args = p;
+  return true;
+}
+
+// code_seen() and code_value() as they were, with a strchr() and a strtod() each call
+static char *current_command_args, *seen_pointer;
+
+static bool old_code_seen(char code) {
+  seen_pointer = strchr(current_command_args, code);
+  return seen_pointer != NULL;
+}
+
+static float old_code_value() {
+  float ret;
+  char *e = strchr(seen_pointer, 'E');
+  if (e) {
+    *e = 0;
+    ret = strtod(seen_pointer + 1, NULL);
+    *e = 'E';
+  }
+  else
+    ret = strtod(seen_pointer + 1, NULL);
+  return ret;
+}
+
+static void old_get_destination(char *args, float dest[5]) {
+  current_command_args = args;
+  for (int i = 0; i < 5; i++) dest[i] = old_code_seen(axis_codes[i]) ? old_code_value() : 0;
+}
+
+static command_args_t command_args;
+
+static void new_get_destination(char *args, float dest[5]) {
+  parse_command_args(command_args, args);
+  for (int i = 0; i < 5; i++) {
+    uint8_t l = axis_codes[i] - 'A';
+    dest[i] = TEST(command_args.seen, l) ? command_args.value[l] : 0;
+  }
+}
+
+// A stream like a slicer's perimeters and infill
+static void generate(std::vector<std::string> &lines) {
+  char buf[MAX_CMD_SIZE];
+  float x = 100, y = 100, e = 0;
+  srand(1);
+  for (int i = 0; i < 20000; i++) {
+    x += (rand() % 2001 - 1000) / 100.0;
+    y += (rand() % 2001 - 1000) / 100.0;
+    e += (rand() % 1000) / 10000.0;
+    if (i % 50 == 0)
+      sprintf(buf, "G1 Z%.3f F9000", i / 50 * 0.2 + 0.3);
+    else if (i % 7 == 0)
+      sprintf(buf, "G0 F9000 X%.3f Y%.3f", x, y);
+    else
+      sprintf(buf, "G1 X%.3f Y%.3f E%.5f", x, y, e);
+    lines.push_back(buf);
+  }
+}
+
+// Nanoseconds per line
+static double bench(void (*get_destination)(char*, float*), std::vector<std::string> &args, int rounds) {
+  std::vector<char*> lines;
+  for (size_t i = 0; i < args.size(); i++) lines.push_back(&args[i][0]);
+  float dest[5];
+  volatile float sink = 0;
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++)
+    for (size_t i = 0; i < lines.size(); i++) {
+      get_destination(lines[i], dest);
+      sink = sink + dest[0];
+    }
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds / lines.size();
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> lines, args;
+  if (argc > 1) {
+    FILE *f = fopen(argv[1], "r");
+    if (!f) { perror(argv[1]); return 2; }
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f)) lines.push_back(buf);
+    fclose(f);
+  }
+  else
+    generate(lines);
+
+  std::string a;
+  for (size_t i = 0; i < lines.size(); i++)
+    if (g0_g1_args(lines[i].c_str(), a) && a.size() < MAX_CMD_SIZE) args.push_back(a);
+  if (args.empty()) { puts("No G0/G1 lines"); return 2; }
+
+  int bad = 0;
+  for (size_t i = 0; i < args.size(); i++) {
+    std::string a1 = args[i], a2 = args[i];
+    float d1[5], d2[5];
+    old_get_destination(&a1[0], d1);
+    new_get_destination(&a2[0], d2);
+    if (memcmp(d1, d2, sizeof(d1)) && bad++ < 5) printf("Differs: %s\n", args[i].c_str());
+  }
+
+  const int rounds = 2000000 / args.size() + 1;
+  const double old_ns = bench(old_get_destination, args, rounds), new_ns = bench(new_get_destination, args, rounds);
+  printf("%d G0/G1 lines: strchr+strtod %.0f ns/line, parse once %.0f ns/line, %.1fx\n",
+         (int)args.size(), old_ns, new_ns, old_ns / new_ns);
+  return bad != 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * bench_numtostr.cpp - Host benchmark of the float formatting for serial output
+ *
+ * Times ftostr_fixed() against Print::printFloat() of the Arduino core, as it
+ * wrote the same digits to a buffer, over the kind of values M105 and M114
+ * report. A host has a double precision FPU, which the Due doesn't, so there
+ * printFloat()'s software doubles cost relatively more than measured here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define MARLIN_H // Only the conversion, without the Arduino core
+#include "macros.h"
+#include "numtostr.cpp"
+
+// Print::printFloat() and the printNumber() it calls, writing to buf
+static char *print_number(char *buf, unsigned long n) {
+  char digits[8 * sizeof(long) + 1], *str = &digits[sizeof(digits) - 1];
+  *str = '\0';
+  do {
+    unsigned long m = n;
+    n /= 10;
+    *--str = m - 10 * n + '0';
+  } while (n);
+  size_t len = strlen(str);
+  memcpy(buf, str, len + 1);
+  return buf + len;
+}
+
+static char *print_float(char *buf, double number, uint8_t digits) {
+  if (isnan(number)) { strcpy(buf, "nan"); return buf + 3; }
+  if (isinf(number)) { strcpy(buf, "inf"); return buf + 3; }
+  if (number > 4294967040.0 || number < -4294967040.0) { strcpy(buf, "ovf"); return buf + 3; }
+  if (number < 0.0) {
+    *buf++ = '-';
+    number = -number;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) rounding /= 10.0;
+  number += rounding;
+  unsigned long int_part = (unsigned long)number;
+  double remainder = number - (double)int_part;
+  buf = print_number(buf, int_part);
+  if (digits > 0) *buf++ = '.';
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    int toPrint = int(remainder);
+    buf = print_number(buf, toPrint);
+    remainder -= toPrint;
+  }
+  return buf;
+}
+
+#define VALUES 4096
+
+// Nanoseconds per conversion
+static double bench(const float *values, uint8_t places, bool fixed) {
+  const int rounds = 500;
+  char buf[FTOSTR_SIZE + 8];
+  volatile char sink = 0;
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < VALUES; i++)
+      sink = sink + *(fixed ? ftostr_fixed(buf, values[i], places) - 1 : print_float(buf, values[i], places) - 1);
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds / VALUES;
+}
+
+int main() {
+  static float temps[VALUES], positions[VALUES];
+  srand(1);
+  for (int i = 0; i < VALUES; i++) {
+    temps[i] = 20 + rand() % 24000 / 100.0f;               // 20.00 - 259.99 °C
+    positions[i] = (rand() % 400000 - 100000) / 1000.0f;    // -100 - 300 mm
+  }
+
+  printf("                        Print::printFloat  ftostr_fixed\n");
+  printf("temperatures, 2 places  %8.1f ns   %8.1f ns\n", bench(temps, 2, false), bench(temps, 2, true));
+  printf("positions, 2 places     %8.1f ns   %8.1f ns\n", bench(positions, 2, false), bench(positions, 2, true));
+  printf("positions, 3 places     %8.1f ns   %8.1f ns\n", bench(positions, 3, false), bench(positions, 3, true));
+  return 0;
+}
@@ -0,0 +1,253 @@
+/**
+ * pty_printer.cpp - The serial input of the firmware behind a pty, for the host tests
+ *
+ * Opens a pty, prints the name of its slave side and runs command_queue.cpp,
+ * binary_gcode.cpp and gcode_parser.cpp behind it. The bytes the host writes
+ * reach a receive buffer of --rx-buffer bytes at --baud, as from the UART,
+ * and those that find it full are lost. The loop reads the buffer while the
+ * command queue has room, as loop() does, and runs the oldest command:
+ * parsed, then taking --exec-us. G0-G3 each go to a stub planner of
+ * BLOCK_BUFFER_SIZE blocks, waiting for a free one, and the stub stepper takes
+ * --move-us for each block. Text commands are answered by ok_to_send(), with
+ * ADVANCED_OK. M115 reports the receive buffer. With --noise, that fraction of
+ * frames has a bit flipped and that fraction of acks is lost.
+ *
+ * Once stdin is closed and the commands received have run, the binary ones
+ * are printed in hex, one per line, then "overflow <bytes lost>" and
+ * "starved <times the planner ran empty and was then given a move>".
+ *
+ *   pty_printer [--rx-buffer 127] [--baud 250000] [--exec-us 0] [--move-us 0] [--noise 0]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define MARLIN_H // Only the serial input, without the Arduino core
+#include "macros.h"
+#define MAX_CMD_SIZE 96
+#define BUFSIZE 16
+#define CMD_BUFFER_BYTES 384
+#define BLOCK_BUFFER_SIZE 16
+#define ADVANCED_OK
+#define BINARY_GCODE
+#define BINARY_GCODE_WINDOW 4
+#define BINARY_FRAME_SYNC 0xFE
+#define min(a,b) ((a)<(b)?(a):(b))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// The output goes to the pty a line at a time, so acks can be lost
+static int pty_fd;
+static double noise = 0;
+static std::string out_line;
+
+static void serial_print(const char *s) { out_line += s; }
+static void serial_print(long l) { out_line += std::to_string(l); }
+static void serial_print(int i) { serial_print((long)i); }
+static void serial_eol() {
+  out_line += '\n';
+  if (!(out_line.compare(0, 4, "ack:") == 0 && drand48() < noise))
+    if (write(pty_fd, out_line.data(), out_line.size()) < 0) exit(1);
+  out_line.clear();
+}
+#define PSTR(s) s
+#define strstr_P strstr
+#define serialprintPGM(s) serial_print(s)
+#define SERIAL_EOL serial_eol()
+#define SERIAL_PROTOCOL(x) serial_print(x)
+#define SERIAL_PROTOCOLPGM(x) serial_print(x)
+#define SERIAL_PROTOCOLLN(x) do{ serial_print(x); serial_eol(); }while(0)
+#define SERIAL_PROTOCOLLNPGM(x) SERIAL_PROTOCOLLN(x)
+#define SERIAL_ERROR_START serial_print("Error:")
+#define SERIAL_ERRORLN(x) SERIAL_PROTOCOLLN(x)
+#define SERIAL_ERRORLNPGM(x) SERIAL_PROTOCOLLN(x)
+
+// Flushing waits for the output to go, which it has
+static struct { void flush() {} } host_serial;
+#define MYSERIAL host_serial
+
+#define LCD_MESSAGEPGM(x) do{}while(0)
+#define ULTRALCD_H
+#define CONFIGURATION_H // language.h without the configuration, for no board
+#define MB(board) 0
+static bool IsStopped() { return false; }
+static void kill(const char *) { exit(1); }
+static void refresh_cmd_timeout() {}
+void ok_to_send();
+
+// The planner: a count of blocks, each taking move_us once it's the oldest
+#define PLANNER_H
+static uint8_t blocks_planned = 0;
+static uint8_t movesplanned() { return blocks_planned; }
+
+// The receive buffer, from the UART
+static std::vector<uint8_t> rx;
+static size_t rx_head = 0;
+static bool corrupt = false;
+
+#include "gcode_parser.cpp"
+#include "binary_gcode.cpp"
+
+static int rx_available() { return rx.size() - rx_head; }
+static uint8_t rx_read() {
+  uint8_t c = rx[rx_head++];
+  if (!binary_frame_count && c == BINARY_FRAME_SYNC) corrupt = drand48() < noise;
+  if (corrupt && binary_frame_count == 3) c ^= 1;
+  return c;
+}
+#define SERIAL_IN_AVAILABLE() rx_available()
+#define SERIAL_IN_READ() rx_read()
+
+#include "command_queue.cpp"
+
+static unsigned long micros_now() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000UL + t.tv_nsec / 1000;
+}
+
+static long rx_size = 127;
+static std::vector<std::string> commands_run;
+
+/**
+ * Parse the oldest command as process_next_command() does and run it,
+ * or return false if it's a move and the planner is full.
+ */
+static bool run_command(char *command) {
+  command_args_t args;
+  char code, *text;
+  int codenum;
+  if (IS_BINARY_COMMAND(command)) {
+    code = command[2];
+    codenum = parse_binary_command(args, command, &text);
+  }
+  else {
+    // Skip the line number, end at the checksum
+    while (*command == ' ') command++;
+    if (*command == 'N') while (*command && *command != ' ') command++;
+    while (*command == ' ') command++;
+    char *starpos = strchr(command, '*');
+    if (starpos) *starpos = '\0';
+    code = *command;
+    codenum = gcode_strtol(command + 1);
+    char *p = command + 1;
+    while (NUMERIC(*p)) p++;
+    parse_command_args(args, p, code == 'M' && codenum == 117 ? p : NULL);
+  }
+
+  if (code == 'G' && codenum >= 0 && codenum <= 3) {
+    if (blocks_planned >= BLOCK_BUFFER_SIZE - 1) return false;
+    blocks_planned++;
+  }
+  else if (code == 'M' && codenum == 115) {
+    SERIAL_PROTOCOLPGM("Cap:RX_BUFFER:");
+    SERIAL_PROTOCOLLN((int)rx_size);
+  }
+
+  if (IS_BINARY_COMMAND(command)) {
+    std::string hex;
+    char digits[3];
+    for (uint8_t i = 0; i < (uint8_t)command[1]; i++) {
+      sprintf(digits, "%02x", (uint8_t)command[2 + i]);
+      hex += digits;
+    }
+    commands_run.push_back(hex);
+  }
+  else
+    ok_to_send();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  long baud = 250000, exec_us = 0, move_us = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--rx-buffer")) rx_size = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "--baud")) baud = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "--exec-us")) exec_us = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "--move-us")) move_us = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "--noise")) noise = atof(argv[i + 1]);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  srand48(2);
+
+  int slave; // Held open, so reads never fail between the host's opens
+  char name[64];
+  termios raw;
+  cfmakeraw(&raw);
+  if (openpty(&pty_fd, &slave, name, &raw, NULL) < 0) return 1;
+  fcntl(pty_fd, F_SETFL, O_NONBLOCK);
+  printf("%s\n", name);
+  fflush(stdout);
+
+  std::vector<uint8_t> wire; // Sent by the host and not yet received
+  unsigned long overflow = 0, starved = 0, uart_us = micros_now(), done_us = 0, block_us = 0;
+  bool closed = false, ran_dry = false;
+
+  for (;;) {
+    pollfd fds[2] = { { pty_fd, POLLIN, 0 }, { 0, POLLIN, 0 } };
+    const bool busy = wire.size() || ((commands_in_queue || blocks_planned) && !exec_us && !move_us);
+    if (poll(fds, closed ? 1 : 2, busy ? 0 : 1) < 0) return 1;
+    if (fds[1].revents) closed = true;
+    if (closed && wire.empty() && !rx_available() && !commands_in_queue && !blocks_planned) break;
+
+    uint8_t buf[4096];
+    ssize_t n = read(pty_fd, buf, sizeof(buf));
+    if (n > 0) wire.insert(wire.end(), buf, buf + n);
+
+    // The UART takes a byte every 10 bits, dropping it if the buffer is full
+    unsigned long now = micros_now();
+    if (wire.empty()) uart_us = now;
+    size_t arrived = 0;
+    while (arrived < wire.size() && (now - uart_us) * baud >= 10000000UL * (arrived + 1)) {
+      if (rx_available() < rx_size) rx.push_back(wire[arrived]); else overflow++;
+      arrived++;
+    }
+    wire.erase(wire.begin(), wire.begin() + arrived);
+    uart_us += arrived * 10000000UL / baud;
+
+    // The stepper finishes the oldest block
+    if (blocks_planned && now >= block_us) {
+      if (--blocks_planned) block_us = now + move_us; else ran_dry = true;
+    }
+
+    // loop(): read while the queue isn't nearly full
+    if (commands_in_queue < BUFSIZE - 1) get_serial_commands();
+    if (!rx_available()) {
+      rx.clear();
+      rx_head = 0;
+    }
+
+    // process_next_command(), each taking exec_us
+    if (commands_in_queue && now >= done_us) {
+      const uint8_t planned = blocks_planned;
+      if (run_command(QUEUED_COMMAND(cmd_queue_index_r))) {
+        cmd_queue_pop();
+        done_us = now + exec_us;
+      }
+      if (!planned && blocks_planned) {
+        if (ran_dry) starved++;
+        ran_dry = false;
+        block_us = now + move_us;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < commands_run.size(); i++) printf("%s\n", commands_run[i].c_str());
+  printf("overflow %lu\n", overflow);
+  printf("starved %lu\n", starved);
+  return 0;
+}
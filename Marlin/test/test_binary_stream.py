@@ -0,0 +1,89 @@
+#!/usr/bin/python3
+
+# Pty test of the BINARY_GCODE framing. scripts/binary_gcode.py streams a generated print
+# through a pty to pty_printer, which runs the firmware's serial input behind a 127 byte
+# receive buffer.
+# Some frames are corrupted and some acks lost, and every command must still arrive once and
+# in order. With the printer slower than the port, so the receive buffer fills, no byte may
+# be lost; and none is only because the stream keeps to the buffer: sent as if it were
+# larger, bytes are lost. Throughput is reported against the same commands as text, though
+# over a pty it's bounded by the simulated baud rate and Python.
+#
+#   test_binary_stream.py [--commands 5000] [--window 4]
+
+import argparse
+import os
+import random
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'scripts'))
+import binary_gcode  # noqa: E402
+
+RX_BUFFER = 127  # SERIAL_RX_BUFFER_BYTES of the Due's UART
+
+
+def generated_print(count):
+    rnd = random.Random(1)
+    lines, e = ['G28', 'M117 Printing', 'G1 Z0.2 F9000'], 0.0
+    while len(lines) < count:
+        e += rnd.uniform(0.01, 2)
+        lines.append('G1 X%.3f Y%.3f E%.5f' % (rnd.uniform(0, 200), rnd.uniform(0, 200), e))
+        if rnd.random() < 0.05:
+            lines.append('G1 X%.3f Y%.3f Z%.2f E%.5f F%d' % (rnd.uniform(0, 200), rnd.uniform(0, 200),
+                                                            rnd.uniform(0, 10), e, rnd.choice((4800, 9000))))
+    return lines
+
+
+def run(title, payloads, window, rx_buffer, noise=0, exec_us=0, baud=1000000):
+    """Stream the payloads to a pty_printer, returning the commands it ran and the bytes it lost."""
+    printer = subprocess.Popen([os.path.join(HERE, 'pty_printer'), '--rx-buffer', str(RX_BUFFER), '--baud', str(baud),
+                                '--exec-us', str(exec_us), '--noise', str(noise)],
+                               stdin=subprocess.PIPE, stdout=subprocess.PIPE, universal_newlines=True)
+    path = printer.stdout.readline().strip()
+    print('%s:' % title, end=' ', flush=True)
+    binary_gcode.stream(binary_gcode.Port(path, 250000), list(payloads), window, 0.2, rx_buffer)
+    out = printer.communicate('')[0].splitlines()
+    stats = dict(line.split() for line in out if ' ' in line)
+    return [bytes.fromhex(c) for c in out if ' ' not in c], int(stats['overflow'])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Test binary G-code streaming over a pty.')
+    parser.add_argument('--commands', type=int, default=5000)
+    parser.add_argument('--window', type=int, default=4)
+    args = parser.parse_args()
+
+    lines = generated_print(args.commands)
+    payloads = [binary_gcode.encode(line) for line in lines]
+    text_bytes = sum(len(line) + 1 for line in lines)
+
+    # G1 X Y Z E F, 33 bytes a frame: a window of them is more than the receive buffer
+    rnd = random.Random(3)
+    large = [binary_gcode.encode('G1 X%.3f Y%.3f Z%.2f E%.5f F%d' % (rnd.uniform(0, 200), rnd.uniform(0, 200),
+                                                                    rnd.uniform(0, 10), i * 0.1, 4800)) for i in range(500)]
+    window_bytes = args.window * (len(large[0]) + 5)
+
+    failed = False
+    for title, sent, rx_buffer, noise, exec_us, lossy in (
+            ('Clean frames', payloads, RX_BUFFER, 0, 0, False),
+            ('1% bad frames', payloads, RX_BUFFER, 0.01, 0, False),
+            ('Slow printer, large frames', large, RX_BUFFER, 0, 2000, False),
+            ('Same, the window not kept to the buffer', large, window_bytes, 0, 2000, True)):
+        commands, lost = run(title, sent, args.window, rx_buffer, noise, exec_us)
+        if commands != sent:
+            print('  %d of %d commands received, or out of order' % (len(commands), len(sent)))
+            failed = True
+        if lost:
+            print('  %d bytes lost in the receive buffer' % lost)
+        if bool(lost) != lossy:
+            failed = True
+
+    frame_bytes = sum(len(binary_gcode.frame(0, p)) for p in payloads)
+    print('%d bytes as text, %d in frames (%.0f%%)' % (text_bytes, frame_bytes, frame_bytes * 100 / text_bytes))
+    return failed
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,101 @@
+/**
+ * test_gcode_parser.cpp - Host test of the G-code number parsing
+ *
+ * gcode_strtof() must give exactly (float)strtod() and gcode_strtol() exactly
+ * strtol() of the same G-code number, up to the first character that isn't
+ * part of one. Checked over a corpus of edge cases, every number of up to 6
+ * digits at every decimal place, and random numbers of up to 24 digits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MARLIN_H // Only the parser, without the Arduino core
+#include "macros.h"
+#define MAX_CMD_SIZE 96
+#include "gcode_parser.cpp"
+
+static const char *corpus[] = {
+  "0", "-0", "+0", "0.", "-0.", ".0", "-.0", ".", "-.", "-", "+", "", " ", "  12", " -3.5",
+  "1", "-1", "+1", "10", "0.1", "0.2", "0.3", "0.7", "1.1", "-0.05", "+.5", "007", "00.100",
+  "123.456", "-123.456", "9999.9999", "0.000001", "0.0000001", "0.00000000001", "1.00000000000000",
+  "16777215", "16777216", "16777217", "1677721.5", "167772.15", "0.16777215", "0.16777216",
+  "2147483646", "2147483647", "2147483648", "-2147483647", "-2147483648", "2147483640",
+  "99999999999", "-99999999999", "12345678901234567890", "1.2345678901234567890",
+  "5E2", "5e2", "1.5E-3", "0x10", "1.2.3", "--5", "+-5", "- 5", "12X3", "3.14159;comment",
+  "210*23", "35 ", "inf", "nan", "1,5", "20.0045", "0.0125", "1.0125", "0.8125", "1.45"
+};
+
+// The G-code number at the start of s: strtod() and strtol() would also read exponents and hex
+static void gcode_number(const char *s, char *num) {
+  size_t n = strspn(s, " ");
+  n += strspn(s + n, "+-.0123456789");
+  memcpy(num, s, n);
+  num[n] = 0;
+}
+
+// strtol() saturating at 32 bits, with the Due's range
+static long strtol32(const char *s) {
+  long long l = strtoll(s, NULL, 10);
+  return l > 2147483647LL ? 2147483647L : l < -2147483647LL ? -2147483647L : (long)l;
+}
+
+static long checked, bad;
+
+static void check(const char *s) {
+  char num[MAX_CMD_SIZE];
+  gcode_number(s, num);
+  float want = strtod(num, NULL);
+  long want_l = strtol32(num), ival;
+  float got = gcode_strtof(s, &ival);
+  long got_l = gcode_strtol(s);
+  checked++;
+  if (memcmp(&got, &want, sizeof(float)) || ival != want_l || got_l != want_l) {
+    if (bad++ < 10)
+      printf("\"%s\": gcode_strtof %.9g (%ld), gcode_strtol %ld, strtod %.9g, strtol %ld\n",
+             s, got, ival, got_l, want, want_l);
+  }
+}
+
+// Every number of up to `digits` digits, with the point at each place
+static void check_all(int digits) {
+  char s[32];
+  long limit = 1;
+  for (int i = 0; i < digits; i++) limit *= 10;
+  for (long m = 0; m < limit; m++) {
+    for (int places = 0; places <= digits; places++) {
+      char d[16];
+      int n = sprintf(d, "%0*ld", places + 1, m);
+      sprintf(s, "%s%.*s.%s", m & 1 ? "-" : "", n - places, d, d + n - places);
+      check(s);
+    }
+  }
+}
+
+static void check_random(long count) {
+  static const char tail[] = " XYZEF*;.";
+  srand(1);
+  for (long i = 0; i < count; i++) {
+    char s[64], *p = s;
+    if (rand() % 3 == 0) *p++ = rand() & 1 ? '-' : '+';
+    int int_digits = rand() % 13, frac_digits = rand() % 13;
+    for (int d = 0; d < int_digits; d++) *p++ = '0' + rand() % 10;
+    if (frac_digits || rand() & 1) {
+      *p++ = '.';
+      for (int d = 0; d < frac_digits; d++) *p++ = '0' + rand() % 10;
+    }
+    if (rand() & 1) *p++ = tail[rand() % (sizeof(tail) - 1)];
+    *p = 0;
+    check(s);
+  }
+}
+
+int main() {
+  for (unsigned i = 0; i < COUNT(corpus); i++) check(corpus[i]);
+  check_all(6);
+  check_random(2000000);
+  printf("gcode_parser: %ld numbers, %ld differ from strtod/strtol\n", checked, bad);
+  return bad != 0;
+}
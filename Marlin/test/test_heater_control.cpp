@@ -0,0 +1,337 @@
+/**
+ * test_heater_control.cpp - Host test of the hotend control on the simulated heater
+ *
+ * Runs pid_step(), thermal_runaway_step() and the heating watch of heater_control.h
+ * against the plant of heater_sim.h, read through the thermistor table with ADC
+ * noise, oversampling and the mean filter the way the temperature ISR and
+ * manage_heater() do under HEATER_SIMULATION. It checks:
+ *
+ *  - The heat-up time from ambient to within TEMP_HYSTERESIS of the target
+ *  - The overshoot past the target after that
+ *  - The detection latency of a heater that stops heating or a thermistor that
+ *    falls out, once at the target and while heating up
+ *  - The false positive rate of the protection over simulated prints with the
+ *    part fan and the target changing
+ *
+ * The settings are the defaults of Configuration.h and Configuration_adv.h. To try
+ * another heater or tuning, override them and the limits with -D, for example
+ *
+ *   make clean test_heater_control HEATER="-DSIM_HOTEND_POWER=30 -DMAX_HEATUP_TIME=150"
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MARLIN_H // Only the tables and the control logic, without the Arduino core
+#define PROGMEM
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+typedef unsigned long millis_t;
+
+// Configuration.h
+#ifndef TEMP_SENSOR_0
+  #define TEMP_SENSOR_0 1
+#endif
+#define THERMISTORHEATER_0 TEMP_SENSOR_0
+#ifndef TEMP_HYSTERESIS
+  #define TEMP_HYSTERESIS 3
+#endif
+#ifndef HEATER_0_MAXTEMP
+  #define HEATER_0_MAXTEMP 275
+#endif
+#define PIDTEMP
+#ifndef BANG_MAX
+  #define BANG_MAX 255
+#endif
+#ifndef PID_MAX
+  #define PID_MAX BANG_MAX
+#endif
+#ifndef PID_FUNCTIONAL_RANGE
+  #define PID_FUNCTIONAL_RANGE 10
+#endif
+#ifndef PID_INTEGRAL_DRIVE_MAX
+  #define PID_INTEGRAL_DRIVE_MAX PID_MAX
+#endif
+#ifndef K1
+  #define K1 0.95
+#endif
+#ifndef DEFAULT_Kp
+  #define DEFAULT_Kp 22.2
+  #define DEFAULT_Ki 1.08
+  #define DEFAULT_Kd 114
+#endif
+#define THERMAL_PROTECTION_HOTENDS
+
+// Configuration_adv.h
+#ifndef THERMAL_PROTECTION_PERIOD
+  #define THERMAL_PROTECTION_PERIOD 40
+#endif
+#ifndef THERMAL_PROTECTION_HYSTERESIS
+  #define THERMAL_PROTECTION_HYSTERESIS 4
+#endif
+#ifndef WATCH_TEMP_PERIOD
+  #define WATCH_TEMP_PERIOD 16
+#endif
+#ifndef WATCH_TEMP_INCREASE
+  #define WATCH_TEMP_INCREASE 4
+#endif
+#ifndef MEDIAN_COUNT
+  #define MEDIAN_COUNT 10
+#endif
+#ifndef SIM_AMBIENT_TEMP
+  #define SIM_AMBIENT_TEMP 25.0
+#endif
+#ifndef SIM_HOTEND_POWER
+  #define SIM_HOTEND_POWER 40.0
+#endif
+#ifndef SIM_HOTEND_HEAT_CAPACITY
+  #define SIM_HOTEND_HEAT_CAPACITY 16.0
+#endif
+#ifndef SIM_HOTEND_LOSS
+  #define SIM_HOTEND_LOSS 0.07
+#endif
+#ifndef SIM_HOTEND_FAN_LOSS
+  #define SIM_HOTEND_FAN_LOSS 0.03
+#endif
+#ifndef SIM_HOTEND_SENSOR_LAG
+  #define SIM_HOTEND_SENSOR_LAG 1.5
+#endif
+#ifndef SIM_ADC_NOISE
+  #define SIM_ADC_NOISE 2
+#endif
+
+// HAL.h and temperature.cpp
+#define TEMP_FREQUENCY 2000
+#define PID_dT (((OVERSAMPLENR + 2) * 12.0)/ TEMP_FREQUENCY)
+
+// The limits checked
+#ifndef MAX_HEATUP_TIME
+  #define MAX_HEATUP_TIME 110       // s from ambient to 200°C
+#endif
+#ifndef MAX_HEATUP_TIME_FAN
+  #define MAX_HEATUP_TIME_FAN 160   // s from ambient to 240°C with the part fan at full speed
+#endif
+#ifndef MAX_OVERSHOOT
+  #define MAX_OVERSHOOT 3.0         // °C
+#endif
+#ifndef MAX_RUNAWAY_LATENCY
+  #define MAX_RUNAWAY_LATENCY (THERMAL_PROTECTION_PERIOD + 15) // s from a fault at the target to the error
+#endif
+#ifndef MAX_WATCH_LATENCY
+  #define MAX_WATCH_LATENCY (2 * WATCH_TEMP_PERIOD + 1)       // s from a fault while heating to the error
+#endif
+#ifndef MAX_FALSE_POSITIVE_RATE
+  #define MAX_FALSE_POSITIVE_RATE 0.0 // Of the simulated prints
+#endif
+#define PRINTS 200
+#define PRINT_TIME 1800 // s
+
+#include "thermistortables.h"
+#include "thermistor_lookup.h"
+#include "heater_sim.h"
+#include "heater_control.h"
+
+static float slope[HEATER_0_TEMPTABLE_LEN];
+
+enum Fault { NO_FAULT, HEATER_FAULT, SENSOR_FAULT };
+
+typedef struct {
+  heater_sim_t plant;
+  unsigned long filter[MEDIAN_COUNT], filter_sum;
+  uint8_t filter_index;
+  bool filter_ready;
+  float temperature, target, fan;
+  int soft_pwm;
+  pid_state_t pid;
+  TRState tr_state;
+  millis_t tr_timer;
+  float tr_target;
+  int watch_target;
+  millis_t watch_next_ms;
+  Fault fault;
+  millis_t ms;
+  const char *error;
+} hotend_t;
+
+static void hotend_init(hotend_t &h) {
+  h.plant.block_temp = h.plant.sensor_temp = SIM_AMBIENT_TEMP;
+  h.filter_ready = false;
+  h.target = h.fan = 0;
+  h.soft_pwm = 0;
+  h.pid.iState = h.pid.dState = h.pid.pTerm = h.pid.iTerm = h.pid.dTerm = 0;
+  h.pid.iState_min = 0;
+  h.pid.iState_max = PID_INTEGRAL_DRIVE_MAX / (DEFAULT_Ki * PID_dT);
+  h.pid.reset = false;
+  h.tr_state = TRReset;
+  h.tr_timer = 0;
+  h.tr_target = 0;
+  h.watch_next_ms = 0;
+  h.fault = NO_FAULT;
+  h.ms = 0;
+  h.error = NULL;
+}
+
+// M104
+static void set_target(hotend_t &h, const float target) {
+  h.target = target;
+  watch_heater_start(h.temperature, h.target, h.ms, &h.watch_target, &h.watch_next_ms);
+}
+
+// The readings of one temperature sample, summed without the highest and the lowest as the ISR does
+static unsigned long read_sensor(const hotend_t &h) {
+  const long raw = temptable_reverse_lookup(HEATER_0_TEMPTABLE, HEATER_0_TEMPTABLE_LEN, h.plant.sensor_temp) * 4 / OVERSAMPLENR;
+  long sum = 0, lo = 4095, hi = 0;
+  for (uint8_t i = 0; i < OVERSAMPLENR + 2; i++) {
+    long adc = raw + rand() % (2 * SIM_ADC_NOISE + 1) - SIM_ADC_NOISE;
+    if (adc < 0) adc = 0; else if (adc > 4095) adc = 4095;
+    sum += adc;
+    if (adc < lo) lo = adc;
+    if (adc > hi) hi = adc;
+  }
+  return sum - lo - hi;
+}
+
+// One temperature sample: the plant runs for PID_dT, then manage_heater()
+static void step(hotend_t &h) {
+  const float last_sensor_temp = h.plant.sensor_temp,
+              power = h.fault == HEATER_FAULT ? 0 : SIM_HOTEND_POWER * h.soft_pwm / 128.0;
+  heater_sim_step(h.plant, power, SIM_HOTEND_HEAT_CAPACITY, SIM_HOTEND_LOSS + SIM_HOTEND_FAN_LOSS * h.fan / 255.0,
+                  SIM_HOTEND_SENSOR_LAG, SIM_AMBIENT_TEMP, PID_dT);
+  if (h.fault == SENSOR_FAULT) // Fallen out of the block, it cools in the air
+    h.plant.sensor_temp = last_sensor_temp + (SIM_AMBIENT_TEMP - last_sensor_temp) * PID_dT / 20.0;
+  h.ms += PID_dT * 1000;
+
+  // temp_filter_mean()
+  const unsigned long value = read_sensor(h);
+  if (!h.filter_ready) {
+    for (uint8_t i = 0; i < MEDIAN_COUNT; i++) h.filter[i] = value;
+    h.filter_sum = value * MEDIAN_COUNT;
+    h.filter_index = 0;
+    h.filter_ready = true;
+  }
+  h.filter_sum += value - h.filter[h.filter_index];
+  h.filter[h.filter_index] = value;
+  if (++h.filter_index >= MEDIAN_COUNT) h.filter_index = 0;
+  h.temperature = temptable_lookup(HEATER_0_TEMPTABLE, slope, HEATER_0_TEMPTABLE_LEN, (h.filter_sum / MEDIAN_COUNT + 4) >> 2);
+
+  if (h.error) return; // The heater stays off
+
+  if (h.temperature > HEATER_0_MAXTEMP) h.error = "MAXTEMP";
+  if (thermal_runaway_step(&h.tr_state, &h.tr_timer, &h.tr_target, h.temperature, h.target, h.ms, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS))
+    h.error = "thermal runaway";
+  const float output = pid_step(h.pid, h.target, h.temperature, DEFAULT_Kp, DEFAULT_Ki * PID_dT, DEFAULT_Kd / PID_dT, 0);
+  if (watch_heater_check(h.temperature, h.target, h.ms, &h.watch_target, &h.watch_next_ms))
+    h.error = "heating failed";
+  h.soft_pwm = h.error ? 0 : (int)output >> 1;
+}
+
+static void run_until(hotend_t &h, const float seconds) {
+  while (h.ms < seconds * 1000) step(h);
+}
+
+static int failures = 0;
+
+static void check(const bool ok, const char *what, const float value, const float limit) {
+  printf("%-52s %8.2f  (limit %.2f)%s\n", what, value, limit, ok ? "" : "  FAIL");
+  if (!ok) failures++;
+}
+
+// Heat from ambient, return the time to reach the target and the overshoot in the next minutes
+static void heat_up(const float target, const float fan, float &seconds, float &overshoot) {
+  hotend_t h;
+  hotend_init(h);
+  run_until(h, 1);
+  h.fan = fan;
+  set_target(h, target);
+  seconds = -1;
+  overshoot = 0;
+  while (h.ms < 600000 && !h.error) {
+    step(h);
+    if (seconds < 0 && h.temperature >= target - TEMP_HYSTERESIS) seconds = h.ms / 1000.0 - 1;
+    if (seconds >= 0 && h.temperature - target > overshoot) overshoot = h.temperature - target;
+  }
+  if (h.error || seconds < 0) {
+    printf("Heating to %.0f failed: %s\n", target, h.error ? h.error : "timeout");
+    failures++;
+    seconds = 600;
+  }
+}
+
+// Seconds from the fault at fault_s to the error, the longest over some noise seeds
+static float fault_latency(const Fault fault, const float fault_s, const char *expected) {
+  float worst = 0;
+  for (unsigned seed = 1; seed <= 20; seed++) {
+    srand(seed);
+    hotend_t h;
+    hotend_init(h);
+    run_until(h, 1);
+    set_target(h, 200);
+    run_until(h, fault_s);
+    h.fault = fault;
+    while (!h.error && h.ms < (fault_s + 600) * 1000) step(h);
+    const float latency = h.error ? h.ms / 1000.0 - fault_s : 600;
+    if (!h.error || strcmp(h.error, expected)) {
+      printf("Fault at %.0f s gave %s, not %s\n", fault_s, h.error ? h.error : "no error", expected);
+      failures++;
+    }
+    if (latency > worst) worst = latency;
+  }
+  return worst;
+}
+
+// Prints with a random target up to the highest M104 takes, the part fan switching, and a few target changes
+static bool false_positive(const unsigned seed) {
+  srand(seed);
+  hotend_t h;
+  hotend_init(h);
+  run_until(h, 1);
+  set_target(h, 180 + rand() % (HEATER_0_MAXTEMP - 15 - 180 - 10 + 1));
+  millis_t next_fan_ms = 0, next_target_ms = 300000 + rand() % 600000;
+  while (h.ms < PRINT_TIME * 1000UL && !h.error) {
+    if (h.ms >= next_fan_ms) {
+      static const float fan_speeds[] = { 0, 0, 128, 255, 255 };
+      h.fan = fan_speeds[rand() % 5];
+      next_fan_ms = h.ms + 10000 + rand() % 50000;
+    }
+    if (h.ms >= next_target_ms) {
+      const float target = h.target + rand() % 21 - 10;
+      set_target(h, target < 180 ? 180 : target > HEATER_0_MAXTEMP - 15 ? HEATER_0_MAXTEMP - 15 : target);
+      next_target_ms = h.ms + 300000 + rand() % 600000;
+    }
+    step(h);
+  }
+  if (h.error) printf("Print %u: %s at %.1f s, %.1f°C for %.0f°C\n", seed, h.error, h.ms / 1000.0, h.temperature, h.target);
+  return h.error != NULL;
+}
+
+int main() {
+  init_temptable_slopes(HEATER_0_TEMPTABLE, HEATER_0_TEMPTABLE_LEN, slope);
+  srand(1);
+
+  float seconds, overshoot;
+  heat_up(200, 0, seconds, overshoot);
+  check(seconds <= MAX_HEATUP_TIME, "Heat-up to 200°C (s)", seconds, MAX_HEATUP_TIME);
+  check(overshoot <= MAX_OVERSHOOT, "Overshoot at 200°C (°C)", overshoot, MAX_OVERSHOOT);
+  heat_up(240, 255, seconds, overshoot);
+  check(seconds <= MAX_HEATUP_TIME_FAN, "Heat-up to 240°C with the fan on (s)", seconds, MAX_HEATUP_TIME_FAN);
+  check(overshoot <= MAX_OVERSHOOT, "Overshoot at 240°C with the fan on (°C)", overshoot, MAX_OVERSHOOT);
+
+  float latency = fault_latency(HEATER_FAULT, 300, "thermal runaway");
+  check(latency <= MAX_RUNAWAY_LATENCY, "Heater failure at the target, detected after (s)", latency, MAX_RUNAWAY_LATENCY);
+  latency = fault_latency(SENSOR_FAULT, 300, "thermal runaway");
+  check(latency <= MAX_RUNAWAY_LATENCY, "Thermistor out at the target, detected after (s)", latency, MAX_RUNAWAY_LATENCY);
+  latency = fault_latency(HEATER_FAULT, 1, "heating failed");
+  check(latency <= MAX_WATCH_LATENCY, "Heater dead from the start, detected after (s)", latency, MAX_WATCH_LATENCY);
+  latency = fault_latency(HEATER_FAULT, 30, "heating failed");
+  check(latency <= MAX_WATCH_LATENCY, "Heater failure while heating, detected after (s)", latency, MAX_WATCH_LATENCY);
+  latency = fault_latency(SENSOR_FAULT, 30, "heating failed");
+  check(latency <= MAX_WATCH_LATENCY, "Thermistor out while heating, detected after (s)", latency, MAX_WATCH_LATENCY);
+
+  int errors = 0;
+  for (unsigned seed = 1; seed <= PRINTS; seed++)
+    if (false_positive(seed)) errors++;
+  check(errors <= MAX_FALSE_POSITIVE_RATE * PRINTS, "False positives over the simulated prints (%)", 100.0 * errors / PRINTS, 100.0 * MAX_FALSE_POSITIVE_RATE);
+
+  return failures ? 1 : 0;
+}
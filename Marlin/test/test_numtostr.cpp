@@ -0,0 +1,134 @@
+/**
+ * test_numtostr.cpp - Host test of the fixed point float formatting
+ *
+ *   test_numtostr [places]
+ *
+ * ftostr_fixed() must give x correctly rounded to the places, with ties away
+ * from zero as Print does. Checked against an exact reference for every float
+ * up to the "ovf" limit, by default with the 2 places of serial output, then
+ * also against glibc's printf and for ftol_fixed() on a sample with 0-9 places.
+ * Then the LCD formats on a few values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define MARLIN_H // Only the conversion, without the Arduino core
+#include "macros.h"
+#include "numtostr.cpp"
+
+static long checked, bad;
+
+static void fail(const char *what, float x, int places, const char *got, const char *want) {
+  if (bad++ < 10) printf("%s(%.9g, %d): \"%s\", expected \"%s\"\n", what, x, places, got, want);
+}
+
+/**
+ * 10^places is 2^places times at most 5^9, 21 bits, and a float has 24, so
+ * |x| * 10^places is exact in a double, and so is the rounding.
+ */
+static const double pow10_double[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+static uint64_t exact_scaled(float x, int places, bool *tie=NULL) {
+  double v = fabs((double)x) * pow10_double[places], whole = floor(v);
+  if (tie) *tie = v - whole == 0.5;
+  return (uint64_t)whole + (v - whole >= 0.5); // Ties away from zero
+}
+
+static void exact_format(char *buf, float x, int places) {
+  uint64_t r = exact_scaled(x, places), p10 = pow10_fixed[places];
+  int n = sprintf(buf, "%s%llu", x < 0 ? "-" : "", (unsigned long long)(r / p10));
+  if (places) sprintf(buf + n, ".%0*llu", places, (unsigned long long)(r % p10));
+}
+
+// The digits of a formatted number, without the sign and point, or -1 if it isn't one
+static int64_t digits_of(const char *s) {
+  int64_t l = 0;
+  if (*s == '-') s++;
+  if (!NUMERIC(*s)) return -1;
+  for (; *s; s++) if (*s != '.') l = l * 10 + (*s - '0');
+  return l;
+}
+
+static void check(float x, int places, bool with_printf) {
+  char got[FTOSTR_SIZE], want[64];
+  checked++;
+  ftostr_fixed(got, x, places);
+  bool tie;
+  const uint64_t scaled = exact_scaled(x, places, &tie);
+  if (digits_of(got) != (int64_t)scaled || (got[0] == '-') != (x < 0)) {
+    exact_format(want, x, places);
+    if (strcmp(got, want)) fail("ftostr_fixed", x, places, got, want);
+  }
+  if (!with_printf) return;
+
+  exact_format(want, x, places);
+  if (strcmp(got, want)) fail("ftostr_fixed", x, places, got, want);
+  if (!tie && x != 0) { // printf rounds ties to even and prints -0 as "-0", unlike Print
+    snprintf(want, sizeof(want), "%.*f", places, (double)x);
+    if (strcmp(got, want)) fail("ftostr_fixed vs printf", x, places, got, want);
+  }
+  long want_l = scaled > LONG_MAX ? LONG_MAX : (long)scaled, got_l = ftol_fixed(x, places);
+  if (x < 0) want_l = -want_l;
+  if (got_l != want_l) {
+    char g[24], w[24];
+    sprintf(g, "%ld", got_l);
+    sprintf(w, "%ld", want_l);
+    fail("ftol_fixed", x, places, g, w);
+  }
+}
+
+static float from_bits(uint32_t bits) {
+  float x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+static void check_lcd(const char *what, const char *got, const char *want) {
+  checked++;
+  if (strcmp(got, want)) fail(what, 0, 0, got, want);
+}
+
+int main(int argc, char **argv) {
+  const int places = argc > 1 ? atoi(argv[1]) : 2;
+
+  // Every positive float that isn't "ovf". The sign only adds a '-'.
+  const uint32_t ovf = 0x4F7FFFFF; // 4294967040
+  for (uint32_t bits = 0; bits <= ovf; bits++) check(from_bits(bits), places, false);
+
+  // A sample of both signs, with every number of places
+  for (uint32_t bits = 0; bits <= ovf; bits += 4099)
+    for (int p = 0; p <= FTOSTR_MAX_PLACES; p++) {
+      check(from_bits(bits), p, true);
+      check(-from_bits(bits), p, true);
+    }
+
+  char buf[FTOSTR_SIZE];
+  ftostr_fixed(buf, NAN, 2); check_lcd("nan", buf, "nan");
+  ftostr_fixed(buf, -INFINITY, 2); check_lcd("inf", buf, "inf");
+  ftostr_fixed(buf, 4294967296.0f, 2); check_lcd("ovf", buf, "ovf");
+  ftostr_fixed(buf, 1.005f, 2); check_lcd("ftostr_fixed", buf, "1.00"); // 1.00499999...
+  ftostr_fixed(buf, 0.125f, 2); check_lcd("ftostr_fixed", buf, "0.13");  // A tie, away from zero
+
+  check_lcd("ftostr3", ftostr3(-12.5f), "-13");
+  check_lcd("ftostr31", ftostr31(199.96f), "+200.0");
+  check_lcd("ftostr31ns", ftostr31ns(-42.04f), "042.0");
+  check_lcd("ftostr32", ftostr32(-1.235f), "-01.24");
+  check_lcd("ftostr43", ftostr43(1.2345f), "1.235");
+  check_lcd("ftostr12ns", ftostr12ns(0.999f), "1.00");
+  check_lcd("ftostr32sp", ftostr32sp(5.5f), "  5.5 ");
+  check_lcd("ftostr32sp", ftostr32sp(-12.34f), "-12.34");
+  check_lcd("ftostr5", ftostr5(12345.4f), "12345");
+  check_lcd("ftostr51", ftostr51(-1234.56f), "-1234.6");
+  check_lcd("ftostr52", ftostr52(123.456f), "+123.46");
+  check_lcd("itostr3", itostr3(-7), "- 7");
+  check_lcd("itostr3left", itostr3left(42), "42");
+  check_lcd("itostr4", itostr4(123), " 123");
+
+  printf("numtostr: %ld conversions with %d places and a sample of 0-%d, %ld wrong\n",
+         checked, places, FTOSTR_MAX_PLACES, bad);
+  return bad != 0;
+}
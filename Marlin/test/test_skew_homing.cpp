@@ -0,0 +1,128 @@
+/**
+ * test_skew_homing.cpp - Host test of homing with SKEW_CORRECTION
+ *
+ * A model of G28 on a cartesian machine: plan_set_position(), moves that stop
+ * when an endstop is hit, and the homing sequence of gcode_G28() and
+ * homeaxis(), with the transform of plan_transform.h. Homing must leave the
+ * motors and the step counters at the same place from any start position.
+ * It does, with the skew switched off while homing as G28 does now. The old
+ * sequence, homing with the skew on, is run for comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "plan_transform.h"
+
+static const float steps_per_unit[3] = { 80, 80, 400 },
+                   max_length[3] = { 200, 200, 180 };
+
+static const float skew_xy = 0.01f, skew_xz = 0.004f, skew_yz = -0.006f;
+
+static float transform[9], transform_inverse[9];
+static long position[3], count[3], motor[3]; // Planner, stepper counters, where the motors really are
+static float current_position[3];
+
+static void set_skew(bool enabled) {
+  if (enabled)
+    skew_matrices(skew_xy, skew_xz, skew_yz, transform, transform_inverse);
+  else
+    skew_matrices(0, 0, 0, transform, transform_inverse);
+}
+
+static void plan_set_position(float x, float y, float z) {
+  apply_transform(transform, x, y, z);
+  const float p[3] = { x, y, z };
+  for (int i = 0; i < 3; i++) position[i] = count[i] = lround(p[i] * steps_per_unit[i]);
+}
+
+static void sync_plan_position() { plan_set_position(current_position[0], current_position[1], current_position[2]); }
+
+// A move, ended where the first motor moving toward its min endstop reaches it
+static void line_to(const float destination[3]) {
+  float x = destination[0], y = destination[1], z = destination[2];
+  apply_transform(transform, x, y, z);
+  const float target[3] = { x, y, z };
+  long delta[3];
+  double fraction = 1;
+  for (int i = 0; i < 3; i++) {
+    delta[i] = lround(target[i] * steps_per_unit[i]) - position[i];
+    if (delta[i] < 0 && motor[i] + delta[i] < 0) fraction = fmin(fraction, (double)motor[i] / -delta[i]);
+  }
+  for (int i = 0; i < 3; i++) {
+    long moved = lround(delta[i] * fraction);
+    motor[i] += moved;
+    count[i] += moved;
+    position[i] += delta[i];
+  }
+}
+
+// homeaxis() toward the min endstop, without the bump
+static void home_axis(int axis) {
+  current_position[axis] = 0;
+  sync_plan_position();
+  float destination[3] = { current_position[0], current_position[1], current_position[2] };
+  destination[axis] = -1.5f * max_length[axis];
+  line_to(destination);
+  current_position[axis] = 0; // set_axis_is_at_home()
+  sync_plan_position();
+}
+
+static void g28(bool skew_off) {
+  if (skew_off) {
+    set_skew(false);
+    for (int i = 0; i < 3; i++) current_position[i] = (float)count[i] / steps_per_unit[i];
+  }
+  home_axis(0);
+  home_axis(1);
+  home_axis(2);
+  sync_plan_position();
+  if (skew_off) {
+    set_skew(true);
+    apply_transform(transform_inverse, current_position[0], current_position[1], current_position[2]);
+    sync_plan_position();
+  }
+}
+
+// G28 from a position, with the skew on as it is between commands. False if it went wrong.
+static bool home_from(float x, float y, float z, bool skew_off, long result[3]) {
+  set_skew(true);
+  current_position[0] = x; current_position[1] = y; current_position[2] = z;
+  sync_plan_position();
+  for (int i = 0; i < 3; i++) motor[i] = count[i]; // The last G28 left them in step
+  g28(skew_off);
+  bool ok = true;
+  for (int i = 0; i < 3; i++) {
+    result[i] = motor[i];
+    if (count[i] != motor[i]) ok = false; // The counters must be where the motors are
+  }
+  return ok;
+}
+
+int main() {
+  const float starts[][3] = { { 10, 10, 5 }, { 150, 180, 60 }, { 100, 20, 150 }, { 5, 190, 2 } };
+  const int n = sizeof(starts) / sizeof(starts[0]);
+  int bad = 0;
+  long first[3], old_first[3], r[3];
+  long old_spread = 0;
+  for (int s = 0; s < n; s++) {
+    if (!home_from(starts[s][0], starts[s][1], starts[s][2], true, r)) {
+      printf("G28 from %g,%g,%g: counters %ld,%ld,%ld, motors %ld,%ld,%ld\n",
+             starts[s][0], starts[s][1], starts[s][2], count[0], count[1], count[2], r[0], r[1], r[2]);
+      bad++;
+    }
+    if (!s) for (int i = 0; i < 3; i++) first[i] = r[i];
+    for (int i = 0; i < 3; i++) if (r[i] != first[i]) {
+      printf("G28 from %g,%g,%g: motor %d at %ld steps, %ld from the first start\n",
+             starts[s][0], starts[s][1], starts[s][2], i, r[i], first[i]);
+      bad++;
+    }
+
+    home_from(starts[s][0], starts[s][1], starts[s][2], false, r);
+    if (!s) for (int i = 0; i < 3; i++) old_first[i] = r[i];
+    for (int i = 0; i < 3; i++) old_spread = fmax(old_spread, labs(r[i] - old_first[i]));
+  }
+  printf("skew homing: %d starts, %d wrong (with the skew on while homing, up to %ld steps apart)\n",
+         n, bad, old_spread);
+  return bad != 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * test_thermistor_lookup.cpp - Host test and micro-benchmark of temptable_lookup()
+ *
+ * Built once per table with -DTHERMISTORBED=<table>. Checks the binary search
+ * against the linear scan it replaced over the whole 0-16383 raw range, then
+ * times both.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#define MARLIN_H // Only the tables, without the Arduino core
+#define PROGMEM
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#include "thermistortables.h"
+#include "thermistor_lookup.h"
+
+#define RAW_MAX 16383
+
+// analog2tempBed() as it was
+static float linear_scan(int raw) {
+  float celsius = 0;
+  uint8_t i;
+
+  for (i = 1; i < BEDTEMPTABLE_LEN; i++) {
+    if (PGM_RD_W(BEDTEMPTABLE[i][0]) > raw) {
+      celsius  = PGM_RD_W(BEDTEMPTABLE[i-1][1]) +
+        (raw - PGM_RD_W(BEDTEMPTABLE[i-1][0])) *
+        (float)(PGM_RD_W(BEDTEMPTABLE[i][1]) - PGM_RD_W(BEDTEMPTABLE[i-1][1])) /
+        (float)(PGM_RD_W(BEDTEMPTABLE[i][0]) - PGM_RD_W(BEDTEMPTABLE[i-1][0]));
+      break;
+    }
+  }
+
+  // Overflow: Set to last value in the table
+  if (i == BEDTEMPTABLE_LEN) celsius = PGM_RD_W(BEDTEMPTABLE[i-1][1]);
+
+  return celsius;
+}
+
+static float slopes[BEDTEMPTABLE_LEN];
+
+static float binary_search(int raw) {
+  return temptable_lookup(BEDTEMPTABLE, slopes, BEDTEMPTABLE_LEN, raw);
+}
+
+// Nanoseconds per conversion over the whole range
+static double bench(float (*convert)(int)) {
+  const int rounds = 50;
+  volatile float sink = 0;
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++)
+    for (int raw = 0; raw <= RAW_MAX; raw++) sink = sink + convert(raw);
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds / (RAW_MAX + 1);
+}
+
+int main() {
+  init_temptable_slopes(BEDTEMPTABLE, BEDTEMPTABLE_LEN, slopes);
+
+  // The slope is the same quotient, only rounded before the multiply instead of after,
+  // so the results may differ in the last bits. Far below the 0.01°C that is reported.
+  int bad = 0;
+  float worst = 0;
+  for (int raw = 0; raw <= RAW_MAX; raw++) {
+    float a = linear_scan(raw), b = binary_search(raw),
+          diff = fabsf(a - b);
+    if (diff > worst) worst = diff;
+    if (diff > 0.001f) {
+      if (bad++ < 5) printf("raw %d: scan %.6f, lookup %.6f\n", raw, a, b);
+    }
+  }
+
+  printf("table %-4d %3d entries: max difference %.2g°C, scan %.1f ns, lookup %.1f ns\n",
+         THERMISTORBED, (int)BEDTEMPTABLE_LEN, worst, bench(linear_scan), bench(binary_search));
+  return bad != 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * thermistor_generator.h - Build thermistor tables at compile time
+ *
+ * Produces a table in the format of thermistortables.h, { raw, °C } pairs sorted
+ * by raw value, from the beta or Steinhart-Hart coefficients of a thermistor and
+ * its pull-up resistor. The entries are evenly spaced in temperature, so the
+ * number of points sets the resolution (and the flash used) over the whole range.
+ *
+ * Example:
+ *   constexpr temptable_t<71> my_table = temptable_generate<71>(thermistor_beta_t { 4700, 100000, 3950 }, 0, 350);
+ */
+
+#ifndef THERMISTOR_GENERATOR_H_
+#define THERMISTOR_GENERATOR_H_
+
+#define TEMPTABLE_RAW_MAX (1023.0 * OVERSAMPLENR) // Raw value with the thermistor open
+#define TEMPTABLE_KELVIN 273.15
+
+// Thermistor described by its resistance at 25°C and beta coefficient
+struct thermistor_beta_t {
+  double pullup, r25, beta;
+
+  constexpr double resistance(const double celsius) const {
+    return r25 * __builtin_exp(beta * (1.0 / (celsius + TEMPTABLE_KELVIN) - 1.0 / (25.0 + TEMPTABLE_KELVIN)));
+  }
+};
+
+// Thermistor described by Steinhart-Hart coefficients, 1/T = A + B ln(R) + C ln(R)^3
+struct thermistor_sh_t {
+  double pullup, a, b, c;
+
+  // ln(R) is the real root of x^3 + p x + q = 0 (Cardano)
+  constexpr double cardano(const double p, const double q) const {
+    return __builtin_cbrt(-q / 2 + __builtin_sqrt(q * q / 4 + p * p * p / 27))
+         + __builtin_cbrt(-q / 2 - __builtin_sqrt(q * q / 4 + p * p * p / 27));
+  }
+  constexpr double resistance(const double celsius) const {
+    return __builtin_exp(cardano(b / c, (a - 1.0 / (celsius + TEMPTABLE_KELVIN)) / c));
+  }
+};
+
+template<int N> struct temptable_t { short entry[N][2]; };
+
+// Temperature of entry i, from tmax (lowest raw value) down to tmin
+constexpr short temptable_celsius(const int i, const int n, const int tmin, const int tmax) {
+  return tmax - (long)(tmax - tmin) * i / (n - 1);
+}
+
+// Raw value read with the thermistor at the given temperature
+template<typename Model>
+constexpr short temptable_raw(const Model &m, const short celsius) {
+  return TEMPTABLE_RAW_MAX * m.resistance(celsius) / (m.resistance(celsius) + m.pullup) + 0.5;
+}
+
+// Index list 0..N-1 to expand the table entries
+template<int... Is> struct temptable_seq {};
+template<int N, int... Is> struct temptable_make_seq : temptable_make_seq<N - 1, N - 1, Is...> {};
+template<int... Is> struct temptable_make_seq<0, Is...> { typedef temptable_seq<Is...> type; };
+
+template<int N, typename Model, int... Is>
+constexpr temptable_t<N> temptable_build(const Model &m, const int tmin, const int tmax, temptable_seq<Is...>) {
+  return {{ { temptable_raw(m, temptable_celsius(Is, N, tmin, tmax)), temptable_celsius(Is, N, tmin, tmax) }... }};
+}
+
+template<int N, typename Model>
+constexpr temptable_t<N> temptable_generate(const Model &m, const int tmin, const int tmax) {
+  static_assert(N >= 2 && N <= 255, "A thermistor table needs 2 to 255 points.");
+  return temptable_build<N>(m, tmin, tmax, typename temptable_make_seq<N>::type());
+}
+
+#endif //THERMISTOR_GENERATOR_H_
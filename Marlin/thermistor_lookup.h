@@ -0,0 +1,41 @@
+/**
+ * thermistor_lookup.h - Convert raw readings with the thermistortables.h tables
+ *
+ * The tables are { raw, °C } pairs sorted by raw value. The slope of each segment
+ * is computed once, so a conversion is a binary search and one multiply.
+ */
+
+#ifndef THERMISTOR_LOOKUP_H_
+#define THERMISTOR_LOOKUP_H_
+
+#define PGM_RD_W(x)   (short)pgm_read_word(&x)
+
+/**
+ * Compute the slope of each segment of a thermistor table into slope[1..len-1],
+ * so the conversion needs no divide. Returns the next free slot of the pool.
+ */
+static inline float* init_temptable_slopes(const short (*tt)[2], const uint8_t len, float *slope) {
+  for (uint8_t i = 1; i < len; i++)
+    slope[i] = (float)(PGM_RD_W(tt[i][1]) - PGM_RD_W(tt[i-1][1])) / (float)(PGM_RD_W(tt[i][0]) - PGM_RD_W(tt[i-1][0]));
+  return slope + len;
+}
+
+/**
+ * Convert a raw value with a thermistor table sorted by raw value.
+ * A binary search finds the first entry above raw, then the segment
+ * below it is interpolated with its precomputed slope.
+ */
+static inline float temptable_lookup(const short (*tt)[2], const float *slope, const uint8_t len, const int raw) {
+  uint8_t lo = 1, hi = len;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) >> 1;
+    if (PGM_RD_W(tt[mid][0]) > raw) hi = mid; else lo = mid + 1;
+  }
+
+  // Overflow: Set to last value in the table
+  if (lo == len) return PGM_RD_W(tt[len-1][1]);
+
+  return PGM_RD_W(tt[lo-1][1]) + (raw - PGM_RD_W(tt[lo-1][0])) * slope[lo];
+}
+
+#endif //THERMISTOR_LOOKUP_H_
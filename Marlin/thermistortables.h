@@ -1118,6 +1118,20 @@ const short temptable_1047[][2] PROGMEM = {
 };
 #endif
 
+#if (THERMISTORHEATER_0 == 1000) || (THERMISTORHEATER_1 == 1000) || (THERMISTORHEATER_2 == 1000) || (THERMISTORHEATER_3 == 1000) || (THERMISTORBED == 1000) //User defined thermistor
+  // Generated at compile time from the THERMISTOR_1000_* parameters in Configuration_adv.h
+  #include "thermistor_generator.h"
+  constexpr temptable_t<THERMISTOR_1000_POINTS> temptable_1000_generated = temptable_generate<THERMISTOR_1000_POINTS>(
+    #ifdef THERMISTOR_1000_SH_C
+      thermistor_sh_t { THERMISTOR_1000_PULLUP, THERMISTOR_1000_SH_A, THERMISTOR_1000_SH_B, THERMISTOR_1000_SH_C },
+    #else
+      thermistor_beta_t { THERMISTOR_1000_PULLUP, THERMISTOR_1000_R25, THERMISTOR_1000_BETA },
+    #endif
+    THERMISTOR_1000_MINTEMP, THERMISTOR_1000_MAXTEMP
+  );
+  #define temptable_1000 (temptable_1000_generated.entry)
+#endif
+
 
 #define _TT_NAME(_N) temptable_ ## _N
 #define TT_NAME(_N) _TT_NAME(_N)
@@ -3,6 +3,7 @@
 
 #include "Marlin.h"
 #include "buzzer.h"
+#include "numtostr.h"
 
 #ifdef ULTRA_LCD
   int lcd_strlen(char *s);
@@ -120,21 +121,4 @@
 
 #endif //ULTRA_LCD
 
-char *itostr2(const uint8_t &x);
-char *itostr31(const int &xx);
-char *itostr3(const int &xx);
-char *itostr3left(const int &xx);
-char *itostr4(const int &xx);
-
-char *ftostr3(const float &x);
-char *ftostr31ns(const float &x); // float to string without sign character
-char *ftostr31(const float &x);
-char *ftostr32(const float &x);
-char *ftostr43(const float &x);
-char *ftostr12ns(const float &x); 
-char *ftostr32sp(const float &x); // remove zero-padding from ftostr32
-char *ftostr5(const float &x);
-char *ftostr51(const float &x);
-char *ftostr52(const float &x);
-
 #endif //ULTRALCD_H